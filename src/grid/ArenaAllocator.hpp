@@ -0,0 +1,349 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/version.hpp>
+
+#if BOOST_VERSION >= 106600
+#include <boost/container/small_vector.hpp>
+#endif
+
+namespace maps { namespace grid
+{
+
+/**
+ * Pool for many small allocations of a single map.
+ *
+ * Memory is taken from large chunks and recycled through free lists per
+ * size class, so growing and shrinking cell lists does not hit malloc.
+ * The pool is split into shards, every thread allocates from the chunks of
+ * its own shard, hence threads merging into different cells of the same
+ * map do not contend for a lock. Freed blocks are put on the free list of
+ * the shard of the freeing thread and reused by its next allocations.
+ *
+ * Chunks are kept as long as the arena exists, freed blocks are only
+ * reused. release() returns all chunks but the first of each shard to the
+ * system once no allocation is left, MultiLevelGridMap::clear() calls it.
+ * Allocations larger than MAX_BLOCK_SIZE are forwarded to operator new.
+ * All methods are thread safe.
+ */
+class MemoryArena
+{
+public:
+    static const size_t ALIGNMENT = 16;
+    static const size_t MAX_BLOCK_SIZE = 1024;
+    static const size_t NUM_SHARDS = 8;
+
+    explicit MemoryArena(size_t chunk_size = 64 * 1024)
+        : chunk_size(chunk_size < MAX_BLOCK_SIZE ? MAX_BLOCK_SIZE : chunk_size)
+        , num_allocations(0)
+    {
+    }
+
+    ~MemoryArena()
+    {
+        for (Shard& shard : shards)
+        {
+            for (char* chunk : shard.chunks)
+                ::operator delete(chunk);
+        }
+    }
+
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
+
+    void* allocate(size_t bytes)
+    {
+        const size_t size_class = toSizeClass(bytes);
+        if (size_class >= NUM_SIZE_CLASSES)
+        {
+            num_allocations++;
+            return ::operator new(bytes);
+        }
+
+        Shard& shard = shards[getThreadShard()];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        num_allocations++;
+
+        FreeBlock* block = shard.free_lists[size_class];
+        if (block)
+        {
+            shard.free_lists[size_class] = block->next;
+            return block;
+        }
+
+        const size_t block_size = size_class * ALIGNMENT;
+        if (shard.chunks.empty() || shard.chunk_used + block_size > chunk_size)
+        {
+            shard.chunks.push_back(static_cast<char*>(::operator new(chunk_size)));
+            shard.chunk_used = 0;
+        }
+        void* ptr = shard.chunks.back() + shard.chunk_used;
+        shard.chunk_used += block_size;
+        return ptr;
+    }
+
+    void deallocate(void* ptr, size_t bytes)
+    {
+        const size_t size_class = toSizeClass(bytes);
+        if (size_class >= NUM_SIZE_CLASSES)
+        {
+            ::operator delete(ptr);
+            num_allocations--;
+            return;
+        }
+
+        Shard& shard = shards[getThreadShard()];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        FreeBlock* block = static_cast<FreeBlock*>(ptr);
+        block->next = shard.free_lists[size_class];
+        shard.free_lists[size_class] = block;
+        num_allocations--;
+    }
+
+    /**
+     * Releases all chunks but the first of each shard if there is no allocation left.
+     * Returns false if there are allocations, the arena is unchanged in this case.
+     */
+    bool release()
+    {
+        std::unique_lock<std::mutex> locks[NUM_SHARDS];
+        for (size_t i = 0; i < NUM_SHARDS; ++i)
+            locks[i] = std::unique_lock<std::mutex>(shards[i].mutex);
+
+        // allocations of chunk memory need the lock of their shard, hence the count is stable
+        if (num_allocations != 0)
+            return false;
+
+        for (Shard& shard : shards)
+        {
+            for (size_t i = 1; i < shard.chunks.size(); ++i)
+                ::operator delete(shard.chunks[i]);
+            if (!shard.chunks.empty())
+                shard.chunks.resize(1);
+            shard.chunk_used = 0;
+            std::fill(shard.free_lists, shard.free_lists + NUM_SIZE_CLASSES, static_cast<FreeBlock*>(NULL));
+        }
+        return true;
+    }
+
+    /** Number of allocations which have not been returned yet */
+    size_t getNumAllocations() const
+    {
+        return num_allocations;
+    }
+
+    /** Memory held in chunks */
+    size_t getReservedBytes() const
+    {
+        size_t num_chunks = 0;
+        for (const Shard& shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            num_chunks += shard.chunks.size();
+        }
+        return num_chunks * chunk_size;
+    }
+
+private:
+    static const size_t NUM_SIZE_CLASSES = MAX_BLOCK_SIZE / ALIGNMENT + 1;
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct Shard
+    {
+        Shard() : chunk_used(0)
+        {
+            std::fill(free_lists, free_lists + NUM_SIZE_CLASSES, static_cast<FreeBlock*>(NULL));
+        }
+
+        std::vector<char*> chunks;
+        size_t chunk_used;
+        FreeBlock* free_lists[NUM_SIZE_CLASSES];
+        mutable std::mutex mutex;
+    };
+
+    static size_t toSizeClass(size_t bytes)
+    {
+        return bytes == 0 ? 1 : (bytes + ALIGNMENT - 1) / ALIGNMENT;
+    }
+
+    /** Shard of the calling thread, threads are assigned round robin */
+    static size_t getThreadShard()
+    {
+        static std::atomic<size_t> next_shard(0);
+        static thread_local const size_t shard = next_shard++ % NUM_SHARDS;
+        return shard;
+    }
+
+    const size_t chunk_size;
+    Shard shards[NUM_SHARDS];
+    std::atomic<size_t> num_allocations;
+};
+
+/**
+ * Allocator drawing from a shared MemoryArena.
+ *
+ * Copies share the arena, containers copied from each other, e.g. the cells
+ * of a grid which are initialized from the default value, therefore use the
+ * same arena. A default constructed allocator has no arena and forwards to
+ * operator new, so default constructed containers do not allocate anything.
+ * Maps create one arena for all their cells, see MapAllocator.
+ */
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <class U>
+    struct rebind
+    {
+        typedef ArenaAllocator<U> other;
+    };
+
+    ArenaAllocator()
+    {
+    }
+
+    explicit ArenaAllocator(const boost::shared_ptr<MemoryArena>& arena)
+        : arena(arena)
+    {
+    }
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other)
+        : arena(other.getArena())
+    {
+    }
+
+    T* allocate(size_type n)
+    {
+        if (!arena)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(arena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_type n)
+    {
+        if (!arena)
+            ::operator delete(ptr);
+        else
+            arena->deallocate(ptr, n * sizeof(T));
+    }
+
+    size_type max_size() const
+    {
+        return size_type(-1) / sizeof(T);
+    }
+
+    /** The arena of the allocator, NULL for a default constructed allocator */
+    const boost::shared_ptr<MemoryArena>& getArena() const
+    {
+        return arena;
+    }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U>& other) const
+    {
+        return arena == other.getArena();
+    }
+
+    template <class U>
+    bool operator!=(const ArenaAllocator<U>& other) const
+    {
+        return arena != other.getArena();
+    }
+
+private:
+    boost::shared_ptr<MemoryArena> arena;
+};
+
+/**
+ * Creates the allocator shared by the cells of a map and releases its memory.
+ * Only allocators based on ArenaAllocator hold state, e.g. the one of a
+ * SmallArenaContainer, every other allocator is default constructed.
+ */
+template <class Allocator, bool = std::is_base_of<ArenaAllocator<typename Allocator::value_type>, Allocator>::value>
+struct MapAllocator
+{
+    static Allocator create()
+    {
+        return Allocator();
+    }
+
+    static void release(const Allocator&)
+    {
+    }
+};
+
+template <class Allocator>
+struct MapAllocator<Allocator, true>
+{
+    /** An allocator with a new arena */
+    static Allocator create()
+    {
+        return Allocator(ArenaAllocator<typename Allocator::value_type>(boost::make_shared<MemoryArena>()));
+    }
+
+    /** Releases the chunks of the arena if no cell holds memory anymore */
+    static void release(const Allocator& allocator)
+    {
+        if (allocator.getArena())
+            allocator.getArena()->release();
+    }
+};
+
+#if BOOST_VERSION >= 106600
+/**
+ * Container for LevelList (as AllocatorOrContainer parameter) which keeps up
+ * to two elements inline and takes larger buffers from a MemoryArena.
+ */
+template <class T>
+using SmallArenaContainer = boost::container::small_vector<T, 2, ArenaAllocator<T> >;
+#endif
+
+}}
@@ -0,0 +1,73 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "ChunkedArchive.hpp"
+
+#include <stdexcept>
+#include <zlib.h>
+
+using namespace maps::grid;
+
+std::string maps::grid::compressChunk(const std::string& raw, ChunkCompression compression)
+{
+    switch (compression)
+    {
+    case CHUNK_COMPRESSION_NONE:
+        return raw;
+    case CHUNK_COMPRESSION_ZLIB:
+    {
+        uLongf size = compressBound(raw.size());
+        std::string stored(size, '\0');
+        if (compress2(reinterpret_cast<Bytef*>(&stored[0]), &size,
+                      reinterpret_cast<const Bytef*>(raw.data()), raw.size(), Z_BEST_SPEED) != Z_OK)
+            throw std::runtime_error("Failed to compress grid chunk");
+        stored.resize(size);
+        return stored;
+    }
+    }
+    throw std::runtime_error("Unknown chunk compression");
+}
+
+std::string maps::grid::decompressChunk(const std::string& stored, uint64_t raw_size, ChunkCompression compression)
+{
+    switch (compression)
+    {
+    case CHUNK_COMPRESSION_NONE:
+        if (stored.size() != raw_size)
+            throw std::runtime_error("Grid chunk has an invalid size");
+        return stored;
+    case CHUNK_COMPRESSION_ZLIB:
+    {
+        std::string raw(raw_size, '\0');
+        uLongf size = raw_size;
+        if (uncompress(reinterpret_cast<Bytef*>(&raw[0]), &size,
+                       reinterpret_cast<const Bytef*>(stored.data()), stored.size()) != Z_OK || size != raw_size)
+            throw std::runtime_error("Failed to decompress grid chunk");
+        return raw;
+    }
+    }
+    throw std::runtime_error("Unknown chunk compression");
+}
@@ -0,0 +1,78 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+namespace maps { namespace grid
+{
+    /** Compression of the chunks of a chunked grid archive */
+    enum ChunkCompression
+    {
+        CHUNK_COMPRESSION_NONE = 0,
+        /** zlib with the fastest compression level */
+        CHUNK_COMPRESSION_ZLIB = 1
+    };
+
+    /**
+     * Configuration of the chunked archive mode of VectorGrid.
+     *
+     * In chunked mode the grid is split into bands of rows_per_chunk rows.
+     * Each band is encoded into its own binary archive and optionally
+     * compressed, so that saving and loading the bands runs in parallel.
+     * Loading detects the mode from the archive, the configuration of the
+     * loading grid only provides the number of threads.
+     */
+    struct ChunkedArchiveConfig
+    {
+        ChunkedArchiveConfig()
+            : enabled(false)
+            , rows_per_chunk(64)
+            , compression(CHUNK_COMPRESSION_NONE)
+            , num_threads(0)
+        {}
+
+        bool enabled;
+        unsigned rows_per_chunk;
+        ChunkCompression compression;
+        /** Number of threads for encoding and decoding, 0 uses all hardware threads */
+        unsigned num_threads;
+    };
+
+    /**
+     * Largest average encoded size in bytes of a cell with variable size,
+     * e.g. a LevelList, that is accepted when loading a chunk.
+     */
+    static const uint64_t MAX_AVERAGE_CELL_SIZE = 64 * 1024;
+
+    /** Compresses the content of a chunk */
+    std::string compressChunk(const std::string& raw, ChunkCompression compression);
+
+    /** Restores the content of a chunk of raw_size bytes */
+    std::string decompressChunk(const std::string& stored, uint64_t raw_size, ChunkCompression compression);
+}}
@@ -0,0 +1,338 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <cmath>
+
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/split_member.hpp>
+
+#include "MLSMap.hpp"
+
+namespace maps { namespace grid
+{
+
+    /**
+     * Structure of arrays holding the topmost patch of each cell of an MLS.
+     *
+     * The arrays are row-major with num_cells.x() elements per row, the
+     * methods take cell coordinates relative to origin.
+     * Cells without patch have a NaN mean and stddev.
+     * The topmost patch is the maximum patch w.r.t. the patch ordering,
+     * as used by MLSToSlopes.
+     */
+    struct MLSTopPatchView
+    {
+        /** Index of the first cell of the view in the MLS, non-zero for a view of a part of a MLS */
+        Index origin;
+        Vector2ui num_cells;
+        Vector2d resolution;
+        std::vector<float> mean;
+        std::vector<float> stddev;
+
+        MLSTopPatchView() : origin(0, 0), num_cells(0, 0), resolution(0, 0) {}
+
+        size_t toIdx(size_t x, size_t y) const
+        {
+            return x + y * num_cells.x();
+        }
+
+        bool hasPatch(size_t x, size_t y) const
+        {
+            return !std::isnan(mean[toIdx(x, y)]);
+        }
+
+        /** Resizes the arrays and marks all cells as empty */
+        void reset(const Vector2ui& num_cells, const Vector2d& resolution)
+        {
+            this->num_cells = num_cells;
+            this->resolution = resolution;
+            mean.assign(num_cells.prod(), std::numeric_limits<float>::quiet_NaN());
+            stddev.assign(num_cells.prod(), std::numeric_limits<float>::quiet_NaN());
+        }
+
+        /** Stores the topmost patch of a range of patches */
+        template<class PatchIterator>
+        void setCell(size_t idx, PatchIterator begin, PatchIterator end)
+        {
+            PatchIterator top = std::max_element(begin, end);
+            if (top != end)
+            {
+                mean[idx] = top->getMean();
+                stddev[idx] = top->getStandardDeviation();
+            }
+        }
+
+        /** Builds the view from a MLS providing patches with mean and standard deviation */
+        template<class MLS>
+        static MLSTopPatchView fromMLS(const MLS& mls)
+        {
+            if (mls.getNumCells().prod() == 0)
+            {
+                MLSTopPatchView view;
+                view.reset(mls.getNumCells(), mls.getResolution());
+                return view;
+            }
+            return fromMLS(mls, CellExtents(Vector2ui(0, 0), mls.getNumCells() - Vector2ui(1, 1)));
+        }
+
+        /** Builds the view of the cells within @p extents (inclusive) of a MLS */
+        template<class MLS>
+        static MLSTopPatchView fromMLS(const MLS& mls, const CellExtents& extents)
+        {
+            MLSTopPatchView view;
+            if (extents.isEmpty())
+            {
+                view.resolution = mls.getResolution();
+                return view;
+            }
+            view.origin = extents.min().cast<int>();
+            view.reset(extents.sizes() + Vector2ui(1, 1), mls.getResolution());
+            for (unsigned int y = 0; y < view.num_cells.y(); ++y)
+            {
+                for (unsigned int x = 0; x < view.num_cells.x(); ++x)
+                {
+                    const typename MLS::CellType& cell = mls.at(view.origin.x() + x, view.origin.y() + y);
+                    view.setCell(view.toIdx(x, y), cell.begin(), cell.end());
+                }
+            }
+            return view;
+        }
+    };
+
+    /**
+     * Read-only, contiguous MLS storage.
+     *
+     * All patches are kept in a single pool in cell order, the patches of the
+     * cell (x,y) are in [cell_offsets[i], cell_offsets[i+1]) with
+     * i = x + y * num_cells.x() (CSR layout). Compared to MLSMap this avoids
+     * one heap allocation per cell and keeps neighbouring cells close in memory.
+     */
+    template<enum MLSConfig::update_model SurfaceType>
+    class CompactMLSMap : public LocalMap
+    {
+    public:
+        typedef SurfacePatch<SurfaceType> Patch;
+        typedef boost::shared_ptr< CompactMLSMap<SurfaceType> > Ptr;
+
+        /** Patches of a single cell */
+        class PatchRange
+        {
+        public:
+            typedef const Patch* const_iterator;
+
+            PatchRange(const Patch* b, const Patch* e) : b(b), e(e) {}
+
+            const_iterator begin() const { return b; }
+            const_iterator end() const { return e; }
+            size_t size() const { return e - b; }
+            bool empty() const { return b == e; }
+
+        private:
+            const Patch* b;
+            const Patch* e;
+        };
+
+        typedef PatchRange CellType;
+
+        CompactMLSMap()
+            : LocalMap(maps::LocalMapType::MLS_MAP)
+            , num_cells(0, 0)
+            , resolution(0, 0)
+            , cell_offsets(1, 0)
+        {
+        }
+
+        template<class AllocatorOrContainer, class GridT>
+        explicit CompactMLSMap(const MLSMap<SurfaceType, AllocatorOrContainer, GridT>& mls)
+            : LocalMap(mls)
+            , num_cells(0, 0)
+            , resolution(0, 0)
+        {
+            assign(mls);
+        }
+
+        /**
+         * Replaces the content by a copy of @p mls. Any grid storage is supported,
+         * the cells are read by index since sparse storages only iterate allocated cells.
+         */
+        template<class AllocatorOrContainer, class GridT>
+        void assign(const MLSMap<SurfaceType, AllocatorOrContainer, GridT>& mls)
+        {
+            typedef typename MLSMap<SurfaceType, AllocatorOrContainer, GridT>::CellType MLSCellType;
+
+            num_cells = mls.getNumCells();
+            resolution = mls.getResolution();
+            config = mls.getConfig();
+
+            size_t num_patches = 0;
+            for (unsigned int y = 0; y < num_cells.y(); ++y)
+            {
+                for (unsigned int x = 0; x < num_cells.x(); ++x)
+                    num_patches += mls.at(x, y).size();
+            }
+            if (num_patches > std::numeric_limits<uint32_t>::max())
+                throw std::runtime_error("CompactMLSMap: too many patches");
+
+            patches.clear();
+            patches.reserve(num_patches);
+            cell_offsets.clear();
+            cell_offsets.reserve(size_t(num_cells.x()) * num_cells.y() + 1);
+            cell_offsets.push_back(0);
+            for (unsigned int y = 0; y < num_cells.y(); ++y)
+            {
+                for (unsigned int x = 0; x < num_cells.x(); ++x)
+                {
+                    const MLSCellType& cell = mls.at(x, y);
+                    patches.insert(patches.end(), cell.begin(), cell.end());
+                    cell_offsets.push_back(patches.size());
+                }
+            }
+        }
+
+        /** Creates a MLSMap with the same content and frame, using the default grid storage */
+        MLSMap<SurfaceType> toMLSMap() const
+        {
+            MLSMap<SurfaceType> mls(num_cells, resolution, config);
+            mls.getLocalFrame() = getLocalFrame();
+            mls.getId() = getId();
+            mls.getEPSGCode() = getEPSGCode();
+
+            typename MLSMap<SurfaceType>::iterator cell = mls.begin();
+            for (size_t i = 0; i + 1 < cell_offsets.size(); ++i, ++cell)
+                cell->insert(patches.begin() + cell_offsets[i], patches.begin() + cell_offsets[i + 1]);
+            return mls;
+        }
+
+        const Vector2ui& getNumCells() const { return num_cells; }
+        const Vector2d& getResolution() const { return resolution; }
+        const MLSConfig& getConfig() const { return config; }
+
+        size_t getNumPatches() const { return patches.size(); }
+
+        /** Pool of all patches in cell order */
+        const std::vector<Patch>& getPatches() const { return patches; }
+
+        /** Offsets of the first patch of each cell, has getNumCells().prod() + 1 elements */
+        const std::vector<uint32_t>& getCellOffsets() const { return cell_offsets; }
+
+        bool inGrid(const Index& idx) const
+        {
+            return idx.isInside(num_cells);
+        }
+
+        PatchRange at(size_t x, size_t y) const
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            const size_t i = x + y * num_cells.x();
+            return PatchRange(patches.data() + cell_offsets[i], patches.data() + cell_offsets[i + 1]);
+        }
+
+        PatchRange at(const Index& idx) const
+        {
+            return at(idx.x(), idx.y());
+        }
+
+        /** Returns the topmost patch of a cell or NULL if the cell is empty */
+        const Patch* getTopPatch(const Index& idx) const
+        {
+            PatchRange range = at(idx);
+            if (range.empty())
+                return NULL;
+            return std::max_element(range.begin(), range.end());
+        }
+
+        /** Builds a structure of arrays containing the topmost patch of each cell */
+        MLSTopPatchView getTopPatchView() const
+        {
+            MLSTopPatchView view;
+            view.reset(num_cells, resolution);
+            for (size_t i = 0; i + 1 < cell_offsets.size(); ++i)
+                view.setCell(i, patches.begin() + cell_offsets[i], patches.begin() + cell_offsets[i + 1]);
+            return view;
+        }
+
+    protected:
+        Vector2ui num_cells;
+        Vector2d resolution;
+        MLSConfig config;
+
+        /** All patches, ordered by cell */
+        std::vector<Patch> patches;
+
+        /** CSR index into patches */
+        std::vector<uint32_t> cell_offsets;
+
+        /** Grants access to boost serialization */
+        friend class boost::serialization::access;
+
+        /** Serializes the members of this class*/
+        template<class Archive>
+        void save(Archive & ar, const unsigned int version) const
+        {
+            ar << BOOST_SERIALIZATION_BASE_OBJECT_NVP(::maps::LocalMap);
+            ar << BOOST_SERIALIZATION_NVP(num_cells.derived());
+            ar << BOOST_SERIALIZATION_NVP(resolution);
+            ar << BOOST_SERIALIZATION_NVP(config);
+            ar << BOOST_SERIALIZATION_NVP(patches);
+            ar << BOOST_SERIALIZATION_NVP(cell_offsets);
+        }
+
+        template<class Archive>
+        void load(Archive & ar, const unsigned int version)
+        {
+            ar >> BOOST_SERIALIZATION_BASE_OBJECT_NVP(::maps::LocalMap);
+            ar >> BOOST_SERIALIZATION_NVP(num_cells.derived());
+            ar >> BOOST_SERIALIZATION_NVP(resolution);
+            ar >> BOOST_SERIALIZATION_NVP(config);
+            ar >> BOOST_SERIALIZATION_NVP(patches);
+            ar >> BOOST_SERIALIZATION_NVP(cell_offsets);
+
+            // the patch ranges of the cells must stay within the patches, like in MappedMLSMap
+            if (cell_offsets.size() != uint64_t(num_cells.x()) * num_cells.y() + 1
+                || cell_offsets.front() != 0 || cell_offsets.back() != patches.size())
+                throw std::runtime_error("CompactMLSMap: invalid cell offsets in archive");
+            for (size_t i = 1; i < cell_offsets.size(); ++i)
+            {
+                if (cell_offsets[i] < cell_offsets[i - 1])
+                    throw std::runtime_error("CompactMLSMap: invalid cell offsets in archive");
+            }
+        }
+
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
+    };
+
+    typedef CompactMLSMap<MLSConfig::KALMAN> CompactMLSMapKalman;
+    typedef CompactMLSMap<MLSConfig::SLOPE> CompactMLSMapSloped;
+    typedef CompactMLSMap<MLSConfig::PRECALCULATED> CompactMLSMapPrecalculated;
+
+} /* namespace grid */
+} /* namespace maps */
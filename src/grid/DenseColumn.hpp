@@ -0,0 +1,406 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <utility>
+
+#include <boost/format.hpp>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+
+namespace maps { namespace grid
+{
+
+/**
+ * Dense alternative to DiscreteTree for voxel columns.
+ *
+ * The cells of a contiguous z index range are stored in one array which grows at both ends,
+ * hence accessing or creating a cell is O(1) amortized and consecutive z indices are adjacent
+ * in memory. A flag per cell marks which cells have been created, iteration and lookup only
+ * consider those. The interface mirrors the one of DiscreteTree, so the class can be used as
+ * column type of a VoxelGridMap. It is best suited for columns which are filled in contiguous
+ * ranges, e.g. by ray traversal.
+ *
+ * Note that the storage always spans every z index between the lowest and the highest cell
+ * ever created, plus up to half of its size as growth slack at the extended end, and it is
+ * only released by clear(). A column with two cells far apart therefore allocates all cells
+ * in between, use DiscreteTree for sparse columns.
+ */
+template<class S>
+class DenseColumn
+{
+    template<class ColumnPtr, class CellRef>
+    class Iterator
+    {
+    public:
+        typedef std::pair<const int32_t, CellRef> value_type;
+
+        /** Allows it->first and it->second on the temporary pair */
+        struct Proxy
+        {
+            value_type pair;
+            const value_type* operator->() const { return &pair; }
+        };
+
+        Iterator() : column(NULL), pos(0) {}
+        Iterator(ColumnPtr column, size_t pos) : column(column), pos(pos) {}
+
+        /** Allows conversion from iterator to const_iterator */
+        template<class OtherPtr, class OtherRef>
+        Iterator(const Iterator<OtherPtr, OtherRef>& other) : column(other.column), pos(other.pos) {}
+
+        value_type operator*() const
+        {
+            return value_type(column->base + (int32_t)pos, column->cells[pos]);
+        }
+
+        Proxy operator->() const
+        {
+            return Proxy{**this};
+        }
+
+        Iterator& operator++()
+        {
+            pos = column->nextAllocated(pos + 1);
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator it = *this;
+            ++(*this);
+            return it;
+        }
+
+        template<class OtherPtr, class OtherRef>
+        bool operator==(const Iterator<OtherPtr, OtherRef>& other) const
+        {
+            return pos == other.pos && column == other.column;
+        }
+
+        template<class OtherPtr, class OtherRef>
+        bool operator!=(const Iterator<OtherPtr, OtherRef>& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        template<class, class> friend class Iterator;
+
+        ColumnPtr column;
+        size_t pos;
+    };
+
+public:
+    typedef S value_type;
+    typedef Iterator<DenseColumn*, S&> iterator;
+    typedef Iterator<const DenseColumn*, const S&> const_iterator;
+
+    DenseColumn(float resolution) : base(0), num_allocated(0), resolution(resolution) {}
+    virtual ~DenseColumn() {}
+
+    S& operator[](float pos)
+    {
+        return getCellAt(getCellIndex(pos));
+    }
+
+    /** Returns the cell at \c idx, the cell is created if it doesn't exist. */
+    S& getCellAt(int32_t idx)
+    {
+        reserve(idx, idx);
+        const size_t pos = idx - base;
+        if(!allocated[pos])
+        {
+            allocated[pos] = 1;
+            num_allocated++;
+        }
+        return cells[pos];
+    }
+
+    /** Returns the cell at \c idx, throws std::out_of_range if the cell doesn't exist. */
+    const S& getCellAt(int32_t idx) const
+    {
+        const_iterator it = find(idx);
+        if(it == end())
+            throw std::out_of_range((boost::format("DenseColumn: There is no cell at index %1%!") % idx).str());
+        return it->second;
+    }
+
+    /**
+     * Makes sure that the storage covers the index range [z_first, z_last] without creating cells,
+     * so that subsequent calls of getCellAt within the range don't need to grow the column.
+     * The storage grows to cover the union of the current and the requested range.
+     */
+    void reserve(int32_t z_first, int32_t z_last)
+    {
+        if(z_first > z_last)
+            std::swap(z_first, z_last);
+        if(!cells.empty() && z_first >= base && z_last < base + (int64_t)cells.size())
+            return;
+
+        int64_t new_first = z_first, new_last = z_last;
+        if(!cells.empty())
+        {
+            // grow geometrically at the end which is extended to keep the growth amortized O(1)
+            const int64_t slack = std::max<int64_t>(cells.size() / 2, 4);
+            const int64_t last = base + (int64_t)cells.size() - 1;
+            if(new_first < base)
+                new_first = std::max<int64_t>(std::min<int64_t>(new_first, base - slack), std::numeric_limits<int32_t>::min());
+            else
+                new_first = base;
+            if(new_last > last)
+                new_last = std::min<int64_t>(std::max<int64_t>(new_last, last + slack), std::numeric_limits<int32_t>::max());
+            else
+                new_last = last;
+        }
+
+        std::vector<S> new_cells(new_last - new_first + 1);
+        std::vector<uint8_t> new_allocated(new_cells.size(), 0);
+        const size_t shift = cells.empty() ? 0 : base - new_first;
+        for(size_t i = 0; i < cells.size(); ++i)
+        {
+            if(allocated[i])
+            {
+                new_cells[shift + i] = cells[i];
+                new_allocated[shift + i] = 1;
+            }
+        }
+        cells.swap(new_cells);
+        allocated.swap(new_allocated);
+        base = (int32_t)new_first;
+    }
+
+    /**
+     * Calls \c f(idx, cell) for every index in the range between \c z_first and \c z_last (inclusive,
+     * in ascending order). Missing cells are created, see DiscreteTree::updateRange.
+     */
+    template<class Function>
+    void updateRange(int32_t z_first, int32_t z_last, Function f)
+    {
+        if(z_first > z_last)
+            std::swap(z_first, z_last);
+        reserve(z_first, z_last);
+        const size_t end = (size_t)((int64_t)z_last - base) + 1;
+        for(size_t pos = (size_t)((int64_t)z_first - base); pos < end; ++pos)
+        {
+            if(!allocated[pos])
+            {
+                allocated[pos] = 1;
+                num_allocated++;
+            }
+            f(base + (int32_t)pos, cells[pos]);
+        }
+    }
+
+    iterator begin()
+    {
+        return iterator(this, nextAllocated(0));
+    }
+
+    iterator end()
+    {
+        return iterator(this, cells.size());
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, nextAllocated(0));
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, cells.size());
+    }
+
+    iterator find(const float pos)
+    {
+        return find(getCellIndex(pos));
+    }
+
+    const_iterator find(const float pos) const
+    {
+        return find(getCellIndex(pos));
+    }
+
+    iterator find(int32_t idx)
+    {
+        return iterator(this, findPosition(idx));
+    }
+
+    const_iterator find(int32_t idx) const
+    {
+        return const_iterator(this, findPosition(idx));
+    }
+
+    bool hasCell(float pos) const
+    {
+        return find(pos) != end();
+    }
+
+    bool hasCell(int32_t idx) const
+    {
+        return find(idx) != end();
+    }
+
+    /** Number of created cells */
+    size_t size() const
+    {
+        return num_allocated;
+    }
+
+    bool empty() const
+    {
+        return num_allocated == 0;
+    }
+
+    /** Removes all cells and releases the storage */
+    void clear()
+    {
+        std::vector<S>().swap(cells);
+        std::vector<uint8_t>().swap(allocated);
+        base = 0;
+        num_allocated = 0;
+    }
+
+    float getCellCenter(int32_t idx) const
+    {
+        return (((float)idx) + 0.5f) * resolution;
+    }
+
+    int32_t getCellIndex(float pos, bool check_numeric_limits = false) const
+    {
+        if(check_numeric_limits && !isValidPos(pos))
+            throw std::out_of_range((boost::format("DenseColumn: The given value %1% is out of range!") % pos).str());
+        return (int32_t)std::floor(pos / resolution);
+    }
+
+    int32_t getCellIndex(float pos, double z_diff) const
+    {
+        int32_t idx = getCellIndex(pos);
+        z_diff = pos - getCellCenter(idx);
+        return idx;
+    }
+
+    bool isValidPos(float pos) const
+    {
+        if(std::abs(pos) <= INT32_MAX * resolution)
+            return true;
+        return false;
+    }
+
+    float getResolution() const
+    {
+        return resolution;
+    }
+
+    /** Two columns are equal if they contain the same cells at the same indices */
+    bool operator==(const DenseColumn& other) const
+    {
+        if(num_allocated != other.num_allocated || resolution != other.resolution)
+            return false;
+        for(const_iterator it = begin(), other_it = other.begin(); it != end(); ++it, ++other_it)
+        {
+            if(it->first != other_it->first || !(it->second == other_it->second))
+                return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const DenseColumn& other) const
+    {
+        return !(*this == other);
+    }
+
+protected:
+    /** Grants access to boost serialization */
+    friend class boost::serialization::access;
+
+    /** Saves the created cells as index/cell pairs. */
+    template <typename Archive>
+    void save(Archive &ar, const unsigned int version) const
+    {
+        uint64_t num_cells = num_allocated;
+        ar << BOOST_SERIALIZATION_NVP(num_cells);
+        for(const_iterator it = begin(); it != end(); ++it)
+        {
+            int32_t idx = it->first;
+            ar << BOOST_SERIALIZATION_NVP(idx);
+            ar << boost::serialization::make_nvp("cell", it->second);
+        }
+        ar << BOOST_SERIALIZATION_NVP(resolution);
+    }
+
+    /** Loads the members of this class. */
+    template <typename Archive>
+    void load(Archive &ar, const unsigned int version)
+    {
+        clear();
+        uint64_t num_cells;
+        ar >> BOOST_SERIALIZATION_NVP(num_cells);
+        for(uint64_t i = 0; i < num_cells; ++i)
+        {
+            int32_t idx;
+            ar >> BOOST_SERIALIZATION_NVP(idx);
+            ar >> boost::serialization::make_nvp("cell", getCellAt(idx));
+        }
+        ar >> BOOST_SERIALIZATION_NVP(resolution);
+    }
+
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+    /** Returns the storage position of \c idx or cells.size() if the cell doesn't exist */
+    size_t findPosition(int32_t idx) const
+    {
+        const int64_t pos = (int64_t)idx - base;
+        if(pos < 0 || pos >= (int64_t)cells.size() || !allocated[pos])
+            return cells.size();
+        return pos;
+    }
+
+    /** Returns the first created cell at or after \c pos */
+    size_t nextAllocated(size_t pos) const
+    {
+        while(pos < cells.size() && !allocated[pos])
+            ++pos;
+        return pos;
+    }
+
+    /** z index of cells[0] */
+    int32_t base;
+    std::vector<S> cells;
+    std::vector<uint8_t> allocated;
+    size_t num_allocated;
+    float resolution;
+};
+
+}}
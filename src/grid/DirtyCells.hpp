@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include <maps/grid/Index.hpp>
+
+namespace maps { namespace grid
+{
+    /**
+     * @brief Keeps track of the cells of a grid which changed since the last reset.
+     *
+     * The changed cells are stored in a bitset with one bit per cell and the
+     * bounding box of all changed cells. Tracking is disabled by default, in
+     * which case marking cells does nothing.
+     * If the number of cells of the grid changes, all cells are considered as changed.
+     * Marking cells is not thread safe.
+     */
+    class DirtyCells
+    {
+    public:
+        DirtyCells()
+            : enabled(false)
+            , num_cells(0, 0)
+        {
+        }
+
+        /** Enables or disables the tracking, all cells of a newly enabled tracker are dirty */
+        void setEnabled(bool enable, const Vector2ui& num_cells)
+        {
+            enabled = enable;
+            if (enabled)
+                markAll(num_cells);
+            else
+            {
+                bits.clear();
+                extents.setEmpty();
+            }
+        }
+
+        bool isEnabled() const
+        {
+            return enabled;
+        }
+
+        void mark(const Index& idx, const Vector2ui& num_cells)
+        {
+            if (!enabled)
+                return;
+            if (num_cells != this->num_cells)
+            {
+                markAll(num_cells);
+                return;
+            }
+            const size_t cell = toIdx(idx);
+            bits[cell / 64] |= uint64_t(1) << (cell % 64);
+            extents.extend(Vector2ui(idx.x(), idx.y()));
+        }
+
+        void markAll(const Vector2ui& num_cells)
+        {
+            if (!enabled)
+                return;
+            this->num_cells = num_cells;
+            const size_t count = num_cells.prod();
+            bits.assign((count + 63) / 64, ~uint64_t(0));
+            // clear the bits behind the last cell
+            if (count % 64)
+                bits.back() = (uint64_t(1) << (count % 64)) - 1;
+            extents.setEmpty();
+            if (count > 0)
+                extents = CellExtents(Vector2ui(0, 0), num_cells - Vector2ui(1, 1));
+        }
+
+        void reset(const Vector2ui& num_cells)
+        {
+            if (!enabled)
+                return;
+            this->num_cells = num_cells;
+            bits.assign((num_cells.prod() + 63) / 64, 0);
+            extents.setEmpty();
+        }
+
+        bool isDirty(const Index& idx, const Vector2ui& num_cells) const
+        {
+            if (!enabled)
+                return false;
+            if (num_cells != this->num_cells)
+                return true;
+            const size_t cell = toIdx(idx);
+            return bits[cell / 64] & (uint64_t(1) << (cell % 64));
+        }
+
+        /** Bounding box of the dirty cells, empty if no cell changed */
+        CellExtents getExtents(const Vector2ui& num_cells) const
+        {
+            if (enabled && num_cells != this->num_cells && num_cells.prod() > 0)
+                return CellExtents(Vector2ui(0, 0), num_cells - Vector2ui(1, 1));
+            return extents;
+        }
+
+        /** Calls f(const Index&) for every dirty cell in row major order */
+        template<class Function>
+        void forEach(const Vector2ui& num_cells, Function f) const
+        {
+            if (!enabled)
+                return;
+            if (num_cells != this->num_cells)
+            {
+                for (unsigned y = 0; y < num_cells.y(); ++y)
+                    for (unsigned x = 0; x < num_cells.x(); ++x)
+                        f(Index(x, y));
+                return;
+            }
+            if (extents.isEmpty())
+                return;
+            for (unsigned y = extents.min().y(); y <= extents.max().y(); ++y)
+            {
+                for (unsigned x = extents.min().x(); x <= extents.max().x(); ++x)
+                {
+                    const size_t cell = size_t(y) * num_cells.x() + x;
+                    const uint64_t word = bits[cell / 64];
+                    // skip clean words at once
+                    if (word == 0)
+                    {
+                        x += 63 - cell % 64;
+                        continue;
+                    }
+                    if (word & (uint64_t(1) << (cell % 64)))
+                        f(Index(x, y));
+                }
+            }
+        }
+
+    private:
+        bool enabled;
+        Vector2ui num_cells;
+        std::vector<uint64_t> bits;
+        CellExtents extents;
+
+        size_t toIdx(const Index& idx) const
+        {
+            return size_t(idx.y()) * num_cells.x() + idx.x();
+        }
+    };
+}}
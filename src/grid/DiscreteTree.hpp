@@ -29,6 +29,9 @@
 #include <map>
 #include <cmath>
 #include <limits>
+#include <vector>
+#include <utility>
+#include <algorithm>
 
 #include <boost/format.hpp>
 #include <boost/container/flat_map.hpp>
@@ -61,9 +64,46 @@ public:
         return TreeBase::operator[](idx);
     }
 
+    /** Throws std::out_of_range if there is no cell at \c idx */
     const S& getCellAt(int32_t idx) const
     {
-        return TreeBase::operator[](idx);
+        return TreeBase::at(idx);
+    }
+
+    /**
+     * Calls \c f(idx, cell) for every index in the range between \c z_first and \c z_last (inclusive,
+     * in ascending order). Missing cells are default constructed, they are inserted into the
+     * tree in a single merge before the range is visited.
+     */
+    template<class Function>
+    void updateRange(int32_t z_first, int32_t z_last, Function f)
+    {
+        if(z_first > z_last)
+            std::swap(z_first, z_last);
+
+        typename TreeBase::iterator it = TreeBase::lower_bound(z_first);
+        typename TreeBase::iterator range_end = TreeBase::upper_bound(z_last);
+        const int64_t range_size = (int64_t)z_last - z_first + 1;
+        if((int64_t)(range_end - it) != range_size)
+        {
+            // collect the missing indices, they are sorted and unique
+            std::vector< std::pair<int32_t, S> > missing;
+            missing.reserve(range_size - (range_end - it));
+            int64_t idx = z_first;
+            for(; it != range_end; ++it, ++idx)
+            {
+                for(; idx < it->first; ++idx)
+                    missing.push_back(std::make_pair((int32_t)idx, S()));
+            }
+            for(; idx <= z_last; ++idx)
+                missing.push_back(std::make_pair((int32_t)idx, S()));
+
+            TreeBase::insert(boost::container::ordered_unique_range, missing.begin(), missing.end());
+            it = TreeBase::lower_bound(z_first);
+        }
+
+        for(int64_t idx = z_first; idx <= z_last; ++idx, ++it)
+            f((int32_t)idx, it->second);
     }
 
     typename TreeBase::iterator find(const float pos)
@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost_serialization/EigenTypes.hpp>
+
+#include <maps/grid/Index.hpp>
+
+namespace maps { namespace grid
+{
+    /**
+     * @brief The cells of a grid map which changed between two revisions.
+     *
+     * Created by GridMap::createDelta() from the cells changed since the last delta and
+     * applied with GridMap::applyDelta() to a copy of the map at revision
+     * base_revision. Only the changed cells are serialized.
+     *
+     * Cells are loaded into copies of the cell given to the constructor, which
+     * allows cell types without default constructor (e.g. DiscreteTree). Use the
+     * default value of the receiving map for it.
+     */
+    template<class CellT>
+    struct GridDelta
+    {
+        /** Revision of the map the delta has to be applied to */
+        uint64_t base_revision;
+        /** Revision of the map after applying the delta */
+        uint64_t revision;
+        /** Number of cells of the map, changes of the size are not supported */
+        Vector2ui num_cells;
+
+        std::vector<Index> indices;
+        std::vector<CellT> cells;
+
+        explicit GridDelta(const CellT& prototype = CellT())
+            : base_revision(0)
+            , revision(0)
+            , num_cells(0, 0)
+            , prototype(prototype)
+        {
+        }
+
+        size_t size() const
+        {
+            return indices.size();
+        }
+
+        bool empty() const
+        {
+            return indices.empty();
+        }
+
+    protected:
+        CellT prototype;
+
+        /** Grants access to boost serialization */
+        friend class boost::serialization::access;
+
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+        template <typename Archive>
+        void save(Archive &ar, const unsigned int version) const
+        {
+            ar << BOOST_SERIALIZATION_NVP(base_revision);
+            ar << BOOST_SERIALIZATION_NVP(revision);
+            ar << BOOST_SERIALIZATION_NVP(num_cells);
+            ar << BOOST_SERIALIZATION_NVP(indices);
+            for (const CellT& cell : cells)
+                ar << BOOST_SERIALIZATION_NVP(cell);
+        }
+
+        template <typename Archive>
+        void load(Archive &ar, const unsigned int version)
+        {
+            ar >> BOOST_SERIALIZATION_NVP(base_revision);
+            ar >> BOOST_SERIALIZATION_NVP(revision);
+            ar >> BOOST_SERIALIZATION_NVP(num_cells);
+            ar >> BOOST_SERIALIZATION_NVP(indices);
+            cells.assign(indices.size(), prototype);
+            for (CellT& cell : cells)
+                ar >> BOOST_SERIALIZATION_NVP(cell);
+        }
+    };
+}}
@@ -40,6 +40,8 @@
 
 #include <maps/LocalMap.hpp>
 #include <maps/grid/VectorGrid.hpp>
+#include <maps/grid/DirtyCells.hpp>
+#include <maps/grid/GridDelta.hpp>
 
 namespace maps { namespace grid
 {
@@ -62,6 +64,15 @@ namespace maps { namespace grid
          */
         Vector2d resolution;
 
+        /** Cells changed since the last call of resetDirty(), if enabled */
+        DirtyCells dirty_cells;
+
+        /** Cells changed since the last call of createDelta() or setRevision(), if enabled */
+        DirtyCells delta_cells;
+
+        /** Revision of the map regarding createDelta() and applyDelta() */
+        uint64_t revision;
+
     public:
         typedef CellT CellType;
         typedef boost::shared_ptr<GridMap<CellT, GridT> > Ptr;
@@ -70,14 +81,18 @@ namespace maps { namespace grid
         GridMap() 
             : LocalMap(maps::LocalMapType::GRID_MAP),
               GridT(),
-              resolution(0,0)
+              resolution(0,0),
+              revision(0)
         {
         }
 
         GridMap(const GridMap& other)
             : LocalMap(other), 
               GridT(other),
-              resolution(other.resolution)
+              resolution(other.resolution),
+              dirty_cells(other.dirty_cells),
+              delta_cells(other.delta_cells),
+              revision(other.revision)
         {
         }
 
@@ -86,6 +101,7 @@ namespace maps { namespace grid
             : LocalMap(other)
             , GridT(storage)
             , resolution(other.getResolution())
+            , revision(0)
         {
         }
 
@@ -120,7 +136,8 @@ namespace maps { namespace grid
                 const CellT& default_value)
             : LocalMap(maps::LocalMapType::GRID_MAP),
               GridT(num_cells, default_value),
-              resolution(resolution)
+              resolution(resolution),
+              revision(0)
         {
         }
 
@@ -130,7 +147,8 @@ namespace maps { namespace grid
                 const boost::shared_ptr<LocalMapData> &data)
             : LocalMap(data),
               GridT(num_cells, default_value),
-              resolution(resolution)
+              resolution(resolution),
+              revision(0)
         {}
 
         /** @brief default destructor
@@ -412,6 +430,14 @@ namespace maps { namespace grid
             auto it = this->begin();
             auto endIt = this->end();
 
+            // sparse grid storages only iterate allocated cells
+            if(it == endIt)
+            {
+                if(include_default_value)
+                    return this->getDefaultValue();
+                throw std::runtime_error("Tried to compute max on map without allocated cells");
+            }
+
             const Q *first = &(*it);
 //            const Q *last = &(*(this->end()));
 
@@ -419,7 +445,11 @@ namespace maps { namespace grid
             /** Include the default value as a possible max value to return **/
             if (include_default_value)
             {
-                return *std::max_element(this->begin(), this->end());
+                const Q &largest = *std::max_element(this->begin(), this->end());
+                // the cells of unallocated tiles of sparse grid storages have the default value
+                if (largest < this->getDefaultValue() && std::distance(this->begin(), this->end()) < std::ptrdiff_t(num_cells.x()) * num_cells.y())
+                    return this->getDefaultValue();
+                return largest;
             }
             else
             {
@@ -469,6 +499,14 @@ namespace maps { namespace grid
             auto it = this->begin();
             auto endIt = this->end();
 
+            // sparse grid storages only iterate allocated cells
+            if(it == endIt)
+            {
+                if(include_default_value)
+                    return this->getDefaultValue();
+                throw std::runtime_error("Tried to compute min on map without allocated cells");
+            }
+
             const Q *first = &(*it);
 //            const Q *last = &(*(this->end()));
 
@@ -476,7 +514,11 @@ namespace maps { namespace grid
             /** Include the default value as a possible min value to return **/
             if (include_default_value)
             {
-                return *std::min_element(this->begin(), this->end());
+                const Q &smallest = *std::min_element(this->begin(), this->end());
+                // the cells of unallocated tiles of sparse grid storages have the default value
+                if (this->getDefaultValue() < smallest && std::distance(this->begin(), this->end()) < std::ptrdiff_t(num_cells.x()) * num_cells.y())
+                    return this->getDefaultValue();
+                return smallest;
             }
             else
             {
@@ -516,12 +558,156 @@ namespace maps { namespace grid
             }
         }
 
+        /**
+         * @brief Resets all cells to the default value.
+         * @details Marks all cells as dirty, so that the next delta contains the cleared cells.
+         */
+        void clear()
+        {
+            GridT::clear();
+            markAllDirty();
+        }
+
         void extend(const Vector2ui &minSize)
         {
             Vector2ui newSize = minSize.cwiseMax(getNumCells());
             this->resize(newSize);
         }
 
+        /**
+         * @brief Moves the content of the grid cells by the given offset.
+         * @details Marks all cells as dirty, since every cell might have changed.
+         */
+        void moveBy(const Index &idx)
+        {
+            GridT::moveBy(idx);
+            markAllDirty();
+        }
+
+        /**
+         * @brief Enables or disables the tracking of changed cells.
+         * @details The map itself marks the cells it modifies in its merge
+         * functions and in moveBy. Direct writes through at() are not tracked,
+         * use markDirty() for these. Newly enabled tracking reports all cells as dirty.
+         * The dirty cells and the cells of the next delta are tracked independently,
+         * resetDirty() and createDelta() don't affect each other.
+         */
+        void setDirtyTracking(bool enable)
+        {
+            dirty_cells.setEnabled(enable, getNumCells());
+            delta_cells.setEnabled(enable, getNumCells());
+        }
+
+        bool isDirtyTrackingEnabled() const
+        {
+            return dirty_cells.isEnabled();
+        }
+
+        void markDirty(const Index& idx)
+        {
+            dirty_cells.mark(idx, getNumCells());
+            delta_cells.mark(idx, getNumCells());
+        }
+
+        void markAllDirty()
+        {
+            dirty_cells.markAll(getNumCells());
+            delta_cells.markAll(getNumCells());
+        }
+
+        bool isDirty(const Index& idx) const
+        {
+            return dirty_cells.isDirty(idx, getNumCells());
+        }
+
+        /** @brief Returns the bounding box of all cells changed since the last reset */
+        CellExtents getDirtyExtents() const
+        {
+            return dirty_cells.getExtents(getNumCells());
+        }
+
+        /** @brief Calls f(const Index&) for each cell changed since the last reset */
+        template<class Function>
+        void forEachDirtyCell(Function f) const
+        {
+            dirty_cells.forEach(getNumCells(), f);
+        }
+
+        /** @brief Marks all cells as unchanged */
+        void resetDirty()
+        {
+            dirty_cells.reset(getNumCells());
+        }
+
+        /**
+         * @brief Creates a delta of the cells changed since the last delta and increments the revision of the map.
+         * @details The delta can be applied to a copy of this map which is at the
+         * revision the map had before this call. The next delta only contains the
+         * cells changed afterwards. The dirty cells reported by isDirty() and
+         * getDirtyExtents() are kept. Requires dirty tracking.
+         */
+        GridDelta<CellT> createDelta()
+        {
+            if (!isDirtyTrackingEnabled())
+                throw std::runtime_error("Dirty tracking has to be enabled to create a delta");
+
+            // read only access, which doesn't allocate cells of sparse grid storages
+            const GridMap& grid = *this;
+            GridDelta<CellT> delta(this->getDefaultValue());
+            delta.base_revision = revision;
+            delta.revision = ++revision;
+            delta.num_cells = getNumCells();
+            delta_cells.forEach(getNumCells(), [&](const Index& idx)
+            {
+                delta.indices.push_back(idx);
+                delta.cells.push_back(grid.at(idx));
+            });
+            delta_cells.reset(getNumCells());
+            return delta;
+        }
+
+        /**
+         * @brief Applies a delta created by createDelta() on another map.
+         * @details The map has to be at the base revision of the delta and gets
+         * the revision of the delta afterwards. The changed cells are marked dirty.
+         */
+        void applyDelta(const GridDelta<CellT>& delta)
+        {
+            if (delta.base_revision != revision)
+                throw std::runtime_error("Delta does not match the revision of the map");
+            if (delta.num_cells != getNumCells() || delta.indices.size() != delta.cells.size())
+                throw std::runtime_error("Delta does not match the size of the map");
+            // check all indices first, so a corrupt delta leaves the map unchanged
+            for (const Index& idx : delta.indices)
+            {
+                if (!inGrid(idx))
+                    throw std::runtime_error("Delta contains a cell outside of the map");
+            }
+
+            for (size_t i = 0; i < delta.indices.size(); ++i)
+            {
+                at(delta.indices[i]) = delta.cells[i];
+                markDirty(delta.indices[i]);
+            }
+            revision = delta.revision;
+        }
+
+        /** @brief Returns the revision of the map regarding createDelta() and applyDelta() */
+        uint64_t getRevision() const
+        {
+            return revision;
+        }
+
+        /**
+         * @brief Sets the revision, e.g. after the full map was transferred to a receiver.
+         * @details The next delta only contains the cells changed after this call.
+         */
+        void setRevision(uint64_t revision)
+        {
+            this->revision = revision;
+            delta_cells.reset(getNumCells());
+        }
+
         CellExtents calculateCellExtents() const
         {
             Vector2ui num_cells = getNumCells();
@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace maps { namespace grid
+{
+
+/**
+ * IEEE 754 half precision storage type.
+ * Values are converted with round-to-nearest-even, out of range values become infinity
+ * and NaN is preserved.
+ */
+struct HalfFloat
+{
+    uint16_t bits;
+
+    HalfFloat() : bits(0) {}
+    HalfFloat(float value) : bits(fromFloat(value)) {}
+
+    operator float() const
+    {
+        return toFloat(bits);
+    }
+
+    static uint16_t fromFloat(float value)
+    {
+        uint32_t f;
+        std::memcpy(&f, &value, sizeof(f));
+        const uint16_t sign = (f >> 16) & 0x8000;
+        const uint32_t exponent = (f >> 23) & 0xff;
+        uint32_t mantissa = f & 0x7fffff;
+
+        // NaN and infinity
+        if(exponent == 0xff)
+            return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+        const int32_t half_exponent = (int32_t)exponent - 127 + 15;
+        if(half_exponent >= 0x1f)
+            return sign | 0x7c00;
+
+        if(half_exponent <= 0)
+        {
+            // subnormal or zero
+            if(half_exponent < -10)
+                return sign;
+            mantissa |= 0x800000;
+            const uint32_t shift = 14 - half_exponent;
+            uint32_t half_mantissa = mantissa >> shift;
+            const uint32_t remainder = mantissa & ((1u << shift) - 1);
+            const uint32_t halfway = 1u << (shift - 1);
+            if(remainder > halfway || (remainder == halfway && (half_mantissa & 1)))
+                half_mantissa++;
+            return sign | half_mantissa;
+        }
+
+        uint32_t half = ((uint32_t)half_exponent << 10) | (mantissa >> 13);
+        const uint32_t remainder = mantissa & 0x1fff;
+        // a carry into the exponent correctly rounds up to the next power of two or infinity
+        if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+            half++;
+        return sign | half;
+    }
+
+    static float toFloat(uint16_t half)
+    {
+        const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+        uint32_t exponent = (half >> 10) & 0x1f;
+        uint32_t mantissa = half & 0x3ff;
+        uint32_t f;
+
+        if(exponent == 0x1f)
+            f = sign | 0x7f800000 | (mantissa << 13);
+        else if(exponent == 0)
+        {
+            if(mantissa == 0)
+                f = sign;
+            else
+            {
+                // normalize the subnormal value
+                exponent = 127 - 15 + 1;
+                while(!(mantissa & 0x400))
+                {
+                    mantissa <<= 1;
+                    exponent--;
+                }
+                f = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+            }
+        }
+        else
+            f = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+
+        float value;
+        std::memcpy(&value, &f, sizeof(value));
+        return value;
+    }
+};
+
+}}
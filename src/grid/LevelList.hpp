@@ -44,26 +44,38 @@ struct myCmp : public std::binary_function<_Tp, _Tp, bool>
     { return *__x < *__y; }
 };
     
-template <class S>
-class LevelList : public boost::container::flat_set<S>
+/**
+ * Sorted list of the elements of a grid cell.
+ *
+ * AllocatorOrContainer is passed to boost::container::flat_set, e.g. an
+ * ArenaAllocator to take the memory of all cells from one pool.
+ */
+template <class S, class AllocatorOrContainer = typename boost::container::flat_set<S>::allocator_type>
+class LevelList : public boost::container::flat_set<S, std::less<S>, AllocatorOrContainer>
 {
-    typedef boost::container::flat_set<S> Base;
+    typedef boost::container::flat_set<S, std::less<S>, AllocatorOrContainer> Base;
 public:
+    typedef typename Base::allocator_type allocator_type;
+
     LevelList()
     {
     };
+
+    explicit LevelList(const allocator_type& allocator) : Base(allocator)
+    {
+    };
 #if BOOST_VERSION < 105500
     // Custom copy constructor to work around boost bug:
     // https://svn.boost.org/trac/boost/ticket/9166
     // Note: This is fixed in version 1.55
-    LevelList(const LevelList& other) {
+    LevelList(const LevelList& other) : Base(other.get_allocator()) {
         if(other.size() > 0)
             *this = other;
     }
 #endif
 
-    template<class S2>
-    LevelList(const LevelList<S2>& other) : Base(other.begin(), other.end())
+    template<class S2, class A2>
+    LevelList(const LevelList<S2, A2>& other) : Base(other.begin(), other.end())
     { }
 
 protected:
@@ -76,14 +88,20 @@ protected:
     }
 };
 
-template <class S>
-class LevelList<S *> : public boost::container::flat_set<S *, myCmp<S *>>
+template <class S, class AllocatorOrContainer>
+class LevelList<S *, AllocatorOrContainer> : public boost::container::flat_set<S *, myCmp<S *>, AllocatorOrContainer>
 {
-    typedef boost::container::flat_set<S *, myCmp<S *> > Base;
+    typedef boost::container::flat_set<S *, myCmp<S *>, AllocatorOrContainer> Base;
 public:
+    typedef typename Base::allocator_type allocator_type;
+
     LevelList()
     {
     };
+
+    explicit LevelList(const allocator_type& allocator) : Base(allocator)
+    {
+    };
 #if BOOST_VERSION < 105500
     // Custom copy constructor to work around boost bug:
     // https://svn.boost.org/trac/boost/ticket/9166
@@ -123,8 +141,8 @@ public:
         }
     }
 
-    template<class S2>
-    LevelList(const LevelList<S2>& other) : boost::container::flat_set<S *, myCmp<S *>>(other.begin(), other.end())
+    template<class S2, class A2>
+    LevelList(const LevelList<S2, A2>& other) : Base(other.begin(), other.end())
     { 
     }
     
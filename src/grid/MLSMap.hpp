@@ -30,6 +30,8 @@
 #include <vector>
 #include <set>
 #include <exception>
+#include <algorithm>
+#include <limits>
 
 #include <Eigen/Geometry>
 
@@ -39,11 +41,15 @@
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/shared_ptr.hpp>
+#include <boost/serialization/base_object.hpp>
+#include <boost/serialization/version.hpp>
 
 #include "MultiLevelGridMap.hpp"
 #include "MLSConfig.hpp"
 #include "SurfacePatches.hpp"
 #include "OccupancyGridMapBase.hpp"
+#include "MergeStatistics.hpp"
+#include "../tools/ParallelFor.hpp"
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
@@ -55,19 +61,27 @@ namespace maps { namespace grid
 {
     typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
 
-    template<enum MLSConfig::update_model  SurfaceType>
-    class MLSMap : public MultiLevelGridMap<SurfacePatch<SurfaceType> >
+    /**
+     * Multi-level surface map.
+     * GridT is the storage of the cells, see MultiLevelGridMap.
+     */
+    template<enum MLSConfig::update_model  SurfaceType,
+             class AllocatorOrContainer = typename LevelList< SurfacePatch<SurfaceType> >::allocator_type,
+             class GridT = VectorGrid< LevelList<SurfacePatch<SurfaceType>, AllocatorOrContainer> > >
+    class MLSMap : public MultiLevelGridMap<SurfacePatch<SurfaceType>, AllocatorOrContainer, GridT>
     {
         public:
             typedef SurfacePatch<SurfaceType> Patch;
-            typedef MultiLevelGridMap<Patch> Base;
-            typedef LevelList<Patch> CellType; 
+            typedef MultiLevelGridMap<Patch, AllocatorOrContainer, GridT> Base;
+            typedef typename Base::CellType CellType; 
+            typedef typename Base::allocator_type allocator_type;
 
         MLSMap(
                 const Vector2ui &num_cells,
                 const Vector2d &resolution,
-                const MLSConfig &config_)
-        : Base(num_cells, resolution)
+                const MLSConfig &config_,
+                const allocator_type &allocator = MapAllocator<allocator_type>::create())
+        : Base(num_cells, resolution, allocator)
         , config(config_)
         {
             // TODO assert that config is compatible to SurfaceType ...
@@ -78,8 +92,9 @@ namespace maps { namespace grid
             // empty
         }
 
-        template<enum MLSConfig::update_model OtherSurfaceType>
-        MLSMap(const MLSMap<OtherSurfaceType>& other) : Base(other)
+        template<enum MLSConfig::update_model OtherSurfaceType, class OtherAllocatorOrContainer, class OtherGridT>
+        MLSMap(const MLSMap<OtherSurfaceType, OtherAllocatorOrContainer, OtherGridT>& other,
+               const allocator_type &allocator = MapAllocator<allocator_type>::create()) : Base(other, allocator)
         {
 
         }
@@ -184,8 +199,14 @@ namespace maps { namespace grid
             throw std::runtime_error("mergeMLS is not yet implemented!");
         }
 
-        void mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2mls, double measurement_variance = 0.01)
+        /**
+         * Adds the point cloud to the map.
+         * Points outside of the grid or in known free space are skipped and reported in the
+         * returned statistics.
+         */
+        MergeStatistics mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2mls, double measurement_variance = 0.01)
         {
+            MergeStatistics stats;
             base::Transform3d pc2grid = Base::prepareToGridOptimized(pc2mls);
             if(hasFreeSpaceMap())
             {
@@ -196,37 +217,26 @@ namespace maps { namespace grid
                     Eigen::Vector3d measurement = it->getArray3fMap().cast<double>();
                     Eigen::Vector3d measurement_in_map = pc2mls * measurement;
 
-                    try
-                    {
-                        if(!free_space_map->isFreeSpace(measurement_in_map))
-                            mergePoint(measurement, pc2grid, measurement_variance);
-
-                        free_space_map->mergePoint(sensor_origin_in_mls, measurement_in_map);
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
+                    if(filterFreeSpace(measurement_in_map, stats, [&]() { return tryMergePoint(measurement, pc2grid, measurement_variance); }))
+                        free_space_map->tryMergePoint(sensor_origin_in_mls, measurement_in_map);
                 }
             }
             else
             {
                 for(PointCloud::const_iterator it=pc.begin(); it != pc.end(); ++it)
                 {
-                    try
-                    {
-                        mergePoint(it->getArray3fMap().cast<double>(), pc2grid, measurement_variance);
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
+                    if(tryMergePoint(it->getArray3fMap().cast<double>(), pc2grid, measurement_variance))
+                        stats.merged++;
+                    else
+                        stats.outside_grid++;
                 }
             }
+            return stats;
         }
 
-        void mergePointCloud(const PointCloud& pc, const base::TransformWithCovariance& pc2mls, double measurement_variance = 0.01)
+        MergeStatistics mergePointCloud(const PointCloud& pc, const base::TransformWithCovariance& pc2mls, double measurement_variance = 0.01)
         {
+            MergeStatistics stats;
             base::Transform3d pc2grid = Base::prepareToGridOptimized(pc2mls.getTransform());
             if(hasFreeSpaceMap())
             {
@@ -237,18 +247,10 @@ namespace maps { namespace grid
                     Eigen::Vector3d measurement = it->getArray3fMap().cast<double>();
                     std::pair<Eigen::Vector3d, Eigen::Matrix3d> measurement_in_map = pc2mls.composePointWithCovariance(measurement, Eigen::Matrix3d::Zero());
 
-                    try
-                    {
-                        if(!free_space_map->isFreeSpace(measurement_in_map.first))
-                            mergePoint(measurement, pc2grid, measurement_variance + measurement_in_map.second(2,2));
-
-                        if(measurement_in_map.second(2,2) <= free_space_map->getConfig().uncertainty_threshold)
-                            free_space_map->mergePoint(sensor_origin_in_mls, measurement_in_map.first);
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
+                    if(filterFreeSpace(measurement_in_map.first, stats,
+                            [&]() { return tryMergePoint(measurement, pc2grid, measurement_variance + measurement_in_map.second(2,2)); })
+                        && measurement_in_map.second(2,2) <= free_space_map->getConfig().uncertainty_threshold)
+                        free_space_map->tryMergePoint(sensor_origin_in_mls, measurement_in_map.first);
                 }
             }
             else
@@ -257,22 +259,20 @@ namespace maps { namespace grid
                 {
                     Eigen::Vector3d point = it->getArray3fMap().cast<double>();
                     std::pair<Eigen::Vector3d, Eigen::Matrix3d> point_with_cov = pc2mls.composePointWithCovariance(point, Eigen::Matrix3d::Zero());
-                    try
-                    {
-                        mergePoint(point, pc2grid, measurement_variance + point_with_cov.second(2,2));
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
+                    if(tryMergePoint(point, pc2grid, measurement_variance + point_with_cov.second(2,2)))
+                        stats.merged++;
+                    else
+                        stats.outside_grid++;
                 }
             }
+            return stats;
         }
 
         template<int _MatrixOptions>
-        void mergePointCloud(const std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >& pc, const base::TransformWithCovariance& pc2mls,
-                             const base::Vector3d& sensor_origin_in_pc = base::Vector3d::Zero(), double measurement_variance = 0.01)
+        MergeStatistics mergePointCloud(const std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >& pc, const base::TransformWithCovariance& pc2mls,
+                                        const base::Vector3d& sensor_origin_in_pc = base::Vector3d::Zero(), double measurement_variance = 0.01)
         {
+            MergeStatistics stats;
             base::Transform3d pc2grid = Base::prepareToGridOptimized(pc2mls.getTransform());
             if(hasFreeSpaceMap())
             {
@@ -281,18 +281,10 @@ namespace maps { namespace grid
                 {
                     std::pair<Eigen::Vector3d, Eigen::Matrix3d> measurement_in_map = pc2mls.composePointWithCovariance(*it, Eigen::Matrix3d::Zero());
 
-                    try
-                    {
-                        if(!free_space_map->isFreeSpace(measurement_in_map.first))
-                            mergePoint(*it, pc2grid, measurement_variance + measurement_in_map.second(2,2));
-
-                        if(measurement_in_map.second(2,2) <= free_space_map->getConfig().uncertainty_threshold)
-                            free_space_map->mergePoint(sensor_origin_in_mls, measurement_in_map.first);
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
+                    if(filterFreeSpace(measurement_in_map.first, stats,
+                            [&]() { return tryMergePoint(*it, pc2grid, measurement_variance + measurement_in_map.second(2,2)); })
+                        && measurement_in_map.second(2,2) <= free_space_map->getConfig().uncertainty_threshold)
+                        free_space_map->tryMergePoint(sensor_origin_in_mls, measurement_in_map.first);
                 }
             }
             else
@@ -300,19 +292,160 @@ namespace maps { namespace grid
                 for(typename std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >::const_iterator it = pc.begin(); it != pc.end(); ++it)
                 {
                     std::pair<Eigen::Vector3d, Eigen::Matrix3d> point_with_cov = pc2mls.composePointWithCovariance(*it, Eigen::Matrix3d::Zero());
-                    try
-                    {
-                        mergePoint(*it, pc2grid, measurement_variance + point_with_cov.second(2,2));
-                    }
-                    catch(const std::runtime_error& e)
-                    {
-                        LOG_ERROR_S << e.what();
-                    }
+                    if(tryMergePoint(*it, pc2grid, measurement_variance + point_with_cov.second(2,2)))
+                        stats.merged++;
+                    else
+                        stats.outside_grid++;
+                }
+            }
+            return stats;
+        }
+
+        /**
+         * Batched variant of mergePointCloud(const PointCloud&, const base::Transform3d&, double).
+         * All points are transformed and binned by their grid cell first, afterwards the cells are
+         * updated in parallel using up to \c num_threads threads (0 selects the number of hardware threads).
+         * The points of a cell are merged in the order in which they appear in the cloud, hence the
+         * resulting map is identical to the one of the serial implementation.
+         */
+        MergeStatistics mergePointCloudBatched(const PointCloud& pc, const base::Transform3d& pc2mls, double measurement_variance = 0.01, unsigned num_threads = 0)
+        {
+            MergeStatistics stats;
+            base::Transform3d pc2grid = Base::prepareToGridOptimized(pc2mls);
+            std::vector<BinEntry> bins(pc.size());
+            std::vector<Patch> patches(pc.size());
+            if(hasFreeSpaceMap())
+            {
+                // the free space map is updated point by point, only the binning is done here
+                Eigen::Vector3d sensor_origin = pc.sensor_origin_.block(0,0,3,1).cast<double>();
+                Eigen::Vector3d sensor_origin_in_mls = pc2mls * sensor_origin;
+                for(size_t i = 0; i < pc.size(); ++i)
+                {
+                    bins[i].first = INVALID_BIN;
+                    Eigen::Vector3d measurement = pc[i].getArray3fMap().cast<double>();
+                    Eigen::Vector3d measurement_in_map = pc2mls * measurement;
+
+                    if(filterFreeSpace(measurement_in_map, stats,
+                            [&]() { return binPoint(measurement, pc2grid, measurement_variance, i, bins[i], patches[i]); }))
+                        free_space_map->tryMergePoint(sensor_origin_in_mls, measurement_in_map);
+                }
+                mergeBinnedPatches(bins, patches, num_threads);
+            }
+            else
+            {
+                tools::parallelFor(0, pc.size(), [&](size_t i)
+                {
+                    binPoint(pc[i].getArray3fMap().cast<double>(), pc2grid, measurement_variance, i, bins[i], patches[i]);
+                }, num_threads, 4096);
+                stats.merged = mergeBinnedPatches(bins, patches, num_threads);
+                stats.outside_grid = pc.size() - stats.merged;
+            }
+            return stats;
+        }
+
+        /**
+         * Batched variant of mergePointCloud(const PointCloud&, const base::TransformWithCovariance&, double).
+         * See mergePointCloudBatched(const PointCloud&, const base::Transform3d&, double, unsigned).
+         */
+        MergeStatistics mergePointCloudBatched(const PointCloud& pc, const base::TransformWithCovariance& pc2mls, double measurement_variance = 0.01, unsigned num_threads = 0)
+        {
+            MergeStatistics stats;
+            base::Transform3d pc2grid = Base::prepareToGridOptimized(pc2mls.getTransform());
+            std::vector<BinEntry> bins(pc.size());
+            std::vector<Patch> patches(pc.size());
+            if(hasFreeSpaceMap())
+            {
+                // the free space map is updated point by point, only the binning is done here
+                Eigen::Vector3d sensor_origin = pc.sensor_origin_.block(0,0,3,1).cast<double>();
+                Eigen::Vector3d sensor_origin_in_mls = pc2mls.getTransform() * sensor_origin;
+                for(size_t i = 0; i < pc.size(); ++i)
+                {
+                    bins[i].first = INVALID_BIN;
+                    Eigen::Vector3d measurement = pc[i].getArray3fMap().cast<double>();
+                    std::pair<Eigen::Vector3d, Eigen::Matrix3d> measurement_in_map = pc2mls.composePointWithCovariance(measurement, Eigen::Matrix3d::Zero());
+
+                    if(filterFreeSpace(measurement_in_map.first, stats,
+                            [&]() { return binPoint(measurement, pc2grid, measurement_variance + measurement_in_map.second(2,2), i, bins[i], patches[i]); })
+                        && measurement_in_map.second(2,2) <= free_space_map->getConfig().uncertainty_threshold)
+                        free_space_map->tryMergePoint(sensor_origin_in_mls, measurement_in_map.first);
                 }
+                mergeBinnedPatches(bins, patches, num_threads);
             }
+            else
+            {
+                tools::parallelFor(0, pc.size(), [&](size_t i)
+                {
+                    Eigen::Vector3d point = pc[i].getArray3fMap().cast<double>();
+                    std::pair<Eigen::Vector3d, Eigen::Matrix3d> point_with_cov = pc2mls.composePointWithCovariance(point, Eigen::Matrix3d::Zero());
+                    binPoint(point, pc2grid, measurement_variance + point_with_cov.second(2,2), i, bins[i], patches[i]);
+                }, num_threads, 4096);
+                stats.merged = mergeBinnedPatches(bins, patches, num_threads);
+                stats.outside_grid = pc.size() - stats.merged;
+            }
+            return stats;
         }
 
         void mergePatch(const Index &idx, const Patch& new_patch)
+        {
+            mergePatchIntoCell(idx, new_patch);
+            Base::markDirty(idx);
+        }
+
+        void mergePoint(const Eigen::Vector3d& point, double measurement_variance = 0.01)
+        {
+            if(!tryMergePoint(point, measurement_variance))
+                throw std::runtime_error((boost::format("Point %1% is outside of the grid! Can't add to grid.") % point.transpose()).str());
+        }
+
+        /**
+         * Adds a point with the given transformation to the grid.
+         * Note: Use \c prepareToGridOptimized to prepare the pc2gridframe transformation.
+         * The measurement variance is the uncertainty on the z axis of the point.
+         */
+        void mergePoint(const Eigen::Vector3d& point, const base::Transform3d& pc2gridframe, double measurement_variance = 0.01)
+        {
+            if(!tryMergePoint(point, pc2gridframe, measurement_variance))
+                throw std::runtime_error((boost::format("Point %1% is outside of the grid! Can't add to grid.") % point.transpose()).str());
+        }
+
+        /**
+         * Non-throwing variant of mergePoint(const Eigen::Vector3d&, double).
+         * Returns false if the point is outside of the grid.
+         */
+        bool tryMergePoint(const Eigen::Vector3d& point, double measurement_variance = 0.01)
+        {
+            Eigen::Vector3d pos_diff;
+            Index idx;
+            if(!Base::toGrid(point, idx, pos_diff))
+                return false;
+            mergePatch(idx, Patch(pos_diff.cast<float>(), measurement_variance));
+            return true;
+        }
+
+        /**
+         * Non-throwing variant of mergePoint(const Eigen::Vector3d&, const base::Transform3d&, double).
+         * Returns false if the point is outside of the grid.
+         */
+        bool tryMergePoint(const Eigen::Vector3d& point, const base::Transform3d& pc2gridframe, double measurement_variance = 0.01)
+        {
+            Eigen::Vector3d pos_diff;
+            Index idx;
+            if(!Base::toGridOptimized(point, idx, pos_diff, pc2gridframe))
+                return false;
+            mergePatch(idx, Patch(pos_diff.cast<float>(), measurement_variance));
+            return true;
+        }
+
+    private:
+        MLSConfig config;
+        boost::shared_ptr<OccupancyGridMapBase> free_space_map;
+
+        /** Linear cell index and position in the point cloud of a binned patch */
+        typedef std::pair<size_t, size_t> BinEntry;
+        static const size_t INVALID_BIN = std::numeric_limits<size_t>::max();
+
+        /** Merges a patch without marking the cell as dirty, safe to be called in parallel on different cells */
+        void mergePatchIntoCell(const Index &idx, const Patch& new_patch)
         {
             CellType &list = Base::at(idx);
 
@@ -332,40 +465,102 @@ namespace maps { namespace grid
             list.insert(new_patch);
         }
 
-        void mergePoint(const Eigen::Vector3d& point, double measurement_variance = 0.01)
+        bool merge(Patch& a, const Patch& b)
+        {
+            return a.merge(b, config);
+        }
+
+        /**
+         * Computes the cell and the patch of a point without modifying the map.
+         * Returns false and invalidates the bin if the point is outside of the grid.
+         */
+        bool binPoint(const Eigen::Vector3d& point, const base::Transform3d& pc2gridframe, double measurement_variance,
+                      size_t order, BinEntry& bin, Patch& patch)
         {
             Eigen::Vector3d pos_diff;
             Index idx;
-            if(Base::toGrid(point, idx, pos_diff))
-                mergePatch(idx, Patch(pos_diff.cast<float>(), measurement_variance));
-            else
-                throw std::runtime_error((boost::format("Point %1% is outside of the grid! Can't add to grid.") % point.transpose()).str());
+            if(!Base::toGridOptimized(point, idx, pos_diff, pc2gridframe))
+            {
+                bin.first = INVALID_BIN;
+                return false;
+            }
+            bin.first = idx.x() + size_t(idx.y()) * Base::getNumCells().x();
+            bin.second = order;
+            patch = Patch(pos_diff.cast<float>(), measurement_variance);
+            return true;
         }
 
         /**
-         * Adds a point with the given transformation to the grid.
-         * Note: Use \c prepareToGridOptimized to prepare the pc2gridframe transformation.
-         * The measurement variance is the uncertainty on the z axis of the point.
+         * Checks a measurement against the free space map.
+         * \c merge is called if the measurement is not in free space and returns false if
+         * the measurement is outside of the grid.
+         * Returns true if the free space map shall be updated with the measurement.
          */
-        void mergePoint(const Eigen::Vector3d& point, const base::Transform3d& pc2gridframe, double measurement_variance = 0.01)
+        template<class MergeFunction>
+        bool filterFreeSpace(const Eigen::Vector3d& measurement_in_map, MergeStatistics& stats, MergeFunction merge)
         {
-            Eigen::Vector3d pos_diff;
             Index idx;
-            if(Base::toGridOptimized(point, idx, pos_diff, pc2gridframe))
+            if(!Base::toGrid(measurement_in_map, idx))
             {
-                mergePatch(idx, Patch(pos_diff.cast<float>(), measurement_variance));
+                stats.outside_grid++;
+                return false;
             }
+
+            if(free_space_map->isFreeSpace(idx, measurement_in_map.z()))
+                stats.free_space_filtered++;
+            else if(merge())
+                stats.merged++;
             else
-                throw std::runtime_error((boost::format("Point %1% is outside of the grid! Can't add to grid.") % point.transpose()).str());
+            {
+                stats.outside_grid++;
+                return false;
+            }
+            return true;
         }
 
-    private:
-        MLSConfig config;
-        boost::shared_ptr<OccupancyGridMapBase> free_space_map;
-
-        bool merge(Patch& a, const Patch& b)
+        /**
+         * Merges the binned patches cell by cell. Different cells are processed in parallel,
+         * the patches of one cell are merged in the order of the point cloud.
+         * Returns the number of merged patches.
+         */
+        size_t mergeBinnedPatches(std::vector<BinEntry>& bins, const std::vector<Patch>& patches, unsigned num_threads)
         {
-            return a.merge(b, config);
+            // sort by cell and order, invalid bins end up at the back
+            std::sort(bins.begin(), bins.end());
+            bins.erase(std::lower_bound(bins.begin(), bins.end(), BinEntry(INVALID_BIN, 0)), bins.end());
+
+            std::vector<size_t> cell_starts;
+            for(size_t i = 0; i < bins.size(); ++i)
+            {
+                if(i == 0 || bins[i].first != bins[i-1].first)
+                    cell_starts.push_back(i);
+            }
+            cell_starts.push_back(bins.size());
+
+            const size_t num_cells_x = Base::getNumCells().x();
+            // grid storages like TiledGrid allocate on the first write access, which must not happen concurrently
+            for(size_t c = 0; c + 1 < cell_starts.size(); ++c)
+            {
+                const size_t cell = bins[cell_starts[c]].first;
+                Base::at(Index(cell % num_cells_x, cell / num_cells_x));
+            }
+            tools::parallelFor(0, cell_starts.size() - 1, [&](size_t c)
+            {
+                const size_t cell = bins[cell_starts[c]].first;
+                const Index idx(cell % num_cells_x, cell / num_cells_x);
+                for(size_t i = cell_starts[c]; i < cell_starts[c+1]; ++i)
+                    mergePatchIntoCell(idx, patches[bins[i].second]);
+            }, num_threads);
+
+            if(Base::isDirtyTrackingEnabled())
+            {
+                for(size_t c = 0; c + 1 < cell_starts.size(); ++c)
+                {
+                    const size_t cell = bins[cell_starts[c]].first;
+                    Base::markDirty(Index(cell % num_cells_x, cell / num_cells_x));
+                }
+            }
+            return bins.size();
         }
 
         bool isCovered(const Index &idx, float zPos, const float gapSize = 0.0)
@@ -418,7 +613,7 @@ namespace maps { namespace grid
         template<class Archive>
         void save(Archive & ar, const unsigned int version) const
         {
-            ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(MultiLevelGridMap<SurfacePatch<SurfaceType>>);
+            ar & boost::serialization::make_nvp("MultiLevelGridMap<SurfacePatch<SurfaceType>>", boost::serialization::base_object<Base>(*this));
             ar & BOOST_SERIALIZATION_NVP(config);
             ar & BOOST_SERIALIZATION_NVP(free_space_map);
         }
@@ -426,7 +621,7 @@ namespace maps { namespace grid
         template<class Archive>
         void load(Archive & ar, const unsigned int version)
         {
-            ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(MultiLevelGridMap<SurfacePatch<SurfaceType>>);
+            ar & boost::serialization::make_nvp("MultiLevelGridMap<SurfacePatch<SurfaceType>>", boost::serialization::base_object<Base>(*this));
             ar & BOOST_SERIALIZATION_NVP(config);
             if(version >= 1)
                 ar & BOOST_SERIALIZATION_NVP(free_space_map);
@@ -435,6 +630,9 @@ namespace maps { namespace grid
         BOOST_SERIALIZATION_SPLIT_MEMBER()
     };
 
+    template<enum MLSConfig::update_model SurfaceType, class AllocatorOrContainer, class GridT>
+    const size_t MLSMap<SurfaceType, AllocatorOrContainer, GridT>::INVALID_BIN;
+
     typedef MLSMap<MLSConfig::BASE> MLSMapBase;
     typedef MLSMap<MLSConfig::SLOPE> MLSMapSloped;
     typedef MLSMap<MLSConfig::KALMAN> MLSMapKalman;
@@ -443,9 +641,15 @@ namespace maps { namespace grid
 } /* namespace grid */
 } /* namespace maps */
 
-BOOST_CLASS_VERSION(maps::grid::MLSMap<maps::grid::MLSConfig::BASE>, 1)
-BOOST_CLASS_VERSION(maps::grid::MLSMap<maps::grid::MLSConfig::SLOPE>, 1)
-BOOST_CLASS_VERSION(maps::grid::MLSMap<maps::grid::MLSConfig::KALMAN>, 1)
-BOOST_CLASS_VERSION(maps::grid::MLSMap<maps::grid::MLSConfig::PRECALCULATED>, 1)
+namespace boost { namespace serialization {
+    // version 1 of all MLSMap types, independent of the allocator and the grid storage
+    template<maps::grid::MLSConfig::update_model SurfaceType, class AllocatorOrContainer, class GridT>
+    struct version< maps::grid::MLSMap<SurfaceType, AllocatorOrContainer, GridT> >
+    {
+        typedef mpl::int_<1> type;
+        typedef mpl::integral_c_tag tag;
+        BOOST_STATIC_CONSTANT(int, value = version::type::value);
+    };
+}}
 
 #endif // __MAPS_MLS_GRID_HPP__
@@ -0,0 +1,293 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#include "MapSnapshot.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace maps;
+using namespace maps::grid;
+
+static const char SNAPSHOT_MAGIC[8] = {'M', 'A', 'P', 'S', 'N', 'A', 'P', '\0'};
+static const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+MappedFile::MappedFile(const std::string& path)
+    : ptr(NULL), length(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Could not stat " + path + ": " + std::strerror(error));
+    }
+    length = st.st_size;
+
+    void* mapping = ::mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    int error = errno;
+    // the mapping stays valid after closing the descriptor
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Could not map " + path + ": " + std::strerror(error));
+    ptr = static_cast<const char*>(mapping);
+}
+
+MappedFile::~MappedFile()
+{
+    ::munmap(const_cast<char*>(ptr), length);
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path, SnapshotContent content, uint32_t cell_size, uint32_t cell_type,
+                               const LocalMap& map, const Vector2ui& num_cells, const Vector2d& resolution)
+    : out(path.c_str(), std::ios::binary | std::ios::trunc)
+    , data_started(false)
+{
+    if (!out)
+        throw std::runtime_error("Could not open " + path);
+
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.content = content;
+    header.cell_size = cell_size;
+    header.cell_type = cell_type;
+    header.map_type = map.getMapType();
+    header.num_cells[0] = num_cells.x();
+    header.num_cells[1] = num_cells.y();
+    header.resolution[0] = resolution.x();
+    header.resolution[1] = resolution.y();
+    Eigen::Map<Eigen::Matrix4d>(header.local_frame) = map.getLocalFrame().matrix();
+
+    // placeholder, the header is rewritten by finish()
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<char> metadata;
+    for (const std::string* str : {&map.getId(), &map.getEPSGCode()})
+    {
+        uint32_t length = str->size();
+        metadata.insert(metadata.end(), reinterpret_cast<const char*>(&length), reinterpret_cast<const char*>(&length) + sizeof(length));
+        metadata.insert(metadata.end(), str->begin(), str->end());
+    }
+    header.metadata_offset = beginSection();
+    header.metadata_size = metadata.size();
+    out.write(metadata.data(), metadata.size());
+}
+
+uint64_t SnapshotWriter::beginSection()
+{
+    uint64_t pos = out.tellp();
+    static const char padding[SNAPSHOT_ALIGNMENT] = {0};
+    uint64_t aligned = (pos + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+    out.write(padding, aligned - pos);
+    return aligned;
+}
+
+void SnapshotWriter::writeExtra(const void* extra, size_t size)
+{
+    header.extra_offset = beginSection();
+    header.extra_size = size;
+    out.write(static_cast<const char*>(extra), size);
+}
+
+void SnapshotWriter::writeOffsets(const std::vector<uint32_t>& offsets)
+{
+    header.offsets_offset = beginSection();
+    header.offsets_count = offsets.size();
+    out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+}
+
+void SnapshotWriter::writeData(const void* data, size_t size)
+{
+    if (!data_started)
+    {
+        header.data_offset = beginSection();
+        data_started = true;
+    }
+    header.data_size += size;
+    out.write(static_cast<const char*>(data), size);
+}
+
+void SnapshotWriter::finish()
+{
+    if (!data_started)
+        header.data_offset = beginSection();
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.flush();
+    if (!out)
+        throw std::runtime_error("Failed to write snapshot");
+}
+
+MapSnapshot::MapSnapshot(const std::string& path, SnapshotContent content, uint32_t cell_size, uint32_t cell_type)
+    : LocalMap(content == SNAPSHOT_MLS_MAP ? MLS_MAP : GRID_MAP)
+    , file(new MappedFile(path))
+{
+    if (file->size() < sizeof(SnapshotHeader))
+        throw std::runtime_error(path + " is not a map snapshot");
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error(path + " is not a map snapshot");
+    if (header.version != SNAPSHOT_VERSION)
+        throw std::runtime_error("Snapshot " + path + " has an unsupported version");
+    if (header.byte_order != SNAPSHOT_BYTE_ORDER)
+        throw std::runtime_error("Snapshot " + path + " was written with a different byte order");
+    if (header.content != uint32_t(content) || header.cell_size != cell_size || header.cell_type != cell_type)
+        throw std::runtime_error("Snapshot " + path + " contains a different map type");
+
+    // the size of the offsets section must not overflow
+    if (header.offsets_count > file->size() / sizeof(uint32_t))
+        throw std::runtime_error("Snapshot " + path + " is truncated");
+    const uint64_t sections[4][2] = {
+        {header.metadata_offset, header.metadata_size},
+        {header.extra_offset, header.extra_size},
+        {header.offsets_offset, header.offsets_count * sizeof(uint32_t)},
+        {header.data_offset, header.data_size}};
+    for (const uint64_t* section : sections)
+    {
+        if (section[0] > file->size() || section[1] > file->size() - section[0])
+            throw std::runtime_error("Snapshot " + path + " is truncated");
+        // the cells are accessed in place, which requires aligned sections
+        if (section[0] % SNAPSHOT_ALIGNMENT != 0)
+            throw std::runtime_error("Snapshot " + path + " is corrupt");
+    }
+
+    num_cells = Vector2ui(header.num_cells[0], header.num_cells[1]);
+    resolution = Vector2d(header.resolution[0], header.resolution[1]);
+    getMapType() = LocalMapType(header.map_type);
+    getLocalFrame().matrix() = Eigen::Map<const Eigen::Matrix4d>(header.local_frame);
+
+    const char* metadata = file->data() + header.metadata_offset;
+    const char* metadata_end = metadata + header.metadata_size;
+    for (std::string* str : {&getId(), &getEPSGCode()})
+    {
+        uint32_t length;
+        if (metadata_end - metadata < int64_t(sizeof(length)))
+            throw std::runtime_error("Snapshot " + path + " is corrupt");
+        std::memcpy(&length, metadata, sizeof(length));
+        metadata += sizeof(length);
+        if (metadata_end - metadata < int64_t(length))
+            throw std::runtime_error("Snapshot " + path + " is corrupt");
+        str->assign(metadata, length);
+        metadata += length;
+    }
+}
+
+SnapshotHeader MapSnapshot::readHeader(const std::string& path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    SnapshotHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error(path + " is not a map snapshot");
+    return header;
+}
+
+void MapSnapshot::copyLocalMapTo(LocalMap& map) const
+{
+    map.getId() = getId();
+    map.getEPSGCode() = getEPSGCode();
+    map.getMapType() = getMapType();
+    map.getLocalFrame() = getLocalFrame();
+}
+
+MappedTraversabilityGrid::MappedTraversabilityGrid(const std::string& path)
+    : MapSnapshot(path, SNAPSHOT_TRAVERSABILITY_GRID, 2)
+{
+    if (header.extra_size < 2 || (header.extra_size - 2) % sizeof(float) != 0
+        || header.data_size != getNumCellsTotal() * 2)
+        throw std::runtime_error("Snapshot " + path + " is corrupt");
+}
+
+TraversabilityCell MappedTraversabilityGrid::getDefaultValue() const
+{
+    const uint8_t* cell = reinterpret_cast<const uint8_t*>(getExtra());
+    return TraversabilityCell(cell[0], cell[1]);
+}
+
+std::vector<TraversabilityClass> MappedTraversabilityGrid::getTraversabilityClasses() const
+{
+    // the default value is followed by the drivability of each class
+    std::vector<TraversabilityClass> classes((header.extra_size - 2) / sizeof(float));
+    for (size_t i = 0; i < classes.size(); ++i)
+    {
+        float drivability;
+        std::memcpy(&drivability, getExtra() + 2 + i * sizeof(float), sizeof(float));
+        classes[i] = TraversabilityClass(drivability);
+    }
+    return classes;
+}
+
+TraversabilityGrid MappedTraversabilityGrid::toMap() const
+{
+    TraversabilityGrid grid(num_cells, resolution, getDefaultValue());
+    copyLocalMapTo(grid);
+    std::vector<TraversabilityClass> classes = getTraversabilityClasses();
+    for (size_t i = 0; i < classes.size(); ++i)
+        grid.setTraversabilityClass(i, classes[i]);
+    for (unsigned y = 0; y < num_cells.y(); ++y)
+        for (unsigned x = 0; x < num_cells.x(); ++x)
+            grid.at(x, y) = at(x, y);
+    return grid;
+}
+
+void maps::grid::saveSnapshot(const std::string& path, const TraversabilityGrid& grid)
+{
+    SnapshotWriter writer(path, SNAPSHOT_TRAVERSABILITY_GRID, 2, 0, grid, grid.getNumCells(), grid.getResolution());
+
+    std::vector<char> extra(2);
+    extra[0] = grid.getDefaultValue().getTraversabilityClassId();
+    extra[1] = grid.getDefaultValue().getProbability();
+    for (const TraversabilityClass& traversability_class : grid.getTraversabilityClasses())
+    {
+        // undefined classes are stored with their negative drivability
+        float drivability = traversability_class.isClassDefined() ? traversability_class.getDrivability() : -1.f;
+        extra.insert(extra.end(), reinterpret_cast<const char*>(&drivability), reinterpret_cast<const char*>(&drivability) + sizeof(float));
+    }
+    writer.writeExtra(extra.data(), extra.size());
+
+    std::vector<uint8_t> row(2 * grid.getNumCells().x());
+    for (unsigned y = 0; y < grid.getNumCells().y(); ++y)
+    {
+        for (unsigned x = 0; x < grid.getNumCells().x(); ++x)
+        {
+            row[2 * x] = grid.at(x, y).getTraversabilityClassId();
+            row[2 * x + 1] = grid.at(x, y).getProbability();
+        }
+        writer.writeData(row.data(), row.size());
+    }
+    writer.finish();
+}
@@ -0,0 +1,441 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <stdint.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <maps/LocalMap.hpp>
+#include <maps/grid/GridMap.hpp>
+#include <maps/grid/MLSMap.hpp>
+#include <maps/grid/CompactMLSMap.hpp>
+#include <maps/grid/TraversabilityGrid.hpp>
+
+namespace maps { namespace grid
+{
+    /**
+     * @file
+     * Flat on-disk layout of maps which can be used directly from a memory
+     * mapped file, i.e. without deserialization.
+     *
+     * A snapshot consists of a SnapshotHeader followed by the sections
+     * - metadata: id and EPSG code of the LocalMap
+     * - extra: content specific data, e.g. the MLSConfig or the default value
+     * - offsets: CSR table with num_cells + 1 uint32 offsets into the data (MLS only)
+     * - data: cells or patches, stored as in memory in row major cell order
+     *
+     * All sections start at a multiple of SNAPSHOT_ALIGNMENT. Snapshots use
+     * the byte order and type layout of the writing host.
+     */
+
+    /** Content of a snapshot */
+    enum SnapshotContent
+    {
+        SNAPSHOT_GRID_MAP = 1,
+        SNAPSHOT_MLS_MAP = 2,
+        SNAPSHOT_TRAVERSABILITY_GRID = 3
+    };
+
+    static const uint32_t SNAPSHOT_VERSION = 1;
+    static const uint64_t SNAPSHOT_ALIGNMENT = 64;
+
+    struct SnapshotHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t content;
+        /** Size of a cell or patch, used to detect mismatching types */
+        uint32_t cell_size;
+        /** MLSConfig::update_model for MLS snapshots */
+        uint32_t cell_type;
+        int32_t map_type;
+        uint32_t num_cells[2];
+        double resolution[2];
+        /** Column major matrix of the local frame */
+        double local_frame[16];
+        uint64_t metadata_offset, metadata_size;
+        uint64_t extra_offset, extra_size;
+        uint64_t offsets_offset, offsets_count;
+        uint64_t data_offset, data_size;
+    };
+
+    /** Read-only memory mapping of a whole file */
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        const char* data() const { return ptr; }
+        size_t size() const { return length; }
+
+    private:
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+
+        const char* ptr;
+        size_t length;
+    };
+
+    /**
+     * Writes the sections of a snapshot in order. The header is written
+     * last by finish(), since it contains the section positions.
+     */
+    class SnapshotWriter
+    {
+    public:
+        SnapshotWriter(const std::string& path, SnapshotContent content, uint32_t cell_size, uint32_t cell_type,
+                       const LocalMap& map, const Vector2ui& num_cells, const Vector2d& resolution);
+
+        void writeExtra(const void* extra, size_t size);
+        void writeOffsets(const std::vector<uint32_t>& offsets);
+
+        /** Appends to the data section, which starts with the first call */
+        void writeData(const void* data, size_t size);
+
+        void finish();
+
+    private:
+        std::ofstream out;
+        SnapshotHeader header;
+        bool data_started;
+
+        uint64_t beginSection();
+    };
+
+    /**
+     * Base class of the read-only views on a snapshot file.
+     * The LocalMap part is a copy, the cell data is read from the mapping.
+     */
+    class MapSnapshot : public LocalMap
+    {
+    public:
+        MapSnapshot(const std::string& path, SnapshotContent content, uint32_t cell_size, uint32_t cell_type = 0);
+
+        const Vector2ui& getNumCells() const { return num_cells; }
+        const Vector2d& getResolution() const { return resolution; }
+
+        bool inGrid(const Index& idx) const
+        {
+            return idx.isInside(num_cells);
+        }
+
+        /** Reads the header of a snapshot file without mapping it */
+        static SnapshotHeader readHeader(const std::string& path);
+
+    protected:
+        boost::shared_ptr<MappedFile> file;
+        SnapshotHeader header;
+        Vector2ui num_cells;
+        Vector2d resolution;
+
+        const char* getExtra() const { return file->data() + header.extra_offset; }
+        const uint32_t* getOffsets() const { return reinterpret_cast<const uint32_t*>(file->data() + header.offsets_offset); }
+        const char* getData() const { return file->data() + header.data_offset; }
+
+        /** Number of cells in 64 bit, num_cells.prod() overflows for large maps */
+        uint64_t getNumCellsTotal() const { return uint64_t(num_cells.x()) * num_cells.y(); }
+
+        size_t toIdx(size_t x, size_t y) const
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            return x + y * num_cells.x();
+        }
+
+        /** Copies id, EPSG code and frame to another map */
+        void copyLocalMapTo(LocalMap& map) const;
+    };
+
+    /** Read-only view on a snapshot of a GridMap with trivially copyable cells */
+    template<class CellT>
+    class MappedGridMap : public MapSnapshot
+    {
+        static_assert(std::is_trivially_copyable<CellT>::value, "Snapshots require trivially copyable cells");
+    public:
+        typedef CellT CellType;
+
+        explicit MappedGridMap(const std::string& path)
+            : MapSnapshot(path, SNAPSHOT_GRID_MAP, sizeof(CellT))
+        {
+            if (header.extra_size != sizeof(CellT) || header.data_size % sizeof(CellT) != 0
+                || header.data_size / sizeof(CellT) != getNumCellsTotal())
+                throw std::runtime_error("Snapshot " + path + " is corrupt");
+        }
+
+        const CellT& getDefaultValue() const
+        {
+            return *reinterpret_cast<const CellT*>(getExtra());
+        }
+
+        const CellT& at(size_t x, size_t y) const
+        {
+            return getCells()[toIdx(x, y)];
+        }
+
+        const CellT& at(const Index& idx) const
+        {
+            return at(idx.x(), idx.y());
+        }
+
+        const CellT* begin() const { return getCells(); }
+        const CellT* end() const { return getCells() + getNumCellsTotal(); }
+
+        /** Creates a modifiable copy of the map */
+        GridMap<CellT> toMap() const
+        {
+            GridMap<CellT> map(num_cells, resolution, getDefaultValue());
+            copyLocalMapTo(map);
+            std::copy(begin(), end(), map.begin());
+            return map;
+        }
+
+    private:
+        const CellT* getCells() const
+        {
+            return reinterpret_cast<const CellT*>(getData());
+        }
+    };
+
+    /** Read-only view on a snapshot of a MLSMap */
+    template<MLSConfig::update_model SurfaceType>
+    class MappedMLSMap : public MapSnapshot
+    {
+    public:
+        typedef SurfacePatch<SurfaceType> Patch;
+        typedef typename CompactMLSMap<SurfaceType>::PatchRange PatchRange;
+        typedef PatchRange CellType;
+
+        /** MLSConfig in a layout independent of the compiler's choices for enums and bools */
+        struct Config
+        {
+            float gapSize;
+            float thickness;
+            uint32_t useColor;
+            uint32_t updateModel;
+            uint32_t useNegativeInformation;
+        };
+
+        explicit MappedMLSMap(const std::string& path)
+            : MapSnapshot(path, SNAPSHOT_MLS_MAP, sizeof(Patch), SurfaceType)
+        {
+            const uint64_t count = getNumCellsTotal();
+            if (header.extra_size != sizeof(Config) || header.offsets_count != count + 1
+                || header.data_size != uint64_t(getOffsets()[count]) * sizeof(Patch))
+                throw std::runtime_error("Snapshot " + path + " is corrupt");
+
+            // the patch ranges of the cells must stay within the data section
+            const uint32_t* offsets = getOffsets();
+            if (offsets[0] != 0)
+                throw std::runtime_error("Snapshot " + path + " is corrupt");
+            for (uint64_t i = 0; i < count; ++i)
+            {
+                if (offsets[i + 1] < offsets[i])
+                    throw std::runtime_error("Snapshot " + path + " is corrupt");
+            }
+        }
+
+        MLSConfig getConfig() const
+        {
+            const Config& stored = *reinterpret_cast<const Config*>(getExtra());
+            MLSConfig config;
+            config.gapSize = stored.gapSize;
+            config.thickness = stored.thickness;
+            config.useColor = stored.useColor;
+            config.updateModel = MLSConfig::update_model(stored.updateModel);
+            config.useNegativeInformation = stored.useNegativeInformation;
+            return config;
+        }
+
+        size_t getNumPatches() const
+        {
+            return getOffsets()[getNumCellsTotal()];
+        }
+
+        PatchRange at(size_t x, size_t y) const
+        {
+            const size_t i = toIdx(x, y);
+            return PatchRange(getPatches() + getOffsets()[i], getPatches() + getOffsets()[i + 1]);
+        }
+
+        PatchRange at(const Index& idx) const
+        {
+            return at(idx.x(), idx.y());
+        }
+
+        /** Creates a modifiable copy of the map */
+        MLSMap<SurfaceType> toMap() const
+        {
+            MLSMap<SurfaceType> mls(num_cells, resolution, getConfig());
+            copyLocalMapTo(mls);
+            const uint32_t* offsets = getOffsets();
+            typename MLSMap<SurfaceType>::iterator cell = mls.begin();
+            for (uint64_t i = 0; i < getNumCellsTotal(); ++i, ++cell)
+                cell->insert(getPatches() + offsets[i], getPatches() + offsets[i + 1]);
+            return mls;
+        }
+
+        static Config toConfig(const MLSConfig& config)
+        {
+            Config stored;
+            stored.gapSize = config.gapSize;
+            stored.thickness = config.thickness;
+            stored.useColor = config.useColor;
+            stored.updateModel = config.updateModel;
+            stored.useNegativeInformation = config.useNegativeInformation;
+            return stored;
+        }
+
+    private:
+        const Patch* getPatches() const
+        {
+            return reinterpret_cast<const Patch*>(getData());
+        }
+    };
+
+    /** Read-only view on a snapshot of a TraversabilityGrid */
+    class MappedTraversabilityGrid : public MapSnapshot
+    {
+    public:
+        typedef TraversabilityCell CellType;
+
+        explicit MappedTraversabilityGrid(const std::string& path);
+
+        TraversabilityCell at(size_t x, size_t y) const
+        {
+            const uint8_t* cell = reinterpret_cast<const uint8_t*>(getData()) + 2 * toIdx(x, y);
+            return TraversabilityCell(cell[0], cell[1]);
+        }
+
+        TraversabilityCell at(const Index& idx) const
+        {
+            return at(idx.x(), idx.y());
+        }
+
+        TraversabilityCell getDefaultValue() const;
+
+        std::vector<TraversabilityClass> getTraversabilityClasses() const;
+
+        /** Creates a modifiable copy of the map */
+        TraversabilityGrid toMap() const;
+    };
+
+    /** Writes a snapshot of a GridMap with trivially copyable cells */
+    template<class CellT, class GridT>
+    void saveSnapshot(const std::string& path, const GridMap<CellT, GridT>& map)
+    {
+        static_assert(std::is_trivially_copyable<CellT>::value, "Snapshots require trivially copyable cells");
+
+        SnapshotWriter writer(path, SNAPSHOT_GRID_MAP, sizeof(CellT), 0, map, map.getNumCells(), map.getResolution());
+        writer.writeExtra(&map.getDefaultValue(), sizeof(CellT));
+        std::vector<CellT> row(map.getNumCells().x());
+        for (unsigned y = 0; y < map.getNumCells().y(); ++y)
+        {
+            for (unsigned x = 0; x < map.getNumCells().x(); ++x)
+                row[x] = map.at(x, y);
+            writer.writeData(row.data(), row.size() * sizeof(CellT));
+        }
+        writer.finish();
+    }
+
+    /** Writes a snapshot of a MLSMap */
+    template<MLSConfig::update_model SurfaceType, class AllocatorOrContainer>
+    void saveSnapshot(const std::string& path, const MLSMap<SurfaceType, AllocatorOrContainer>& mls)
+    {
+        typedef SurfacePatch<SurfaceType> Patch;
+        static_assert(std::is_trivially_copyable<Patch>::value, "Snapshots require trivially copyable patches");
+
+        std::vector<uint32_t> offsets;
+        offsets.reserve(size_t(mls.getNumCells().x()) * mls.getNumCells().y() + 1);
+        offsets.push_back(0);
+        uint64_t num_patches = 0;
+        for (const typename MLSMap<SurfaceType, AllocatorOrContainer>::CellType& cell : mls)
+        {
+            num_patches += cell.size();
+            if (num_patches > std::numeric_limits<uint32_t>::max())
+                throw std::runtime_error("saveSnapshot: too many patches");
+            offsets.push_back(num_patches);
+        }
+
+        SnapshotWriter writer(path, SNAPSHOT_MLS_MAP, sizeof(Patch), SurfaceType, mls, mls.getNumCells(), mls.getResolution());
+        typename MappedMLSMap<SurfaceType>::Config config = MappedMLSMap<SurfaceType>::toConfig(mls.getConfig());
+        writer.writeExtra(&config, sizeof(config));
+        writer.writeOffsets(offsets);
+        std::vector<Patch> patches;
+        for (const typename MLSMap<SurfaceType, AllocatorOrContainer>::CellType& cell : mls)
+        {
+            patches.assign(cell.begin(), cell.end());
+            writer.writeData(patches.data(), patches.size() * sizeof(Patch));
+        }
+        writer.finish();
+    }
+
+    /** Writes a snapshot of a TraversabilityGrid */
+    void saveSnapshot(const std::string& path, const TraversabilityGrid& grid);
+
+    /**
+     * Converts a map stored in a boost binary archive to a snapshot.
+     * MapT is the type of the archived map, e.g. MLSMapKalman.
+     */
+    template<class MapT>
+    void convertArchiveToSnapshot(const std::string& archive_path, const std::string& snapshot_path)
+    {
+        std::ifstream in(archive_path.c_str(), std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Could not open " + archive_path);
+        boost::archive::binary_iarchive ia(in);
+        MapT map;
+        ia >> map;
+        saveSnapshot(snapshot_path, map);
+    }
+
+    /**
+     * Converts a snapshot to a boost binary archive of the corresponding map.
+     * MappedT is the view type, e.g. MappedMLSMap<MLSConfig::KALMAN>.
+     */
+    template<class MappedT>
+    void convertSnapshotToArchive(const std::string& snapshot_path, const std::string& archive_path)
+    {
+        MappedT snapshot(snapshot_path);
+        std::ofstream out(archive_path.c_str(), std::ios::binary);
+        if (!out)
+            throw std::runtime_error("Could not open " + archive_path);
+        boost::archive::binary_oarchive oa(out);
+        const typename std::decay<decltype(snapshot.toMap())>::type map = snapshot.toMap();
+        oa << map;
+    }
+}}
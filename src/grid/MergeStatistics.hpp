@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <cstddef>
+
+namespace maps { namespace grid
+{
+
+/**
+ * Statistics of a single point cloud integration.
+ * Returned by the mergePointCloud methods of the maps instead of
+ * reporting every rejected point separately.
+ */
+struct MergeStatistics
+{
+    MergeStatistics() : merged(0), outside_grid(0), free_space_filtered(0), invalid(0) {}
+
+    /** number of points that have been added to the map */
+    size_t merged;
+    /** number of points that have been rejected since they are outside of the grid */
+    size_t outside_grid;
+    /** number of points that have been rejected by the free space map */
+    size_t free_space_filtered;
+    /** number of points that have been rejected for other reasons, e.g. degenerated rays */
+    size_t invalid;
+
+    size_t getRejected() const
+    {
+        return outside_grid + free_space_filtered + invalid;
+    }
+
+    size_t getTotal() const
+    {
+        return merged + getRejected();
+    }
+
+    MergeStatistics& operator+=(const MergeStatistics& other)
+    {
+        merged += other.merged;
+        outside_grid += other.outside_grid;
+        free_space_filtered += other.free_space_filtered;
+        invalid += other.invalid;
+        return *this;
+    }
+};
+
+}}
@@ -27,33 +27,71 @@
 #pragma once
 
 #include "LevelList.hpp"
+#include "ArenaAllocator.hpp"
 #include "GridMap.hpp"
 #include "../tools/Overlap.hpp"
 
+#include <type_traits>
+
 namespace maps { namespace grid
 {
 
-    template <class P>
-    class MultiLevelGridMap : public GridMap<LevelList<P> >
+    /**
+     * Grid with a sorted list of elements per cell.
+     *
+     * AllocatorOrContainer is forwarded to the LevelList of the cells. With an
+     * ArenaAllocator all cells of a map share one MemoryArena, which is created
+     * by the constructors and released wholesale by clear(). Cells of a default
+     * constructed or deserialized map use the heap instead.
+     * GridT is the storage of the cells, e.g. RingBufferGrid or TiledGrid.
+     */
+    template <class P, class AllocatorOrContainer = typename LevelList<P>::allocator_type,
+              class GridT = VectorGrid<LevelList<P, AllocatorOrContainer> > >
+    class MultiLevelGridMap : public GridMap<LevelList<P, AllocatorOrContainer>, GridT>
     {
+        typedef GridMap<LevelList<P, AllocatorOrContainer>, GridT> GridMapBase;
     public:
-        typedef LevelList<P> CellType; 
+        typedef LevelList<P, AllocatorOrContainer> CellType; 
+        typedef typename CellType::allocator_type allocator_type;
+        static_assert(std::is_same<typename GridT::CellType, CellType>::value, "GridT must store LevelList<P, AllocatorOrContainer>");
         
         typedef P PatchType;
         MultiLevelGridMap(const Vector2ui &num_cells,
                     const Eigen::Vector2d &resolution,
-                    const boost::shared_ptr<LocalMapData> &data) : GridMap<LevelList<P> >(num_cells, resolution, LevelList<P>(), data)
+                    const boost::shared_ptr<LocalMapData> &data,
+                    const allocator_type &allocator = MapAllocator<allocator_type>::create()) : GridMapBase(num_cells, resolution, CellType(allocator), data)
         {}
 
         MultiLevelGridMap(const Vector2ui &num_cells,
-                    const Eigen::Vector2d &resolution) : GridMap<LevelList<P> >(num_cells, resolution, LevelList<P>())
+                    const Eigen::Vector2d &resolution,
+                    const allocator_type &allocator = MapAllocator<allocator_type>::create()) : GridMapBase(num_cells, resolution, CellType(allocator))
         {}
         
         MultiLevelGridMap() {}
         
-        template<class Q>
-        MultiLevelGridMap(const MultiLevelGridMap<Q> &other) : GridMap<CellType>(other, other)
+        /** Converts the cells of @p other, all cells of this map take their memory from @p allocator */
+        template<class Q, class A2, class G2>
+        MultiLevelGridMap(const MultiLevelGridMap<Q, A2, G2> &other, const allocator_type &allocator = MapAllocator<allocator_type>::create())
+            : GridMapBase(other, GridT(other.getNumCells(), CellType(allocator)))
+        {
+            // insert into the cells of this grid, so they keep sharing the allocator of the default value
+            other.forEachAllocatedCell([this](const Index &idx, const typename MultiLevelGridMap<Q, A2, G2>::CellType &other_cell)
+            {
+                if(!other_cell.empty())
+                    this->at(idx).insert(other_cell.begin(), other_cell.end());
+            });
+        }
+
+        /**
+         * Resets all cells and releases their memory.
+         * Like GridMap::clear() all cells are marked as dirty.
+         */
+        void clear()
         {
+            GridMapBase::clear();
+            for(CellType &cell : *this)
+                cell.shrink_to_fit();
+            MapAllocator<allocator_type>::release(this->getDefaultValue().get_allocator());
         }
 
         class View : public GridMap<LevelList<const P *> >
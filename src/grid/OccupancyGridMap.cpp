@@ -27,35 +27,383 @@
 #include "OccupancyGridMap.hpp"
 #include <boost/format.hpp>
 #include <maps/tools/VoxelTraversal.hpp>
+#include <maps/tools/ParallelFor.hpp>
+#include <algorithm>
 
 using namespace maps::grid;
 using namespace maps::tools;
 
-void OccupancyGridMap::mergePointCloud(const OccupancyGridMap::PointCloud& pc, const base::Transform3d& pc2grid)
+namespace
 {
+    /** Hit or miss update of a z range within one grid column */
+    struct ColumnUpdate
+    {
+        size_t column;
+        int32_t z_first;
+        int32_t z_last;
+        bool hit;
+    };
+
+    /**
+     * Key of a voxel update in mergeMeasurementsCoalesced. Keys are ordered by column, z and
+     * misses before hits, the sign bit of z is flipped to order negative indices first.
+     */
+    inline uint64_t toVoxelKey(size_t column, int32_t z, bool hit)
+    {
+        return (uint64_t(column) << 33) | (uint64_t(uint32_t(z) ^ 0x80000000u) << 1) | uint64_t(hit);
+    }
+
+    inline size_t toVoxelColumn(uint64_t key)
+    {
+        return size_t(key >> 33);
+    }
+
+    inline int32_t toVoxelZ(uint64_t key)
+    {
+        return int32_t(uint32_t(key >> 1) ^ 0x80000000u);
+    }
+
+    /** Keeps the last key per voxel of the sorted \c keys, which is the hit if there is one */
+    void uniqueVoxelKeys(std::vector<uint64_t>& keys)
+    {
+        size_t count = 0;
+        for(size_t i = 0; i < keys.size(); ++i)
+        {
+            if(i + 1 < keys.size() && (keys[i] >> 1) == (keys[i + 1] >> 1))
+                continue;
+            keys[count++] = keys[i];
+        }
+        keys.resize(count);
+    }
+
+    /**
+     * Hit and miss updates of an OccupancyConfiguration in the log-odds representation of the voxel
+     * type \c CellT. It is created once per merge, so the configuration isn't converted per voxel.
+     */
+    template<class CellT>
+    struct LogOddsUpdate
+    {
+        LogOddsUpdate(const OccupancyConfiguration& config) : hit(config.hit_logodds), miss(config.miss_logodds),
+                                                              min(config.min_logodds), max(config.max_logodds) {}
+
+        void apply(CellT& cell, bool is_hit) const
+        {
+            cell.updateLogOdds(is_hit ? hit : miss, min, max);
+        }
+
+        float hit, miss, min, max;
+    };
+
+    /** Quantizes the configuration once instead of in every QuantizedOccupancyPatch::updateLogOdds call */
+    template<>
+    struct LogOddsUpdate<QuantizedOccupancyPatch>
+    {
+        LogOddsUpdate(const OccupancyConfiguration& config) : hit(QuantizedOccupancyPatch::quantize(config.hit_logodds)),
+                                                              miss(QuantizedOccupancyPatch::quantize(config.miss_logodds)),
+                                                              min(QuantizedOccupancyPatch::quantize(config.min_logodds)),
+                                                              max(QuantizedOccupancyPatch::quantize(config.max_logodds)) {}
+
+        void apply(QuantizedOccupancyPatch& cell, bool is_hit) const
+        {
+            cell.updateQuantizedLogOdds(is_hit ? hit : miss, min, max);
+        }
+
+        int16_t hit, miss, min, max;
+    };
+
+    /** Number of points traced into one update buffer */
+    const size_t RAY_BLOCK_SIZE = 1024;
+
+    /** Number of points whose voxels are collected before they are merged into the voxels of the scan */
+    const size_t COALESCE_BATCH_SIZE = 16 * RAY_BLOCK_SIZE;
+
+    /** Buffers of a thread in traceRays, reused for all of its blocks */
+    struct RayScratch
+    {
+        std::vector<Eigen::Vector3d> points;
+        std::vector<Eigen::Vector3i> measurement_idxs;
+        VoxelTraversal::RayBuffer rays;
+    };
+
+    /**
+     * Traces the rays to all measurements inside of the grid using up to \c num_threads threads.
+     * Every block of RAY_BLOCK_SIZE points collects its updates in its own buffer, in the order
+     * in which tryMergePoint applies them. Returns the number of traced measurements.
+     */
+    template<class MapT>
+    size_t traceRays(const MapT& map, const Eigen::Vector3d& sensor_origin, const Eigen::Vector3i& sensor_origin_idx,
+                     size_t num_points, const std::function<Eigen::Vector3d (size_t)>& measurement, unsigned num_threads,
+                     std::vector< std::vector<ColumnUpdate> >& block_updates)
+    {
+        const Eigen::Vector3d voxel_resolution = map.getVoxelResolution();
+        const size_t num_cells_x = map.getNumCells().x();
+
+        const size_t num_blocks = (num_points + RAY_BLOCK_SIZE - 1) / RAY_BLOCK_SIZE;
+        block_updates.assign(num_blocks, std::vector<ColumnUpdate>());
+        std::vector<size_t> block_merged(num_blocks, 0);
+        parallelForWithState<RayScratch>(0, num_blocks, [&](size_t b, RayScratch& scratch)
+        {
+            std::vector<Eigen::Vector3d>& points = scratch.points;
+            std::vector<Eigen::Vector3i>& measurement_idxs = scratch.measurement_idxs;
+            points.clear();
+            measurement_idxs.clear();
+            const size_t end = std::min(num_points, (b + 1) * RAY_BLOCK_SIZE);
+            for(size_t i = b * RAY_BLOCK_SIZE; i < end; ++i)
+            {
+                const Eigen::Vector3d point = measurement(i);
+                Eigen::Vector3i measurement_idx;
+                if(!map.toVoxelGrid(point, measurement_idx))
+                    continue;
+                points.push_back(point);
+                measurement_idxs.push_back(measurement_idx);
+            }
+
+            VoxelTraversal::RayBuffer& rays = scratch.rays;
+            VoxelTraversal::computeRays(voxel_resolution, sensor_origin, sensor_origin_idx, points.data(), points.size(), rays);
+
+            std::vector<ColumnUpdate>& updates = block_updates[b];
+            for(size_t r = 0; r < rays.size(); ++r)
+            {
+                // the hit first, then the misses along the ray
+                const Eigen::Vector3i& measurement_idx = measurement_idxs[r];
+                updates.push_back({measurement_idx.y() * num_cells_x + measurement_idx.x(),
+                                   measurement_idx.z(), measurement_idx.z(), true});
+                for(std::vector<VoxelTraversal::RayElement>::const_iterator element = rays.begin(r); element != rays.end(r); ++element)
+                {
+                    // the discretized ray can touch cells outside of the grid close to the border
+                    if(!map.inGrid(element->idx))
+                        continue;
+                    updates.push_back({element->idx.y() * num_cells_x + element->idx.x(),
+                                       element->z_first, element->z_last, false});
+                }
+            }
+            block_merged[b] = points.size();
+        }, num_threads, 1);
+
+        size_t merged = 0;
+        for(size_t m : block_merged)
+            merged += m;
+        return merged;
+    }
+}
+
+template<class CellT, class ColumnT>
+MergeStatistics BasicOccupancyGridMap<CellT, ColumnT>::mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2grid, bool coalesce_updates,
+                                                                  unsigned num_threads)
+{
+    Eigen::Vector3d sensor_origin = pc.sensor_origin_.block(0,0,3,1).cast<double>();
+    if(coalesce_updates)
+        return mergeMeasurementsCoalesced(pc2grid * sensor_origin, pc.size(),
+                                          [&](size_t i) -> Eigen::Vector3d { return pc2grid * pc[i].getArray3fMap().cast<double>(); },
+                                          num_threads);
+
+    RayIntegrationContext context;
+    return mergePointCloud(pc, pc2grid, context);
+}
+
+template<class CellT, class ColumnT>
+MergeStatistics BasicOccupancyGridMap<CellT, ColumnT>::mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2grid, RayIntegrationContext& context)
+{
+    MergeStatistics stats;
     Eigen::Vector3d sensor_origin = pc.sensor_origin_.block(0,0,3,1).cast<double>();
-    Eigen::Vector3d sensor_origin_in_grid = pc2grid * sensor_origin;
+    if(!context.reset(*this, pc2grid, sensor_origin))
+    {
+        LOG_ERROR_S << "Sensor origin (" << context.sensor_origin.transpose() << ") is outside of the grid! Can't add corresponding point cloud to grid.";
+        stats.outside_grid = pc.size();
+        return stats;
+    }
+    return mergeMeasurements(context, pc.size(), [&](size_t i) -> Eigen::Vector3d { return pc[i].getArray3fMap().cast<double>(); });
+}
+
+template<class CellT, class ColumnT>
+MergeStatistics BasicOccupancyGridMap<CellT, ColumnT>::mergeMeasurements(RayIntegrationContext& context, size_t num_points,
+                                                                  const std::function<Eigen::Vector3d (size_t)>& measurement)
+{
+    MergeStatistics stats;
+    const LogOddsUpdate<VoxelCellType> update(config);
+    for(size_t i = 0; i < num_points; ++i)
+    {
+        if(integrateRay(context, measurement(i), update))
+            stats.merged++;
+        else
+            stats.outside_grid++;
+    }
+    return stats;
+}
+
+template<class CellT, class ColumnT>
+MergeStatistics BasicOccupancyGridMap<CellT, ColumnT>::mergePointCloudParallel(const PointCloud& pc, const base::Transform3d& pc2grid, unsigned num_threads)
+{
+    Eigen::Vector3d sensor_origin = pc.sensor_origin_.block(0,0,3,1).cast<double>();
+    return mergeMeasurementsParallel(pc2grid * sensor_origin, pc.size(),
+                                     [&](size_t i) -> Eigen::Vector3d { return pc2grid * pc[i].getArray3fMap().cast<double>(); }, num_threads);
+}
+
+template<class CellT, class ColumnT>
+MergeStatistics BasicOccupancyGridMap<CellT, ColumnT>::mergeMeasurementsParallel(const Eigen::Vector3d& sensor_origin, size_t num_points,
+                                                            const std::function<Eigen::Vector3d (size_t)>& measurement, unsigned num_threads)
+{
+    MergeStatistics stats;
+    Eigen::Vector3i sensor_origin_idx;
+    if(!VoxelGridBase::toVoxelGrid(sensor_origin, sensor_origin_idx))
+    {
+        LOG_ERROR_S << "Sensor origin (" << sensor_origin.transpose() << ") is outside of the grid! Can't add corresponding point cloud to grid.";
+        stats.outside_grid = num_points;
+        return stats;
+    }
+
+    const size_t num_cells_x = this->getNumCells().x();
+    const size_t num_columns = num_cells_x * this->getNumCells().y();
+
+    std::vector< std::vector<ColumnUpdate> > block_updates;
+    stats.merged = traceRays(*this, sensor_origin, sensor_origin_idx, num_points, measurement, num_threads, block_updates);
+    stats.outside_grid = num_points - stats.merged;
+
+    // group the updates by column, a stable counting sort keeps the order of the point cloud
+    std::vector<size_t> column_starts(num_columns + 1, 0);
+    for(const std::vector<ColumnUpdate>& updates : block_updates)
+    {
+        for(const ColumnUpdate& update : updates)
+            column_starts[update.column + 1]++;
+    }
+    std::vector<size_t> touched_columns;
+    for(size_t c = 0; c < num_columns; ++c)
+    {
+        if(column_starts[c + 1] > 0)
+            touched_columns.push_back(c);
+        column_starts[c + 1] += column_starts[c];
+    }
+
+    std::vector<ColumnUpdate> sorted_updates(column_starts.back());
+    std::vector<size_t> column_fill(column_starts.begin(), column_starts.end() - 1);
+    for(std::vector<ColumnUpdate>& updates : block_updates)
+    {
+        for(const ColumnUpdate& update : updates)
+            sorted_updates[column_fill[update.column]++] = update;
+        std::vector<ColumnUpdate>().swap(updates);
+    }
+
+    // apply the updates, the columns are independent of each other
+    const LogOddsUpdate<VoxelCellType> log_odds_update(config);
+    parallelFor(0, touched_columns.size(), [&](size_t t)
+    {
+        const size_t column = touched_columns[t];
+        ColumnType& tree = this->at(Index(column % num_cells_x, column / num_cells_x));
+        for(size_t u = column_starts[column]; u < column_starts[column + 1]; ++u)
+        {
+            const ColumnUpdate& update = sorted_updates[u];
+            tree.updateRange(update.z_first, update.z_last, [&](int32_t, VoxelCellType& cell)
+            {
+                log_odds_update.apply(cell, update.hit);
+            });
+        }
+    }, num_threads, 16);
+
+    if(this->isDirtyTrackingEnabled())
+    {
+        for(size_t column : touched_columns)
+            this->markDirty(Index(column % num_cells_x, column / num_cells_x));
+    }
+
+    return stats;
+}
+
+template<class CellT, class ColumnT>
+MergeStatistics BasicOccupancyGridMap<CellT, ColumnT>::mergeMeasurementsCoalesced(const Eigen::Vector3d& sensor_origin, size_t num_points,
+                                                             const std::function<Eigen::Vector3d (size_t)>& measurement, unsigned num_threads)
+{
+    MergeStatistics stats;
     Eigen::Vector3i sensor_origin_idx;
-    if(!VoxelGridBase::toVoxelGrid(sensor_origin_in_grid, sensor_origin_idx))
+    if(!VoxelGridBase::toVoxelGrid(sensor_origin, sensor_origin_idx))
     {
-        LOG_ERROR_S << "Sensor origin (" << sensor_origin_in_grid.transpose() << ") is outside of the grid! Can't add corresponding point cloud to grid.";
-        return;
+        LOG_ERROR_S << "Sensor origin (" << sensor_origin.transpose() << ") is outside of the grid! Can't add corresponding point cloud to grid.";
+        stats.outside_grid = num_points;
+        return stats;
     }
-    for(PointCloud::const_iterator it=pc.begin(); it != pc.end(); ++it)
+
+    // collect the sorted and unique voxels touched by the scan, a hit overrides misses of the same voxel,
+    // so occupied wins. The rays are traced batch by batch, so the memory is bounded by the number of
+    // distinct voxels plus one batch.
+    std::vector<uint64_t> voxels;
+    std::vector< std::vector<ColumnUpdate> > block_updates;
+    std::vector< std::vector<uint64_t> > block_voxels;
+    std::vector<uint64_t> batch_voxels;
+    for(size_t start = 0; start < num_points; start += COALESCE_BATCH_SIZE)
     {
-        try
+        stats.merged += traceRays(*this, sensor_origin, sensor_origin_idx, std::min(COALESCE_BATCH_SIZE, num_points - start),
+                                  [&](size_t i) { return measurement(start + i); }, num_threads, block_updates);
+
+        block_voxels.resize(block_updates.size());
+        parallelFor(0, block_updates.size(), [&](size_t b)
         {
-            Eigen::Vector3d measurement = it->getArray3fMap().cast<double>();
-            mergePoint(sensor_origin_in_grid, sensor_origin_idx, pc2grid * measurement);
+            std::vector<uint64_t>& keys = block_voxels[b];
+            keys.clear();
+            for(const ColumnUpdate& update : block_updates[b])
+            {
+                const int32_t z_min = std::min(update.z_first, update.z_last);
+                const int32_t z_max = std::max(update.z_first, update.z_last);
+                for(int32_t z_idx = z_min; z_idx <= z_max; ++z_idx)
+                    keys.push_back(toVoxelKey(update.column, z_idx, update.hit));
+            }
+            std::sort(keys.begin(), keys.end());
+            uniqueVoxelKeys(keys);
+        }, num_threads, 1);
+
+        batch_voxels.clear();
+        for(const std::vector<uint64_t>& keys : block_voxels)
+            batch_voxels.insert(batch_voxels.end(), keys.begin(), keys.end());
+        std::sort(batch_voxels.begin(), batch_voxels.end());
+
+        const size_t num_voxels = voxels.size();
+        voxels.insert(voxels.end(), batch_voxels.begin(), batch_voxels.end());
+        std::inplace_merge(voxels.begin(), voxels.begin() + num_voxels, voxels.end());
+        uniqueVoxelKeys(voxels);
+    }
+    stats.outside_grid = num_points - stats.merged;
+
+    // the keys are grouped by column
+    std::vector<size_t> column_starts;
+    for(size_t v = 0; v < voxels.size(); ++v)
+    {
+        if(v == 0 || toVoxelColumn(voxels[v]) != toVoxelColumn(voxels[v - 1]))
+            column_starts.push_back(v);
+    }
+    column_starts.push_back(voxels.size());
+
+    // every voxel is updated once, consecutive voxels of a column with the same update are applied as one range
+    const size_t num_cells_x = this->getNumCells().x();
+    const LogOddsUpdate<VoxelCellType> log_odds_update(config);
+    parallelFor(0, column_starts.size() - 1, [&](size_t c)
+    {
+        const size_t column = toVoxelColumn(voxels[column_starts[c]]);
+        ColumnType& tree = this->at(Index(column % num_cells_x, column / num_cells_x));
+        size_t range_start = column_starts[c];
+        for(size_t v = range_start + 1; v <= column_starts[c + 1]; ++v)
+        {
+            if(v < column_starts[c + 1] && (voxels[v] & 1) == (voxels[v - 1] & 1) && toVoxelZ(voxels[v]) == toVoxelZ(voxels[v - 1]) + 1)
+                continue;
+            const bool hit = voxels[range_start] & 1;
+            tree.updateRange(toVoxelZ(voxels[range_start]), toVoxelZ(voxels[v - 1]), [&](int32_t, VoxelCellType& cell)
+            {
+                log_odds_update.apply(cell, hit);
+            });
+            range_start = v;
         }
-        catch(const std::runtime_error& e)
+    }, num_threads, 16);
+
+    if(this->isDirtyTrackingEnabled())
+    {
+        for(size_t c = 0; c + 1 < column_starts.size(); ++c)
         {
-            LOG_ERROR_S << e.what();
+            const size_t column = toVoxelColumn(voxels[column_starts[c]]);
+            this->markDirty(Index(column % num_cells_x, column / num_cells_x));
         }
     }
+    return stats;
 }
 
-void OccupancyGridMap::mergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement)
+template<class CellT, class ColumnT>
+void BasicOccupancyGridMap<CellT, ColumnT>::mergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement)
 {
     Eigen::Vector3i sensor_origin_idx;
     if(VoxelGridBase::toVoxelGrid(sensor_origin, sensor_origin_idx))
@@ -66,32 +414,79 @@ void OccupancyGridMap::mergePoint(const Eigen::Vector3d& sensor_origin, const Ei
         throw std::runtime_error((boost::format("Sensor origin %1% is outside of the grid! Can't add to grid.") % sensor_origin.transpose()).str());
 }
 
-void OccupancyGridMap::mergePoint(const Eigen::Vector3d& sensor_origin, Eigen::Vector3i sensor_origin_idx, const Eigen::Vector3d& measurement)
+template<class CellT, class ColumnT>
+void BasicOccupancyGridMap<CellT, ColumnT>::mergePoint(const Eigen::Vector3d& sensor_origin, Eigen::Vector3i sensor_origin_idx, const Eigen::Vector3d& measurement)
+{
+    if(!tryMergePoint(sensor_origin, sensor_origin_idx, measurement))
+        throw std::runtime_error((boost::format("Point %1% or is outside of the grid! Can't add to grid.") % measurement.transpose()).str());
+}
+
+template<class CellT, class ColumnT>
+void BasicOccupancyGridMap<CellT, ColumnT>::mergePoint(RayIntegrationContext& context, const Eigen::Vector3d& measurement)
 {
+    if(!tryMergePoint(context, measurement))
+        throw std::runtime_error((boost::format("Point %1% is outside of the grid! Can't add to grid.") % (context.pc2grid * measurement).transpose()).str());
+}
+
+template<class CellT, class ColumnT>
+bool BasicOccupancyGridMap<CellT, ColumnT>::tryMergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement)
+{
+    Eigen::Vector3i sensor_origin_idx;
+    if(!VoxelGridBase::toVoxelGrid(sensor_origin, sensor_origin_idx))
+        return false;
+    return tryMergePoint(sensor_origin, sensor_origin_idx, measurement);
+}
+
+template<class CellT, class ColumnT>
+bool BasicOccupancyGridMap<CellT, ColumnT>::tryMergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3i& sensor_origin_idx, const Eigen::Vector3d& measurement)
+{
+    RayIntegrationContext context;
+    context.voxel_resolution = VoxelGridBase::getVoxelResolution();
+    context.sensor_origin = sensor_origin;
+    context.sensor_origin_idx = sensor_origin_idx;
+    return tryMergePoint(context, measurement);
+}
+
+template<class CellT, class ColumnT>
+bool BasicOccupancyGridMap<CellT, ColumnT>::tryMergePoint(RayIntegrationContext& context, const Eigen::Vector3d& measurement)
+{
+    return integrateRay(context, measurement, LogOddsUpdate<VoxelCellType>(config));
+}
+
+template<class CellT, class ColumnT>
+template<class UpdateT>
+bool BasicOccupancyGridMap<CellT, ColumnT>::integrateRay(RayIntegrationContext& context, const Eigen::Vector3d& measurement, const UpdateT& update)
+{
+    const Eigen::Vector3d measurement_in_grid = context.pc2grid * measurement;
     Eigen::Vector3i measurement_idx;
-    if(VoxelGridBase::toVoxelGrid(measurement, measurement_idx))
-    {
-        std::vector<VoxelTraversal::RayElement> ray;
-        VoxelTraversal::computeRay(VoxelGridBase::getVoxelResolution(), sensor_origin, sensor_origin_idx, measurement, ray);
+    if(!VoxelGridBase::toVoxelGrid(measurement_in_grid, measurement_idx))
+        return false;
+
+    std::vector<VoxelTraversal::RayElement>& ray = context.ray;
+    VoxelTraversal::computeRay(context.voxel_resolution, context.sensor_origin, context.sensor_origin_idx, measurement_in_grid, ray);
+
+    VoxelCellType& cell = this->getVoxelCell(measurement_idx);
+    update.apply(cell, true);
+    this->markDirty(Index(measurement_idx.x(), measurement_idx.y()));
 
-        VoxelCellType& cell = getVoxelCell(measurement_idx);
-        cell.updateLogOdds(config.hit_logodds, config.min_logodds, config.max_logodds);
+    for(const VoxelTraversal::RayElement& element : ray)
+    {
+        // the discretized ray can touch cells outside of the grid close to the border
+        if(!this->inGrid(element.idx))
+            continue;
 
-        for(const VoxelTraversal::RayElement& element : ray)
+        ColumnType& tree = this->at(element.idx);
+        this->markDirty(element.idx);
+        tree.updateRange(element.z_first, element.z_last, [&](int32_t, VoxelCellType& cell)
         {
-            DiscreteTree<VoxelCellType>& tree = at(element.idx);
-            int32_t z_end = element.z_last + element.z_step;
-            for(int32_t z_idx = element.z_first; z_idx != z_end; z_idx += element.z_step)
-            {
-                tree.getCellAt(z_idx).updateLogOdds(config.miss_logodds, config.min_logodds, config.max_logodds);
-            }
-        }
+            update.apply(cell, false);
+        });
     }
-    else
-        throw std::runtime_error((boost::format("Point %1% or is outside of the grid! Can't add to grid.") % measurement.transpose()).str());
+    return true;
 }
 
-bool OccupancyGridMap::isOccupied(const Eigen::Vector3d& point) const
+template<class CellT, class ColumnT>
+bool BasicOccupancyGridMap<CellT, ColumnT>::isOccupied(const Eigen::Vector3d& point) const
 {
     Index idx;
     if(GridMapBase::toGrid(point, idx))
@@ -99,14 +494,16 @@ bool OccupancyGridMap::isOccupied(const Eigen::Vector3d& point) const
     throw std::runtime_error((boost::format("Point %1% is outside of the grid!") % point.transpose()).str());
 }
 
-bool OccupancyGridMap::isOccupied(Index idx, float z) const
+template<class CellT, class ColumnT>
+bool BasicOccupancyGridMap<CellT, ColumnT>::isOccupied(Index idx, float z) const
 {
-    const DiscreteTree<VoxelCellType>& cell_tree = at(idx);
-    DiscreteTree<VoxelCellType>::const_iterator it = cell_tree.find(z);
+    const ColumnType& cell_tree = this->at(idx);
+    typename ColumnType::const_iterator it = cell_tree.find(z);
     return it != cell_tree.end() && it->second.getLogOdds() >= config.occupied_logodds;
 }
 
-bool OccupancyGridMap::isFreeSpace(const Eigen::Vector3d& point) const
+template<class CellT, class ColumnT>
+bool BasicOccupancyGridMap<CellT, ColumnT>::isFreeSpace(const Eigen::Vector3d& point) const
 {
     Index idx;
     if(GridMapBase::toGrid(point, idx))
@@ -114,21 +511,32 @@ bool OccupancyGridMap::isFreeSpace(const Eigen::Vector3d& point) const
     throw std::runtime_error((boost::format("Point %1% is outside of the grid!") % point.transpose()).str());
 }
 
-bool OccupancyGridMap::isFreeSpace(Index idx, float z) const
+template<class CellT, class ColumnT>
+bool BasicOccupancyGridMap<CellT, ColumnT>::isFreeSpace(Index idx, float z) const
 {
-    const DiscreteTree<VoxelCellType>& cell_tree = at(idx);
-    DiscreteTree<VoxelCellType>::const_iterator it = cell_tree.find(z);
+    const ColumnType& cell_tree = this->at(idx);
+    typename ColumnType::const_iterator it = cell_tree.find(z);
     return it != cell_tree.end() && it->second.getLogOdds() <= config.free_space_logodds;
 }
 
-bool OccupancyGridMap::hasSameFrame(const base::Transform3d& local_frame, const Vector2ui& num_cells, const Vector2d& resolution) const
+template<class CellT, class ColumnT>
+bool BasicOccupancyGridMap<CellT, ColumnT>::hasSameFrame(const base::Transform3d& local_frame, const Vector2ui& num_cells, const Vector2d& resolution) const
 {
-     if(getResolution() == resolution && getNumCells() == num_cells && getLocalFrame().isApprox(local_frame))
+     if(this->getResolution() == resolution && this->getNumCells() == num_cells && this->getLocalFrame().isApprox(local_frame))
          return true;
      return false;
 }
 
+namespace maps { namespace grid
+{
+    template class BasicOccupancyGridMap<OccupancyPatch>;
+    template class BasicOccupancyGridMap<QuantizedOccupancyPatch>;
+    template class BasicOccupancyGridMap<OccupancyPatch, DenseColumn<OccupancyPatch> >;
+}}
+
 BOOST_CLASS_EXPORT_IMPLEMENT(maps::grid::OccupancyGridMap);
+BOOST_CLASS_EXPORT_IMPLEMENT(maps::grid::QuantizedOccupancyGridMap);
+BOOST_CLASS_EXPORT_IMPLEMENT(maps::grid::DenseOccupancyGridMap);
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
@@ -137,3 +545,11 @@ template void maps::grid::OccupancyGridMap::serialize(boost::archive::text_iarch
 template void maps::grid::OccupancyGridMap::serialize(boost::archive::text_oarchive& arch, const unsigned int version);
 template void maps::grid::OccupancyGridMap::serialize(boost::archive::binary_iarchive& arch, const unsigned int version);
 template void maps::grid::OccupancyGridMap::serialize(boost::archive::binary_oarchive& arch, const unsigned int version);
+template void maps::grid::QuantizedOccupancyGridMap::serialize(boost::archive::text_iarchive& arch, const unsigned int version);
+template void maps::grid::QuantizedOccupancyGridMap::serialize(boost::archive::text_oarchive& arch, const unsigned int version);
+template void maps::grid::QuantizedOccupancyGridMap::serialize(boost::archive::binary_iarchive& arch, const unsigned int version);
+template void maps::grid::QuantizedOccupancyGridMap::serialize(boost::archive::binary_oarchive& arch, const unsigned int version);
+template void maps::grid::DenseOccupancyGridMap::serialize(boost::archive::text_iarchive& arch, const unsigned int version);
+template void maps::grid::DenseOccupancyGridMap::serialize(boost::archive::text_oarchive& arch, const unsigned int version);
+template void maps::grid::DenseOccupancyGridMap::serialize(boost::archive::binary_iarchive& arch, const unsigned int version);
+template void maps::grid::DenseOccupancyGridMap::serialize(boost::archive::binary_oarchive& arch, const unsigned int version);
@@ -27,66 +27,134 @@
 #pragma once
 
 #include "OccupancyPatch.hpp"
+#include "QuantizedOccupancyPatch.hpp"
 #include "VoxelGridMap.hpp"
 #include "OccupancyGridMapBase.hpp"
 #include "OccupancyConfiguration.hpp"
+#include "MergeStatistics.hpp"
+#include "RayIntegrationContext.hpp"
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/export.hpp>
+#include <functional>
 
 namespace maps { namespace grid
 {
 
-class OccupancyGridMap : public OccupancyGridMapBase, public VoxelGridMap<OccupancyPatch>
+/**
+ * Occupancy voxel map. The voxel type \c CellT has to provide getLogOdds and updateLogOdds
+ * like OccupancyPatch, see OccupancyGridMap and QuantizedOccupancyGridMap.
+ * \c ColumnT is the column type of the VoxelGridMap, see DenseOccupancyGridMap.
+ */
+template<class CellT, class ColumnT = DiscreteTree<CellT> >
+class BasicOccupancyGridMap : public OccupancyGridMapBase, public VoxelGridMap<CellT, ColumnT>
 {
 public:
-    typedef OccupancyPatch VoxelCellType;
-    typedef GridMap< DiscreteTree<VoxelCellType> > GridMapBase;
-    typedef VoxelGridMap<VoxelCellType> VoxelGridBase;
+    typedef CellT VoxelCellType;
+    typedef ColumnT ColumnType;
+    typedef GridMap< ColumnType > GridMapBase;
+    typedef VoxelGridMap<VoxelCellType, ColumnType> VoxelGridBase;
     typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
 
-    OccupancyGridMap(): OccupancyGridMapBase(OccupancyConfiguration()),
-                        VoxelGridMap<OccupancyPatch>(Vector2ui::Zero(), Vector3d::Ones()) {}
+    BasicOccupancyGridMap(): OccupancyGridMapBase(OccupancyConfiguration()),
+                        VoxelGridBase(Vector2ui::Zero(), Vector3d::Ones()) {}
 
-    OccupancyGridMap(const Vector2ui &num_cells, const Vector3d &resolution,
+    BasicOccupancyGridMap(const Vector2ui &num_cells, const Vector3d &resolution,
                     const OccupancyConfiguration& config) :
                     OccupancyGridMapBase(config),
-                    VoxelGridMap<OccupancyPatch>(num_cells, resolution) {}
-    virtual ~OccupancyGridMap() {}
-
-    void mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2mls);
+                    VoxelGridBase(num_cells, resolution) {}
+    virtual ~BasicOccupancyGridMap() {}
+
+    /**
+     * Adds the point cloud to the map.
+     * Points outside of the grid are skipped and reported in the returned statistics.
+     * If \c coalesce_updates is set, the free and occupied voxels of the whole scan are collected first
+     * and every voxel is updated at most once, voxels which are hit by a measurement are only updated
+     * as occupied. The coalesced rays are traced using up to \c num_threads threads (0 selects the
+     * number of hardware threads), the result doesn't depend on the number of threads.
+     */
+    MergeStatistics mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2mls, bool coalesce_updates = false,
+                                    unsigned num_threads = 0);
+
+    /**
+     * Same as above without coalescing, the ray buffer of the caller owned \c context is reused
+     * for all points, see RayIntegrationContext.
+     */
+    MergeStatistics mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2grid, RayIntegrationContext& context);
 
     template<int _MatrixOptions>
-    void mergePointCloud(const std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >& pc, const base::Transform3d& pc2grid,
-                            const base::Vector3d& sensor_origin_in_pc = base::Vector3d::Zero())
+    MergeStatistics mergePointCloud(const std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >& pc, const base::Transform3d& pc2grid,
+                                    const base::Vector3d& sensor_origin_in_pc = base::Vector3d::Zero(), bool coalesce_updates = false,
+                                    unsigned num_threads = 0)
     {
-        Eigen::Vector3d sensor_origin_in_grid = pc2grid * sensor_origin_in_pc;
-        Eigen::Vector3i sensor_origin_idx;
-        if(!VoxelGridBase::toVoxelGrid(sensor_origin_in_grid, sensor_origin_idx))
-        {
-            LOG_ERROR_S << "Sensor origin (" << sensor_origin_in_grid.transpose() << ") is outside of the grid! Can't add corresponding point cloud to grid.";
-            return;
-        }
-        for(typename std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >::const_iterator it = pc.begin(); it != pc.end(); ++it)
+        if(coalesce_updates)
+            return mergeMeasurementsCoalesced(pc2grid * sensor_origin_in_pc, pc.size(),
+                                              [&](size_t i) -> Eigen::Vector3d { return pc2grid * pc[i]; }, num_threads);
+
+        RayIntegrationContext context;
+        if(!context.reset(*this, pc2grid, sensor_origin_in_pc))
         {
-            try
-            {
-                mergePoint(sensor_origin_in_grid, sensor_origin_idx, pc2grid * (*it));
-            }
-            catch(const std::runtime_error& e)
-            {
-                LOG_ERROR_S << e.what();
-            }
+            LOG_ERROR_S << "Sensor origin (" << context.sensor_origin.transpose() << ") is outside of the grid! Can't add corresponding point cloud to grid.";
+            MergeStatistics stats;
+            stats.outside_grid = pc.size();
+            return stats;
         }
+        return mergeMeasurements(context, pc.size(), [&](size_t i) -> Eigen::Vector3d { return pc[i]; });
     }
 
+    /**
+     * Parallel variant of mergePointCloud(const PointCloud&, const base::Transform3d&).
+     * The rays are traced using up to \c num_threads threads (0 selects the number of hardware threads),
+     * the resulting updates are grouped by grid column and applied column by column in the order of the
+     * point cloud. Hence the resulting map is identical to the one of the serial implementation.
+     */
+    MergeStatistics mergePointCloudParallel(const PointCloud& pc, const base::Transform3d& pc2grid, unsigned num_threads = 0);
+
+    template<int _MatrixOptions>
+    MergeStatistics mergePointCloudParallel(const std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >& pc, const base::Transform3d& pc2grid,
+                                            const base::Vector3d& sensor_origin_in_pc = base::Vector3d::Zero(), unsigned num_threads = 0)
+    {
+        return mergeMeasurementsParallel(pc2grid * sensor_origin_in_pc, pc.size(),
+                                         [&](size_t i) -> Eigen::Vector3d { return pc2grid * pc[i]; }, num_threads);
+    }
+
+    /**
+     * Merges a single measurement, throws std::runtime_error if it can't be added to the map.
+     * A RayIntegrationContext is set up per call, merge many points with the context overloads.
+     */
     void mergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement);
 
     void mergePoint(const Eigen::Vector3d& sensor_origin, Eigen::Vector3i sensor_origin_idx, const Eigen::Vector3d& measurement);
 
+    /**
+     * Merges a measurement given in the frame of \c context, see RayIntegrationContext::reset.
+     * The ray buffer of the context is reused, throws std::runtime_error if the measurement is outside of the grid.
+     */
+    void mergePoint(RayIntegrationContext& context, const Eigen::Vector3d& measurement);
+
+    /**
+     * Non-throwing variant of mergePoint.
+     * Returns false if the sensor origin or the measurement is outside of the grid.
+     * A RayIntegrationContext is set up per call, merge many points with the context overloads.
+     */
+    bool tryMergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement);
+
+    /**
+     * Non-throwing variant of mergePoint.
+     * Returns false if the measurement is outside of the grid.
+     * A RayIntegrationContext is set up per call, merge many points with the context overloads.
+     */
+    bool tryMergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3i& sensor_origin_idx, const Eigen::Vector3d& measurement);
+
+    /**
+     * Merges a measurement given in the frame of \c context, see RayIntegrationContext::reset.
+     * Returns false if the measurement is outside of the grid.
+     */
+    bool tryMergePoint(RayIntegrationContext& context, const Eigen::Vector3d& measurement);
+
     bool isOccupied(const Eigen::Vector3d& point) const;
 
     bool isOccupied(Index idx, float z) const;
@@ -99,6 +167,35 @@ public:
 
 protected:
 
+    /**
+     * Merges the measurements \c measurement(i) for all i in [0, num_points), given in the frame
+     * of \c context, one by one.
+     */
+    MergeStatistics mergeMeasurements(RayIntegrationContext& context, size_t num_points,
+                                      const std::function<Eigen::Vector3d (size_t)>& measurement);
+
+    /**
+     * Applies the hit update of \c measurement and the miss updates along its ray, \c update holds
+     * the log-odds of the configuration in the representation of the voxel type.
+     * Returns false if the measurement is outside of the grid.
+     */
+    template<class UpdateT>
+    bool integrateRay(RayIntegrationContext& context, const Eigen::Vector3d& measurement, const UpdateT& update);
+
+    /**
+     * Traces the rays from \c sensor_origin to \c measurement(i) for all i in [0, num_points) in parallel
+     * and applies the hit and miss updates afterwards, see mergePointCloudParallel.
+     */
+    MergeStatistics mergeMeasurementsParallel(const Eigen::Vector3d& sensor_origin, size_t num_points,
+                                              const std::function<Eigen::Vector3d (size_t)>& measurement, unsigned num_threads);
+
+    /**
+     * Applies the updates of all measurements with at most one update per voxel,
+     * see mergePointCloud(const PointCloud&, const base::Transform3d&, bool, unsigned).
+     */
+    MergeStatistics mergeMeasurementsCoalesced(const Eigen::Vector3d& sensor_origin, size_t num_points,
+                                               const std::function<Eigen::Vector3d (size_t)>& measurement, unsigned num_threads);
+
     /** Grants access to boost serialization */
     friend class boost::serialization::access;
 
@@ -107,10 +204,25 @@ protected:
     void serialize(Archive &ar, const unsigned int version)
     {
         ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(OccupancyGridMapBase);
-        ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(VoxelGridMap<OccupancyPatch>);
+        ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(VoxelGridBase);
     }
 };
 
+/** Occupancy map with float log-odds per voxel */
+typedef BasicOccupancyGridMap<OccupancyPatch> OccupancyGridMap;
+
+/** Occupancy map with 16 bit fixed-point log-odds per voxel, uses about a third of the memory */
+typedef BasicOccupancyGridMap<QuantizedOccupancyPatch> QuantizedOccupancyGridMap;
+
+/** Occupancy map with dense voxel columns, see DenseColumn */
+typedef BasicOccupancyGridMap<OccupancyPatch, DenseColumn<OccupancyPatch> > DenseOccupancyGridMap;
+
+extern template class BasicOccupancyGridMap<OccupancyPatch>;
+extern template class BasicOccupancyGridMap<QuantizedOccupancyPatch>;
+extern template class BasicOccupancyGridMap<OccupancyPatch, DenseColumn<OccupancyPatch> >;
+
 }}
 
-BOOST_CLASS_EXPORT_KEY(maps::grid::OccupancyGridMap);
+BOOST_CLASS_EXPORT_KEY2(maps::grid::OccupancyGridMap, "maps::grid::OccupancyGridMap");
+BOOST_CLASS_EXPORT_KEY2(maps::grid::QuantizedOccupancyGridMap, "maps::grid::QuantizedOccupancyGridMap");
+BOOST_CLASS_EXPORT_KEY2(maps::grid::DenseOccupancyGridMap, "maps::grid::DenseOccupancyGridMap");
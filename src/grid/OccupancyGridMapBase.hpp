@@ -29,6 +29,7 @@
 #include "OccupancyConfiguration.hpp"
 
 #include <Eigen/Core>
+#include <stdexcept>
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/assume_abstract.hpp>
@@ -43,6 +44,24 @@ public:
     virtual ~OccupancyGridMapBase() {}
 
     virtual void mergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement) = 0;
+
+    /**
+     * Non-throwing variant of mergePoint.
+     * Returns false if the measurement couldn't be added to the map.
+     */
+    virtual bool tryMergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement)
+    {
+        try
+        {
+            mergePoint(sensor_origin, measurement);
+        }
+        catch(const std::runtime_error& e)
+        {
+            return false;
+        }
+        return true;
+    }
+
     virtual bool isOccupied(const Eigen::Vector3d& point) const = 0;
     virtual bool isOccupied(Index idx, float z) const = 0;
     virtual bool isFreeSpace(const Eigen::Vector3d& point) const = 0;
@@ -0,0 +1,163 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include "HalfFloat.hpp"
+
+#include <cmath>
+
+#include <base/Float.hpp>
+
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/version.hpp>
+
+namespace maps { namespace grid
+{
+
+/**
+ * Compact variant of TSDFPatch.
+ *
+ * The class is non-polymorphic and trivially copyable, distance and variance are stored
+ * as \c T, which is either float or HalfFloat. A voxel including its DiscreteTree key takes
+ * 12 bytes with float and 8 bytes with half precision instead of 24 bytes.
+ * The Kalman update is computed in single precision.
+ *
+ * Archives of version 0 store both values as float, which is the format of TSDFPatch. The
+ * half precision variant is written with version 1 and stores the raw half values. Both
+ * versions can be loaded by every TSDF voxel type.
+ */
+template<class T>
+class PackedTSDFPatch
+{
+    T distance;
+    T var;
+
+public:
+    PackedTSDFPatch() : distance(base::NaN<float>()), var(1.f) {}
+    PackedTSDFPatch(float distance, float var) : distance(distance), var(var) {}
+
+    void update(float distance, float var, float truncation = 1.f, float min_var = 0.001f)
+    {
+        float mean = this->distance;
+        float variance = this->var;
+        if(base::isNaN<float>(mean))
+            mean = distance;
+
+        float gain = variance / (variance + var);
+        if( gain != gain )
+            gain = 0.5f; // this happens when both vars are 0.
+        mean = mean + gain * (distance - mean);
+        variance = (1.0f - gain) * variance;
+
+        if(variance < min_var)
+            variance = min_var;
+
+        this->distance = mean;
+        this->var = variance;
+    }
+
+    float getDistance() const
+    {
+        return distance;
+    }
+
+    float getVariance() const
+    {
+        return var;
+    }
+
+    float getStandardDeviation() const
+    {
+        return std::sqrt(getVariance());
+    }
+
+    bool operator==(const PackedTSDFPatch& other) const
+    {
+        return this == &other;
+    }
+
+protected:
+
+    /** Grants access to boost serialization */
+    friend class boost::serialization::access;
+
+    /** Saves the members in the format given by the class version */
+    template <typename Archive>
+    void save(Archive &ar, const unsigned int version) const
+    {
+        if(version == 0)
+        {
+            float distance = this->distance;
+            float var = this->var;
+            ar << BOOST_SERIALIZATION_NVP(distance);
+            ar << BOOST_SERIALIZATION_NVP(var);
+        }
+        else
+        {
+            uint16_t distance = HalfFloat(this->distance).bits;
+            uint16_t var = HalfFloat(this->var).bits;
+            ar << BOOST_SERIALIZATION_NVP(distance);
+            ar << BOOST_SERIALIZATION_NVP(var);
+        }
+    }
+
+    /** Loads version 0 (float) and version 1 (half precision) archives */
+    template <typename Archive>
+    void load(Archive &ar, const unsigned int version)
+    {
+        if(version == 0)
+        {
+            float distance, var;
+            ar >> BOOST_SERIALIZATION_NVP(distance);
+            ar >> BOOST_SERIALIZATION_NVP(var);
+            this->distance = distance;
+            this->var = var;
+        }
+        else
+        {
+            uint16_t distance, var;
+            ar >> BOOST_SERIALIZATION_NVP(distance);
+            ar >> BOOST_SERIALIZATION_NVP(var);
+            this->distance = HalfFloat::toFloat(distance);
+            this->var = HalfFloat::toFloat(var);
+        }
+    }
+
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+};
+
+/** Single precision TSDF voxel, stored in the same format as TSDFPatch */
+typedef PackedTSDFPatch<float> PackedTSDFPatchFloat;
+
+/** Half precision TSDF voxel */
+typedef PackedTSDFPatch<HalfFloat> PackedTSDFPatchHalf;
+
+}}
+
+BOOST_CLASS_VERSION(maps::grid::PackedTSDFPatchHalf, 1)
@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/nvp.hpp>
+
+namespace maps { namespace grid
+{
+
+/**
+ * Compact variant of OccupancyPatch.
+ *
+ * The log-odds are stored as 16 bit fixed-point value with a resolution of 1/LOGODDS_SCALE,
+ * updates and clamping are done in integer arithmetic. The class is non-polymorphic and trivially
+ * copyable, a voxel including its DiscreteTree key takes 8 instead of 24 bytes.
+ */
+class QuantizedOccupancyPatch
+{
+public:
+    /** Number of quantization steps per log-odds unit, the representable range is about [-32, 32] */
+    static const int32_t LOGODDS_SCALE = 1024;
+
+    QuantizedOccupancyPatch(double initial_probability) : log_odds(quantize(logodds(initial_probability))) {}
+    QuantizedOccupancyPatch(float initial_log_odds = 0.f) : log_odds(quantize(initial_log_odds)) {}
+
+    double getPropability() const
+    {
+        return probability(getLogOdds());
+    }
+
+    float getLogOdds() const
+    {
+        return (float)log_odds / LOGODDS_SCALE;
+    }
+
+    /** Returns the raw fixed-point log-odds */
+    int16_t getQuantizedLogOdds() const
+    {
+        return log_odds;
+    }
+
+    bool isOccupied(double occupied_tresshold = 0.8) const
+    {
+        return getPropability() >= occupied_tresshold;
+    }
+
+    bool isFreeSpace(double not_occupied_tresshold = 0.3) const
+    {
+        return getPropability() < not_occupied_tresshold;
+    }
+
+    void updatePropability(double update_prob, double min_prob = 0.1192, double max_prob = 0.971)
+    {
+        updateLogOdds(logodds(update_prob), logodds(min_prob), logodds(max_prob));
+    }
+
+    void updateLogOdds(float update_logodds, float min = -2.f, float max = 3.5f)
+    {
+        updateQuantizedLogOdds(quantize(update_logodds), quantize(min), quantize(max));
+    }
+
+    /** Same as updateLogOdds with already quantized values */
+    void updateQuantizedLogOdds(int16_t update_logodds, int16_t min, int16_t max)
+    {
+        int32_t value = (int32_t)log_odds + update_logodds;
+        if(value < min)
+            value = min;
+        else if(value > max)
+            value = max;
+        log_odds = (int16_t)value;
+    }
+
+    bool operator==(const QuantizedOccupancyPatch& other) const
+    {
+        return log_odds == other.log_odds;
+    }
+
+    /** Converts log-odds to the fixed-point representation, saturating at the int16 limits */
+    static inline int16_t quantize(float logodds)
+    {
+        float scaled = std::round(logodds * LOGODDS_SCALE);
+        if(scaled < INT16_MIN)
+            return INT16_MIN;
+        if(scaled > INT16_MAX)
+            return INT16_MAX;
+        return (int16_t)scaled;
+    }
+
+    // compute log-odds from probability
+    static inline float logodds(double probability)
+    {
+        return (float)log(probability / (1.0 - probability));
+    }
+
+    // compute probability from log-odds
+    static inline double probability(double logodds)
+    {
+        return 1.0 - ( 1.0 / (1.0 + exp(logodds)));
+    }
+
+protected:
+    int16_t log_odds;
+
+    /** Grants access to boost serialization */
+    friend class boost::serialization::access;
+
+    /** Serializes the members of this class*/
+    template <typename Archive>
+    void serialize(Archive &ar, const unsigned int version)
+    {
+        ar & BOOST_SERIALIZATION_NVP(log_odds);
+    }
+};
+
+}}
@@ -0,0 +1,79 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <maps/tools/VoxelTraversal.hpp>
+
+#include <base/Eigen.hpp>
+#include <vector>
+
+namespace maps { namespace grid
+{
+
+/**
+ * Scratch state for integrating the measurements of one sensor origin into a voxel map,
+ * see the mergePoint and tryMergePoint overloads of OccupancyGridMap and TSDFVolumetricMap
+ * taking a context. The ray buffer is kept between the measurements, so merging a point doesn't
+ * allocate once the buffer has grown to the longest ray. The overloads without a context set up
+ * a new one per call. A context can be reused for several point clouds
+ * and maps, but it must not be shared between threads.
+ */
+struct RayIntegrationContext
+{
+    RayIntegrationContext() : voxel_resolution(Eigen::Vector3d::Ones()), pc2grid(base::Transform3d::Identity()),
+                              sensor_origin(Eigen::Vector3d::Zero()), sensor_origin_idx(Eigen::Vector3i::Zero()) {}
+
+    /**
+     * Prepares the context for measurements given in a frame with the transformation \c pc2grid
+     * into the grid of \c map. Returns false if the sensor origin is outside of the grid.
+     */
+    template<class MapT>
+    bool reset(const MapT& map, const base::Transform3d& pc2grid, const Eigen::Vector3d& sensor_origin_in_pc)
+    {
+        voxel_resolution = map.getVoxelResolution();
+        this->pc2grid = pc2grid;
+        sensor_origin = pc2grid * sensor_origin_in_pc;
+        return map.toVoxelGrid(sensor_origin, sensor_origin_idx);
+    }
+
+    /** voxel resolution of the map */
+    Eigen::Vector3d voxel_resolution;
+
+    /** transformation of the measurements into the grid frame */
+    base::Transform3d pc2grid;
+
+    /** sensor origin in the grid frame */
+    Eigen::Vector3d sensor_origin;
+
+    /** voxel index of the sensor origin */
+    Eigen::Vector3i sensor_origin_idx;
+
+    /** reusable buffer of the current ray */
+    std::vector<tools::VoxelTraversal::RayElement> ray;
+};
+
+}}
@@ -0,0 +1,406 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <stdexcept>
+#include <cstdlib>
+
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost_serialization/ClassVersion.hpp>
+#include <boost_serialization/DynamicSizeSerialization.hpp>
+
+#include <maps/grid/Index.hpp>
+
+namespace maps { namespace grid
+{
+
+    /**
+     * Grid storage with a wrapping origin, usable as GridT of a GridMap.
+     *
+     * The cells are kept in a ring buffer in both dimensions. Moving the grid
+     * only shifts the origin offset and resets the rows and columns which
+     * enter the window, i.e. moveBy is O(|dx| * ny + |dy| * nx) and does not
+     * allocate. Access and iteration are in logical (row-major) order, the
+     * serialized format is identical to the one of VectorGrid
+     * without chunked archive mode.
+     */
+    template <typename CellT>
+    class RingBufferGrid
+    {
+        /** The cells grid element, stored with a wrapping origin **/
+        std::vector<CellT> cells;
+
+        /** Number of cells in X-axis and Y-axis **/
+        Vector2ui num_cells;
+
+        /** Physical position of the logical cell (0,0) **/
+        Vector2ui origin;
+
+        /** Default value **/
+        CellT default_value;
+
+        /** Iterates the cells in logical row-major order */
+        template<class GridPtrT, class ValueT>
+        class LogicalIterator : public boost::iterator_facade<LogicalIterator<GridPtrT, ValueT>, ValueT,
+                                                              boost::random_access_traversal_tag>
+        {
+        public:
+            LogicalIterator() : grid(nullptr), idx(0) {}
+            LogicalIterator(GridPtrT grid, size_t idx) : grid(grid), idx(idx) {}
+
+            /** allows conversion from iterator to const_iterator */
+            template<class OtherGridPtrT, class OtherValueT>
+            LogicalIterator(const LogicalIterator<OtherGridPtrT, OtherValueT>& other)
+                : grid(other.grid), idx(other.idx) {}
+
+        private:
+            friend class boost::iterator_core_access;
+            template<class, class> friend class LogicalIterator;
+
+            ValueT& dereference() const
+            {
+                const size_t nx = grid->num_cells.x();
+                return grid->cells[grid->toPhysicalIdx(idx % nx, idx / nx)];
+            }
+
+            template<class OtherGridPtrT, class OtherValueT>
+            bool equal(const LogicalIterator<OtherGridPtrT, OtherValueT>& other) const { return idx == other.idx; }
+
+            void increment() { ++idx; }
+            void decrement() { --idx; }
+            void advance(std::ptrdiff_t n) { idx += n; }
+
+            template<class OtherGridPtrT, class OtherValueT>
+            std::ptrdiff_t distance_to(const LogicalIterator<OtherGridPtrT, OtherValueT>& other) const
+            {
+                return std::ptrdiff_t(other.idx) - std::ptrdiff_t(idx);
+            }
+
+            GridPtrT grid;
+            size_t idx;
+        };
+
+    public:
+
+        typedef CellT CellType;
+        typedef LogicalIterator<RingBufferGrid*, CellT> iterator;
+        typedef LogicalIterator<const RingBufferGrid*, const CellT> const_iterator;
+
+        RingBufferGrid(Vector2ui size, CellT default_value)
+            : num_cells(0, 0),
+              origin(0, 0),
+              default_value(default_value)
+        {
+            resize(size);
+        }
+
+        RingBufferGrid(Vector2ui size)
+            : RingBufferGrid(size, CellT())
+        {
+        }
+
+        RingBufferGrid()
+            : RingBufferGrid(Vector2ui(0,0), CellT())
+        {
+        }
+
+        RingBufferGrid(const RingBufferGrid &other)
+            : cells(other.cells),
+              num_cells(other.num_cells),
+              origin(other.origin),
+              default_value(other.default_value)
+        {
+        }
+
+        template<class CellT2>
+        RingBufferGrid(const RingBufferGrid<CellT2>& other)
+            : cells(other.begin(), other.end())
+            , num_cells(other.getNumCells())
+            , origin(0, 0)
+            , default_value(other.getDefaultValue())
+        {
+        }
+
+        const CellT &getDefaultValue() const
+        {
+            return default_value;
+        }
+
+        iterator begin()
+        {
+            return iterator(this, 0);
+        }
+
+        iterator end()
+        {
+            return iterator(this, cells.size());
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator(this, 0);
+        }
+
+        const_iterator end() const
+        {
+            return const_iterator(this, cells.size());
+        }
+
+        /**
+         * Resizes the grid. The cells of the overlapping logical region are kept.
+         */
+        void resize(const Vector2ui &new_number_cells)
+        {
+            if (new_number_cells == num_cells)
+                return;
+
+            std::vector<CellT> tmp(new_number_cells.prod(), default_value);
+            const unsigned int max_x = std::min(num_cells.x(), new_number_cells.x());
+            const unsigned int max_y = std::min(num_cells.y(), new_number_cells.y());
+            for (unsigned int y = 0; y < max_y; ++y)
+            {
+                for (unsigned int x = 0; x < max_x; ++x)
+                {
+                    std::swap(cells[toPhysicalIdx(x, y)], tmp[x + y * new_number_cells.x()]);
+                }
+            }
+
+            cells.swap(tmp);
+            num_cells = new_number_cells;
+            origin = Vector2ui(0, 0);
+        }
+
+        /**
+         * @brief Move the content of the grid cells
+         * @details by the offset described in the argument. Only the origin
+         * is shifted, the rows and columns entering the grid are reset to the
+         * default value.
+         * @return void
+         */
+        void moveBy(const Index &idx)
+        {
+            // if all grid values should be moved outside
+            if (std::abs(idx.x()) >= int(num_cells.x())
+                || std::abs(idx.y()) >= int(num_cells.y()))
+            {
+                clear();
+                return;
+            }
+
+            // the content of the logical cell (x,y) moves to (x + dx, y + dy)
+            origin.x() = (origin.x() + num_cells.x() - idx.x()) % num_cells.x();
+            origin.y() = (origin.y() + num_cells.y() - idx.y()) % num_cells.y();
+
+            // reset the columns entering the grid
+            const unsigned int x_start = idx.x() >= 0 ? 0 : num_cells.x() + idx.x();
+            const unsigned int x_end = idx.x() >= 0 ? idx.x() : num_cells.x();
+            for (unsigned int y = 0; y < num_cells.y(); ++y)
+            {
+                for (unsigned int x = x_start; x < x_end; ++x)
+                    cells[toPhysicalIdx(x, y)] = default_value;
+            }
+
+            // reset the rows entering the grid
+            const unsigned int y_start = idx.y() >= 0 ? 0 : num_cells.y() + idx.y();
+            const unsigned int y_end = idx.y() >= 0 ? idx.y() : num_cells.y();
+            for (unsigned int y = y_start; y < y_end; ++y)
+            {
+                for (unsigned int x = 0; x < num_cells.x(); ++x)
+                    cells[toPhysicalIdx(x, y)] = default_value;
+            }
+        }
+
+        const CellT& at(const Index &idx) const
+        {
+            return this->at(idx.x(), idx.y());
+        }
+
+        CellT& at(const Index &idx)
+        {
+            return this->at(idx.x(), idx.y());
+        }
+
+        const CellT& at(size_t x, size_t y) const
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            return cells[toPhysicalIdx(x, y)];
+        }
+
+        CellT& at(size_t x, size_t y)
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            return cells[toPhysicalIdx(x, y)];
+        }
+
+        const Vector2ui &getNumCells() const
+        {
+            return num_cells;
+        };
+
+        /** Physical position of the logical cell (0,0) inside the ring buffer */
+        const Vector2ui &getOrigin() const
+        {
+            return origin;
+        }
+
+        void clear()
+        {
+            for(CellT &e : cells)
+            {
+                e = default_value;
+            }
+            origin = Vector2ui(0, 0);
+        };
+
+        /**
+         * Calls f(idx, cell) for every cell backed by storage, i.e. all cells
+         * of this grid in logical order.
+         */
+        template<class Function>
+        void forEachAllocatedCell(Function f) const
+        {
+            for (unsigned int y = 0; y < num_cells.y(); ++y)
+            {
+                for (unsigned int x = 0; x < num_cells.x(); ++x)
+                    f(Index(x, y), cells[toPhysicalIdx(x, y)]);
+            }
+        }
+
+    protected:
+        /** Maps a logical cell position to the position in the ring buffer */
+        size_t toPhysicalIdx(size_t x, size_t y) const
+        {
+            x += origin.x();
+            if (x >= num_cells.x())
+                x -= num_cells.x();
+            y += origin.y();
+            if (y >= num_cells.y())
+                y -= num_cells.y();
+            return x + y * num_cells.x();
+        }
+
+        /** Grants access to boost serialization */
+        friend class boost::serialization::access;
+
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+        /** serialize members, uses the same format as VectorGrid */
+        template<class Archive>
+        void save(Archive & ar, const unsigned int version) const
+        {
+            ar << BOOST_SERIALIZATION_NVP(num_cells.derived());
+            ar << BOOST_SERIALIZATION_NVP(default_value);
+
+            // the chunked mode of VectorGrid is not supported
+            bool chunked = false;
+            ar << BOOST_SERIALIZATION_NVP(chunked);
+
+            const_iterator block_start_cell = begin();
+            const_iterator block_end_cell;
+            uint64_t block_size;
+            bool block_occupied;
+            while (block_start_cell != end())
+            {
+                // identify the next block of occupied or non-occupied cells
+                block_occupied = *block_start_cell != default_value;
+                block_end_cell = block_start_cell + 1;
+                while (block_end_cell != end() && (*block_end_cell != default_value) == block_occupied)
+                    block_end_cell++;
+                block_size = std::distance(block_start_cell, block_end_cell);
+
+                // save bock header
+                ar << block_occupied;
+                saveSizeValue(ar, block_size);
+
+                // set start cell equal to end cell if the block is not occupied
+                if (!block_occupied)
+                    block_start_cell = block_end_cell;
+
+                // write cells
+                while (block_start_cell != block_end_cell)
+                {
+                    ar << *block_start_cell;
+                    block_start_cell++;
+                }
+            }
+        }
+
+        /** deserialize members */
+        template<class Archive>
+        void load(Archive & ar, const unsigned int version)
+        {
+            ar >> BOOST_SERIALIZATION_NVP(num_cells.derived());
+            ar >> BOOST_SERIALIZATION_NVP(default_value);
+            cells.clear();
+            cells.resize(num_cells.x() * num_cells.y(), default_value);
+            origin = Vector2ui(0, 0);
+
+            bool chunked = false;
+            if (version >= 2)
+                ar >> BOOST_SERIALIZATION_NVP(chunked);
+            if (chunked)
+                throw std::runtime_error("RingBufferGrid: chunked archives are not supported");
+
+            // return of cells are empty
+            if (cells.empty())
+                return;
+
+            bool block_occupied;
+            uint64_t block_size;
+            size_t current_cell = 0;
+            size_t block_end;
+            while (current_cell < cells.size())
+            {
+                // receive block header
+                ar >> block_occupied;
+                loadSizeValue(ar, block_size);
+                if (block_size > uint64_t(cells.size() - current_cell))
+                    throw std::runtime_error("RingBufferGrid: invalid block size in archive");
+                block_end = current_cell + block_size;
+
+                // skip, if cells of this block are not occupied
+                if (!block_occupied)
+                    current_cell = block_end;
+
+                // read cells
+                while (current_cell < block_end)
+                {
+                    ar >> cells[current_cell];
+                    current_cell++;
+                }
+            }
+        }
+    };
+}}
+
+BOOST_TEMPLATED_CLASS_VERSION(maps::grid::RingBufferGrid, 2)
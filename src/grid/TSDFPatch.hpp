@@ -32,6 +32,9 @@
 
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+
+#include "HalfFloat.hpp"
 
 
 namespace maps { namespace grid
@@ -97,13 +100,34 @@ protected:
     /** Grants access to boost serialization */
     friend class boost::serialization::access;
 
-    /** Serializes the members of this class*/
+    /** Saves the members of this class*/
+    template <typename Archive>
+    void save(Archive &ar, const unsigned int version) const
+    {
+	ar << BOOST_SERIALIZATION_NVP(distance);
+	ar << BOOST_SERIALIZATION_NVP(var);
+    }
+
+    /** Loads the members, version 1 archives store half precision values (see PackedTSDFPatch) */
     template <typename Archive>
-    void serialize(Archive &ar, const unsigned int version)
+    void load(Archive &ar, const unsigned int version)
     {
-	ar & BOOST_SERIALIZATION_NVP(distance);
-	ar & BOOST_SERIALIZATION_NVP(var);
+	if(version == 0)
+	{
+	    ar >> BOOST_SERIALIZATION_NVP(distance);
+	    ar >> BOOST_SERIALIZATION_NVP(var);
+	}
+	else
+	{
+	    uint16_t distance, var;
+	    ar >> BOOST_SERIALIZATION_NVP(distance);
+	    ar >> BOOST_SERIALIZATION_NVP(var);
+	    this->distance = HalfFloat::toFloat(distance);
+	    this->var = HalfFloat::toFloat(var);
+	}
     }
+
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
 
 }  //namespace grid
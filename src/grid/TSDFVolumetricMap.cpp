@@ -27,137 +27,522 @@
 #include "TSDFVolumetricMap.hpp"
 #include <boost/format.hpp>
 #include <maps/tools/VoxelTraversal.hpp>
+#include <maps/tools/ParallelFor.hpp>
+#include <algorithm>
 
 using namespace maps::grid;
 using namespace maps::tools;
 
-void TSDFVolumetricMap::mergePointCloud(const TSDFVolumetricMap::PointCloud& pc, const base::Transform3d& pc2grid, double measurement_variance)
+namespace
 {
+    /** Span of a ray within one grid column */
+    struct RaySpan
+    {
+        size_t column;
+        int32_t z_first;
+        int32_t z_last;
+        size_t ray;
+    };
+
+    /** Direction and length of a ray from the sensor origin to a measurement */
+    struct Ray
+    {
+        Eigen::Vector3d normal;
+        double length;
+    };
+
+    /** Number of points traced into one update buffer */
+    const size_t RAY_BLOCK_SIZE = 1024;
+
+    /** Transformation from the point cloud to the sensor frame given by sensor_origin_ and sensor_orientation_ */
+    base::Transform3d getCloudToSensor(const pcl::PointCloud<pcl::PointXYZ>& pc)
+    {
+        base::Transform3d sensor2pc = base::Transform3d::Identity();
+        sensor2pc.linear() = pc.sensor_orientation_.cast<double>().toRotationMatrix();
+        sensor2pc.translation() = pc.sensor_origin_.head<3>().cast<double>();
+        return sensor2pc.inverse();
+    }
+
+    /**
+     * Computes the ray from the sensor origin of the context to the measurement extended by the
+     * truncation into the ray buffer of the context. Returns false if the ray is degenerated.
+     */
+    template<class MapT>
+    bool computeTruncatedRay(const MapT& map, float truncation, RayIntegrationContext& context, const Eigen::Vector3d& measurement)
+    {
+        Eigen::Vector3d measurement_normal = (measurement - context.sensor_origin).normalized();
+        Eigen::Vector3d end_point = measurement + truncation * measurement_normal;
+
+        Eigen::Vector3i end_point_idx;
+        if(!map.toVoxelGrid(end_point, end_point_idx, false))
+            return false;
+
+        VoxelTraversal::computeRay(context.voxel_resolution, context.sensor_origin, context.sensor_origin_idx, end_point, context.ray);
+
+        if(context.ray.empty())
+            return false;
+
+        // re-add last cell in ray
+        context.ray.push_back(VoxelTraversal::RayElement(end_point_idx, 1));
+        return true;
+    }
+}
+
+template<class CellT, class ColumnT>
+MergeStatistics BasicTSDFVolumetricMap<CellT, ColumnT>::mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2grid, double measurement_variance)
+{
+    RayIntegrationContext context;
+    return mergePointCloud(pc, pc2grid, context, measurement_variance);
+}
+
+template<class CellT, class ColumnT>
+MergeStatistics BasicTSDFVolumetricMap<CellT, ColumnT>::mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2grid, RayIntegrationContext& context, double measurement_variance)
+{
+    MergeStatistics stats;
     Eigen::Vector3d sensor_origin = pc.sensor_origin_.head<3>().cast<double>();
-    Eigen::Vector3d sensor_origin_in_grid = pc2grid * sensor_origin;
+    if(!checkSensorOrigin(pc2grid * sensor_origin, pc.size(), stats))
+        return stats;
 
-    for(PointCloud::const_iterator it=pc.begin(); it != pc.end(); ++it)
+    context.reset(*this, pc2grid, sensor_origin);
+    for(typename PointCloud::const_iterator it=pc.begin(); it != pc.end(); ++it)
     {
-        try
-        {
-            Eigen::Vector3d measurement = it->getArray3fMap().cast<double>();
-            mergePoint(sensor_origin_in_grid, pc2grid * measurement, measurement_variance);
-        }
-        catch(const std::runtime_error& e)
-        {
-            LOG_ERROR_S << e.what();
-        }
+        if(tryMergePoint(context, it->getArray3fMap().cast<double>(), measurement_variance))
+            stats.merged++;
+        else
+            stats.invalid++;
     }
+    return stats;
 }
 
-void TSDFVolumetricMap::mergePointCloud(const TSDFVolumetricMap::PointCloud& pc, const base::TransformWithCovariance& pc2grid, double measurement_variance)
+template<class CellT, class ColumnT>
+MergeStatistics BasicTSDFVolumetricMap<CellT, ColumnT>::mergePointCloud(const PointCloud& pc, const base::TransformWithCovariance& pc2grid, double measurement_variance)
 {
+    MergeStatistics stats;
     Eigen::Vector3d sensor_origin = pc.sensor_origin_.head<3>().cast<double>();
     Eigen::Vector3d sensor_origin_in_grid = pc2grid.getTransform() * sensor_origin;
+    if(!checkSensorOrigin(sensor_origin_in_grid, pc.size(), stats))
+        return stats;
 
-    for(PointCloud::const_iterator it=pc.begin(); it != pc.end(); ++it)
+    RayIntegrationContext context;
+    context.reset(*this, base::Transform3d::Identity(), sensor_origin_in_grid);
+    for(typename PointCloud::const_iterator it=pc.begin(); it != pc.end(); ++it)
     {
         std::pair<Eigen::Vector3d, Eigen::Matrix3d> measurement_in_map = pc2grid.composePointWithCovariance(it->getArray3fMap().cast<double>(), Eigen::Matrix3d::Zero());
-        try
+        if(tryMergePoint(context, measurement_in_map.first, measurement_variance + measurement_in_map.second(2,2)))
+            stats.merged++;
+        else
+            stats.invalid++;
+    }
+    return stats;
+}
+
+template<class CellT, class ColumnT>
+MergeStatistics BasicTSDFVolumetricMap<CellT, ColumnT>::mergePointCloudParallel(const PointCloud& pc, const base::Transform3d& pc2grid,
+                                                                       double measurement_variance, unsigned num_threads)
+{
+    MergeStatistics stats;
+    Eigen::Vector3d sensor_origin = pc.sensor_origin_.head<3>().cast<double>();
+    Eigen::Vector3d sensor_origin_in_grid = pc2grid * sensor_origin;
+    if(!checkSensorOrigin(sensor_origin_in_grid, pc.size(), stats))
+        return stats;
+
+    const size_t num_points = pc.size();
+    const size_t num_cells_x = this->getNumCells().x();
+    const size_t num_columns = num_cells_x * this->getNumCells().y();
+
+    Eigen::Vector3i sensor_origin_idx;
+    VoxelGridBase::toVoxelGrid(sensor_origin_in_grid, sensor_origin_idx);
+
+    // trace the rays, every block of points collects its spans in its own buffer
+    std::vector<Ray> rays(num_points);
+    const size_t num_blocks = (num_points + RAY_BLOCK_SIZE - 1) / RAY_BLOCK_SIZE;
+    std::vector< std::vector<RaySpan> > block_spans(num_blocks);
+    std::vector<size_t> block_merged(num_blocks, 0);
+    parallelFor(0, num_blocks, [&](size_t b)
+    {
+        // the rays end at the measurements extended by the truncation
+        std::vector<Eigen::Vector3d> end_points;
+        std::vector<Eigen::Vector3i> end_point_idxs;
+        std::vector<size_t> ray_ids;
+        end_points.reserve(RAY_BLOCK_SIZE);
+        end_point_idxs.reserve(RAY_BLOCK_SIZE);
+        ray_ids.reserve(RAY_BLOCK_SIZE);
+        const size_t end = std::min(num_points, (b + 1) * RAY_BLOCK_SIZE);
+        for(size_t i = b * RAY_BLOCK_SIZE; i < end; ++i)
         {
-            mergePoint(sensor_origin_in_grid, measurement_in_map.first, measurement_variance + measurement_in_map.second(2,2));
+            Eigen::Vector3d measurement = pc2grid * pc[i].getArray3fMap().cast<double>();
+            rays[i].normal = (measurement - sensor_origin_in_grid).normalized();
+            rays[i].length = (measurement - sensor_origin_in_grid).norm();
+            Eigen::Vector3d end_point = measurement + truncation * rays[i].normal;
+            Eigen::Vector3i end_point_idx;
+            if(!VoxelGridBase::toVoxelGrid(end_point, end_point_idx, false))
+                continue;
+            end_points.push_back(end_point);
+            end_point_idxs.push_back(end_point_idx);
+            ray_ids.push_back(i);
         }
-        catch(const std::runtime_error& e)
+
+        VoxelTraversal::RayBuffer ray_buffer;
+        VoxelTraversal::computeRays(this->getVoxelResolution(), sensor_origin_in_grid, sensor_origin_idx, end_points.data(), end_points.size(), ray_buffer);
+
+        std::vector<RaySpan>& spans = block_spans[b];
+        for(size_t r = 0; r < ray_buffer.size(); ++r)
+        {
+            if(ray_buffer.empty(r))
+                continue;
+
+            // rest of the ray is probably out of grid if an element is outside
+            auto addSpan = [&](const VoxelTraversal::RayElement& element)
+            {
+                if(!GridMapBase::inGrid(element.idx))
+                    return false;
+                spans.push_back({element.idx.y() * num_cells_x + element.idx.x(), element.z_first, element.z_last, ray_ids[r]});
+                return true;
+            };
+            bool in_grid = true;
+            for(std::vector<VoxelTraversal::RayElement>::const_iterator element = ray_buffer.begin(r); in_grid && element != ray_buffer.end(r); ++element)
+                in_grid = addSpan(*element);
+            // re-add last cell in ray
+            if(in_grid)
+                addSpan(VoxelTraversal::RayElement(end_point_idxs[r], 1));
+            block_merged[b]++;
+        }
+    }, num_threads, 1);
+
+    for(size_t merged : block_merged)
+        stats.merged += merged;
+    stats.invalid = num_points - stats.merged;
+
+    // group the spans by column, a stable counting sort keeps the order of the point cloud
+    std::vector<size_t> column_starts(num_columns + 1, 0);
+    for(const std::vector<RaySpan>& spans : block_spans)
+    {
+        for(const RaySpan& span : spans)
+            column_starts[span.column + 1]++;
+    }
+    std::vector<size_t> touched_columns;
+    for(size_t c = 0; c < num_columns; ++c)
+    {
+        if(column_starts[c + 1] > 0)
+            touched_columns.push_back(c);
+        column_starts[c + 1] += column_starts[c];
+    }
+
+    std::vector<RaySpan> sorted_spans(column_starts.back());
+    std::vector<size_t> column_fill(column_starts.begin(), column_starts.end() - 1);
+    for(std::vector<RaySpan>& spans : block_spans)
+    {
+        for(const RaySpan& span : spans)
+            sorted_spans[column_fill[span.column]++] = span;
+        std::vector<RaySpan>().swap(spans);
+    }
+
+    // apply the updates, every column is owned by a single thread
+    parallelFor(0, touched_columns.size(), [&](size_t t)
+    {
+        const size_t column = touched_columns[t];
+        const Index idx(column % num_cells_x, column / num_cells_x);
+        for(size_t s = column_starts[column]; s < column_starts[column + 1]; ++s)
         {
-            // TODO use glog or base log for all out prints of this library
-            std::cerr << e.what() << std::endl;
+            const RaySpan& span = sorted_spans[s];
+            const Ray& ray = rays[span.ray];
+            updateSpan(idx, span.z_first, span.z_last, sensor_origin_in_grid, ray.normal, ray.length, measurement_variance);
         }
+    }, num_threads, 16);
+
+    if(this->isDirtyTrackingEnabled())
+    {
+        for(size_t column : touched_columns)
+            this->markDirty(Index(column % num_cells_x, column / num_cells_x));
     }
+    return stats;
 }
 
-void TSDFVolumetricMap::mergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement, double measurement_variance)
+PinholeIntrinsics PinholeIntrinsics::fromOrganizedCloud(const pcl::PointCloud<pcl::PointXYZ>& pc)
 {
-    Eigen::Vector3d measurement_normal = (measurement - sensor_origin).normalized();
-    Eigen::Vector3d truncated_direction = truncation * measurement_normal;
-    double ray_length = (measurement - sensor_origin).norm();
-    Eigen::Vector3d start_point = sensor_origin;
-    Eigen::Vector3d end_point = measurement + truncated_direction;
+    if(!pc.isOrganized())
+        throw std::runtime_error("Can't estimate the intrinsics of an unorganized point cloud!");
 
-    Eigen::Vector3i start_point_idx;
-    Eigen::Vector3i end_point_idx;
-    Eigen::Vector3d start_point_cell_center;
-    if(VoxelGridBase::toVoxelGrid(start_point, start_point_idx) &&
-        VoxelGridBase::toVoxelGrid(end_point, end_point_idx, false))
+    // fit u = fx * x/z + cx and v = fy * y/z + cy in the sensor frame
+    const base::Transform3d pc2sensor = getCloudToSensor(pc);
+    Eigen::Matrix2d A_u = Eigen::Matrix2d::Zero(), A_v = Eigen::Matrix2d::Zero();
+    Eigen::Vector2d b_u = Eigen::Vector2d::Zero(), b_v = Eigen::Vector2d::Zero();
+    for(uint32_t v = 0; v < pc.height; ++v)
     {
-        std::vector<VoxelTraversal::RayElement> ray;
-        VoxelTraversal::computeRay(VoxelGridBase::getVoxelResolution(), start_point, start_point_idx, end_point, ray);
+        for(uint32_t u = 0; u < pc.width; ++u)
+        {
+            const pcl::PointXYZ& point = pc.at(u, v);
+            if(!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+                continue;
+            const Eigen::Vector3d point_in_sensor = pc2sensor * Eigen::Vector3d(point.getArray3fMap().cast<double>());
+            if(point_in_sensor.z() <= 0.0)
+                continue;
+            Eigen::Vector2d a_u(point_in_sensor.x() / point_in_sensor.z(), 1.0);
+            Eigen::Vector2d a_v(point_in_sensor.y() / point_in_sensor.z(), 1.0);
+            A_u += a_u * a_u.transpose();
+            A_v += a_v * a_v.transpose();
+            b_u += a_u * u;
+            b_v += a_v * v;
+        }
+    }
+    if(std::abs(A_u.determinant()) < 1e-12 || std::abs(A_v.determinant()) < 1e-12)
+        throw std::runtime_error("Too few valid points to estimate the intrinsics of the point cloud!");
 
-        if(ray.empty())
-            throw std::runtime_error("Ray is empty!");
+    Eigen::Vector2d x_u = A_u.ldlt().solve(b_u);
+    Eigen::Vector2d x_v = A_v.ldlt().solve(b_v);
+    return PinholeIntrinsics(x_u.x(), x_v.x(), x_u.y(), x_v.y());
+}
 
-        // re-add last cell in ray
-        ray.push_back(VoxelTraversal::RayElement(end_point_idx, 1));
+template<class CellT, class ColumnT>
+MergeStatistics BasicTSDFVolumetricMap<CellT, ColumnT>::mergePointCloudProjective(const PointCloud& pc, const base::Transform3d& pc2grid,
+                                                                         double measurement_variance, unsigned num_threads)
+{
+    return mergePointCloudProjective(pc, pc2grid, PinholeIntrinsics::fromOrganizedCloud(pc), measurement_variance, num_threads);
+}
+
+template<class CellT, class ColumnT>
+MergeStatistics BasicTSDFVolumetricMap<CellT, ColumnT>::mergePointCloudProjective(const PointCloud& pc, const base::Transform3d& pc2grid, const PinholeIntrinsics& intrinsics,
+                                                                         double measurement_variance, unsigned num_threads)
+{
+    if(!pc.isOrganized())
+        throw std::runtime_error("Projective integration requires an organized point cloud!");
 
-        const float res_sigma = 2.f * VoxelGridBase::getVoxelResolution().squaredNorm() / (5.2f*5.2f);
-        const float res_sigma_inv = 1.f / res_sigma;
+    MergeStatistics stats;
+    const Eigen::Vector3d res = this->getVoxelResolution();
+    const base::Transform3d pc2sensor = getCloudToSensor(pc);
+    const base::Transform3d grid2sensor = pc2sensor * pc2grid.inverse();
 
-        for(const VoxelTraversal::RayElement& element : ray)
+    // bounding box of the truncation band around the measurements inside of the grid. Like in
+    // toVoxelGrid, x and y are given in the local frame and z is taken from the grid frame.
+    // The depths of the valid measurements along the optical axis are kept per pixel.
+    std::vector<uint8_t> valid(pc.size(), 0);
+    std::vector<double> depths(pc.size(), 0.0);
+    Eigen::Vector3d box_min = Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+    Eigen::Vector3d box_max = Eigen::Vector3d::Constant(-std::numeric_limits<double>::max());
+    for(size_t i = 0; i < pc.size(); ++i)
+    {
+        const pcl::PointXYZ& point = pc.points[i];
+        if(!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
         {
-            try
-            {
-                DiscreteTree<VoxelCellType>& tree = GridMapBase::at(element.idx);
-                Eigen::Vector3d cell_center;
-                if(GridMapBase::fromGrid(element.idx, cell_center))
-                {
-                    int32_t z_end = element.z_last + element.z_step;
-                    for(int32_t z_idx = element.z_first; z_idx != z_end; z_idx += element.z_step)
-                    {
-                        cell_center.z() = tree.getCellCenter(z_idx);
-
-                        // compute point on ray closest to the current cell center
-                        Eigen::Hyperplane<double, 3> plane(measurement_normal, cell_center);
-                        Eigen::Vector3d point_on_ray = plane.projection(sensor_origin);
-
-                        // weight the current measurement according to the distance to the cell center with the inverse normal distribution
-                        float phi = std::exp(-(point_on_ray - cell_center).squaredNorm() * res_sigma_inv);
-                        if(phi > 0.f)
-                            tree.getCellAt(z_idx).update(ray_length - (point_on_ray - sensor_origin).norm(), (1.f/phi) * measurement_variance, truncation, min_variance);
-                    }
-                }
-                else
-                {
-                    LOG_ERROR_S << "Failed to receive cell center of " << element.idx << " from grid.";
-                }
-            }
-            catch(const std::runtime_error& e)
-            {
-                // rest of the ray is probably out of grid
-                break;
-            }
+            stats.invalid++;
+            continue;
+        }
+        const Eigen::Vector3d point_in_pc = point.getArray3fMap().cast<double>();
+        depths[i] = (pc2sensor * point_in_pc).z();
+        if(depths[i] <= 0.0)
+        {
+            stats.invalid++;
+            continue;
+        }
+        const Eigen::Vector3d point_in_grid = pc2grid * point_in_pc;
+        Eigen::Vector3i point_idx;
+        if(!VoxelGridBase::toVoxelGrid(point_in_grid, point_idx))
+        {
+            // rejected like in mergePointCloud
+            stats.invalid++;
+            continue;
+        }
+        Eigen::Vector3d point_local;
+        point_local << Eigen::Vector3d(this->getLocalFrame() * point_in_grid).head<2>(), point_in_grid.z();
+        box_min = box_min.cwiseMin(point_local);
+        box_max = box_max.cwiseMax(point_local);
+        valid[i] = 1;
+        stats.merged++;
+    }
+    if(stats.merged == 0)
+        return stats;
+    box_min.array() -= truncation;
+    box_max.array() += truncation;
+
+    Eigen::Vector3i min_idx, max_idx;
+    for(int i = 0; i < 3; ++i)
+    {
+        min_idx[i] = (int)std::floor(box_min[i] / res[i]);
+        max_idx[i] = (int)std::floor(box_max[i] / res[i]);
+    }
+    min_idx.head<2>() = min_idx.head<2>().cwiseMax(0);
+    max_idx.head<2>() = max_idx.head<2>().cwiseMin(this->getNumCells().template cast<int>() - Eigen::Vector2i::Ones());
+
+    // the voxel centers of a column lie on a line along the z axis of the grid frame, see fromVoxelGrid
+    const Eigen::Vector3d z_axis_in_sensor = grid2sensor.linear().col(2);
+    const size_t box_size_x = max_idx.x() - min_idx.x() + 1;
+    const size_t num_columns = box_size_x * (max_idx.y() - min_idx.y() + 1);
+    std::vector<uint8_t> touched(num_columns, 0);
+    tools::parallelFor(0, num_columns, [&](size_t c)
+    {
+        const Index idx(min_idx.x() + c % box_size_x, min_idx.y() + c / box_size_x);
+        Eigen::Vector3d column_base = this->getLocalFrame().inverse() * Eigen::Vector3d((idx.x() + 0.5) * res.x(), (idx.y() + 0.5) * res.y(), 0.0);
+        column_base.z() = 0.0;
+        column_base = grid2sensor * column_base;
+        typename GridMapBase::CellType& tree = this->at(idx);
+        for(int32_t z_idx = min_idx.z(); z_idx <= max_idx.z(); ++z_idx)
+        {
+            const Eigen::Vector3d voxel = column_base + tree.getCellCenter(z_idx) * z_axis_in_sensor;
+            if(voxel.z() <= 0.0)
+                continue;
+
+            const long u = std::lround(intrinsics.fx * voxel.x() / voxel.z() + intrinsics.cx);
+            const long v = std::lround(intrinsics.fy * voxel.y() / voxel.z() + intrinsics.cy);
+            if(u < 0 || v < 0 || u >= (long)pc.width || v >= (long)pc.height)
+                continue;
+
+            const size_t pixel = v * pc.width + u;
+            if(!valid[pixel])
+                continue;
+
+            // signed distance along the viewing ray, positive in front of the surface
+            const float distance = (depths[pixel] - voxel.z()) * voxel.norm() / voxel.z();
+            if(distance > truncation || distance < -truncation)
+                continue;
+
+            tree.getCellAt(z_idx).update(distance, measurement_variance, truncation, min_variance);
+            touched[c] = 1;
         }
+    }, num_threads, 16);
+
+    if(this->isDirtyTrackingEnabled())
+    {
+        for(size_t c = 0; c < num_columns; ++c)
+        {
+            if(touched[c])
+                this->markDirty(Index(min_idx.x() + c % box_size_x, min_idx.y() + c / box_size_x));
+        }
+    }
+    return stats;
+}
+
+template<class CellT, class ColumnT>
+void BasicTSDFVolumetricMap<CellT, ColumnT>::mergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement, double measurement_variance)
+{
+    RayIntegrationContext context;
+    if(!context.reset(*this, base::Transform3d::Identity(), sensor_origin))
+        throw std::runtime_error((boost::format("Sensor origin %1% is outside of the grid! Can't add measurement to grid.") % sensor_origin.transpose()).str());
+
+    mergePoint(context, measurement, measurement_variance);
+}
+
+template<class CellT, class ColumnT>
+void BasicTSDFVolumetricMap<CellT, ColumnT>::mergePoint(RayIntegrationContext& context, const Eigen::Vector3d& measurement, double measurement_variance)
+{
+    const Eigen::Vector3d measurement_in_grid = context.pc2grid * measurement;
+    if(!((measurement_in_grid - context.sensor_origin).squaredNorm() > 0.0))
+        throw std::runtime_error((boost::format("Measurement %1% is equal to the sensor origin! Can't add measurement to grid.") % measurement_in_grid.transpose()).str());
+
+    const Eigen::Vector3d end_point = measurement_in_grid + truncation * (measurement_in_grid - context.sensor_origin).normalized();
+    Eigen::Vector3i end_point_idx;
+    if(!VoxelGridBase::toVoxelGrid(end_point, end_point_idx, false))
+        throw std::runtime_error((boost::format("End point %1% of the ray to measurement %2% can't be mapped to the grid! Can't add measurement to grid.")
+                                  % end_point.transpose() % measurement_in_grid.transpose()).str());
+
+    if(!tryMergePoint(context, measurement, measurement_variance))
+        throw std::runtime_error((boost::format("Ray from %1% to %2% is degenerated! Can't add measurement to grid.")
+                                  % context.sensor_origin.transpose() % measurement_in_grid.transpose()).str());
+}
+
+template<class CellT, class ColumnT>
+bool BasicTSDFVolumetricMap<CellT, ColumnT>::tryMergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement, double measurement_variance)
+{
+    RayIntegrationContext context;
+    if(!context.reset(*this, base::Transform3d::Identity(), sensor_origin))
+        return false;
+    return tryMergePoint(context, measurement, measurement_variance);
+}
+
+template<class CellT, class ColumnT>
+bool BasicTSDFVolumetricMap<CellT, ColumnT>::tryMergePoint(RayIntegrationContext& context, const Eigen::Vector3d& measurement, double measurement_variance)
+{
+    const Eigen::Vector3d measurement_in_grid = context.pc2grid * measurement;
+    if(!computeTruncatedRay(*this, truncation, context, measurement_in_grid))
+        return false;
+
+    Eigen::Vector3d measurement_normal = (measurement_in_grid - context.sensor_origin).normalized();
+    double ray_length = (measurement_in_grid - context.sensor_origin).norm();
+    for(const VoxelTraversal::RayElement& element : context.ray)
+    {
+        // rest of the ray is probably out of grid
+        if(!GridMapBase::inGrid(element.idx))
+            break;
+
+        GridMapBase::markDirty(element.idx);
+        updateSpan(element.idx, element.z_first, element.z_last, context.sensor_origin, measurement_normal, ray_length, measurement_variance);
     }
-    else
-        throw std::runtime_error((boost::format("Sensor origin %1% is outside of the grid! Can't add measurement to grid.") % start_point.transpose()).str());
+    return true;
 }
 
-bool TSDFVolumetricMap::hasSameFrame(const base::Transform3d& local_frame, const Vector2ui& num_cells, const Vector2d& resolution) const
+template<class CellT, class ColumnT>
+void BasicTSDFVolumetricMap<CellT, ColumnT>::updateSpan(const Index& idx, int32_t z_first, int32_t z_last, const Eigen::Vector3d& sensor_origin,
+                                               const Eigen::Vector3d& measurement_normal, double ray_length, double measurement_variance)
 {
-     if(getResolution() == resolution && getNumCells() == num_cells && getLocalFrame().isApprox(local_frame))
+    const float res_sigma = 2.f * VoxelGridBase::getVoxelResolution().squaredNorm() / (5.2f*5.2f);
+    const float res_sigma_inv = 1.f / res_sigma;
+
+    ColumnType& tree = GridMapBase::at(idx);
+    Eigen::Vector3d cell_center;
+    GridMapBase::fromGrid(idx, cell_center, false);
+    // the cells of the span are close to the ray, so phi is always positive and every cell gets updated
+    tree.updateRange(z_first, z_last, [&](int32_t z_idx, VoxelCellType& cell)
+    {
+        cell_center.z() = tree.getCellCenter(z_idx);
+
+        // compute point on ray closest to the current cell center
+        Eigen::Hyperplane<double, 3> plane(measurement_normal, cell_center);
+        Eigen::Vector3d point_on_ray = plane.projection(sensor_origin);
+
+        // weight the current measurement according to the distance to the cell center with the inverse normal distribution
+        float phi = std::exp(-(point_on_ray - cell_center).squaredNorm() * res_sigma_inv);
+        if(phi > 0.f)
+            cell.update(ray_length - (point_on_ray - sensor_origin).norm(), (1.f/phi) * measurement_variance, truncation, min_variance);
+    });
+}
+
+template<class CellT, class ColumnT>
+bool BasicTSDFVolumetricMap<CellT, ColumnT>::checkSensorOrigin(const Eigen::Vector3d& sensor_origin, size_t num_points, MergeStatistics& stats) const
+{
+    Eigen::Vector3i sensor_origin_idx;
+    if(VoxelGridBase::toVoxelGrid(sensor_origin, sensor_origin_idx))
+        return true;
+
+    LOG_ERROR_S << "Sensor origin (" << sensor_origin.transpose() << ") is outside of the grid! Can't add corresponding point cloud to grid.";
+    stats.outside_grid += num_points;
+    return false;
+}
+
+template<class CellT, class ColumnT>
+bool BasicTSDFVolumetricMap<CellT, ColumnT>::hasSameFrame(const base::Transform3d& local_frame, const Vector2ui& num_cells, const Vector2d& resolution) const
+{
+     if(this->getResolution() == resolution && this->getNumCells() == num_cells && this->getLocalFrame().isApprox(local_frame))
          return true;
      return false;
 }
 
-float TSDFVolumetricMap::getTruncation()
+template<class CellT, class ColumnT>
+float BasicTSDFVolumetricMap<CellT, ColumnT>::getTruncation()
 {
     return truncation;
 }
 
-void TSDFVolumetricMap::setTruncation(float truncation)
+template<class CellT, class ColumnT>
+void BasicTSDFVolumetricMap<CellT, ColumnT>::setTruncation(float truncation)
 {
     this->truncation = truncation;
 }
 
-float TSDFVolumetricMap::getMinVariance()
+template<class CellT, class ColumnT>
+float BasicTSDFVolumetricMap<CellT, ColumnT>::getMinVariance()
 {
     return min_variance;
 }
 
-void TSDFVolumetricMap::setMinVariance(float min_varaince)
+template<class CellT, class ColumnT>
+void BasicTSDFVolumetricMap<CellT, ColumnT>::setMinVariance(float min_varaince)
 {
     this->min_variance = min_varaince;
 }
+
+namespace maps { namespace grid
+{
+    template class BasicTSDFVolumetricMap<TSDFPatch>;
+    template class BasicTSDFVolumetricMap<PackedTSDFPatchFloat>;
+    template class BasicTSDFVolumetricMap<PackedTSDFPatchHalf>;
+    template class BasicTSDFVolumetricMap<PackedTSDFPatchFloat, DenseColumn<PackedTSDFPatchFloat> >;
+}}
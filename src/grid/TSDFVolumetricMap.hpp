@@ -27,8 +27,12 @@
 #pragma once
 
 #include "TSDFPatch.hpp"
+#include "PackedTSDFPatch.hpp"
 #include "VoxelGridMap.hpp"
 #include "MLSMap.hpp"
+#include "MergeStatistics.hpp"
+#include "RayIntegrationContext.hpp"
+#include <maps/tools/ParallelFor.hpp>
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
@@ -41,29 +45,98 @@
 namespace maps { namespace grid
 {
 
-class TSDFVolumetricMap : public VoxelGridMap<TSDFPatch>
+/**
+ * Pinhole model of the sensor of an organized point cloud, used by the projective integration.
+ * A point (x, y, z) in the sensor frame is seen at the pixel (fx * x / z + cx, fy * y / z + cy).
+ */
+struct PinholeIntrinsics
+{
+    PinholeIntrinsics(double fx = 1.0, double fy = 1.0, double cx = 0.0, double cy = 0.0) : fx(fx), fy(fy), cx(cx), cy(cy) {}
+
+    double fx;
+    double fy;
+    double cx;
+    double cy;
+
+    /**
+     * Estimates the intrinsics from the valid points of an organized cloud by a least squares fit
+     * of the pixel coordinates. The points are projected in the sensor frame given by sensor_origin_
+     * and sensor_orientation_ of the cloud. Throws std::runtime_error if the cloud is not organized or has too
+     * few valid points.
+     */
+    static PinholeIntrinsics fromOrganizedCloud(const pcl::PointCloud<pcl::PointXYZ>& pc);
+};
+
+/**
+ * TSDF voxel map. The voxel type \c CellT has to provide update, getDistance and getVariance
+ * like TSDFPatch, see TSDFVolumetricMap, PackedTSDFVolumetricMap and HalfTSDFVolumetricMap.
+ * \c ColumnT is the column type of the VoxelGridMap, see DenseTSDFVolumetricMap.
+ */
+template<class CellT, class ColumnT = DiscreteTree<CellT> >
+class BasicTSDFVolumetricMap : public VoxelGridMap<CellT, ColumnT>
 {
 public:
-    typedef boost::shared_ptr<TSDFVolumetricMap> Ptr;
-    typedef const boost::shared_ptr<TSDFVolumetricMap> ConstPtr;
-    typedef TSDFPatch VoxelCellType;
-    typedef GridMap< DiscreteTree<VoxelCellType> > GridMapBase;
-    typedef VoxelGridMap<VoxelCellType> VoxelGridBase;
+    typedef boost::shared_ptr<BasicTSDFVolumetricMap> Ptr;
+    typedef const boost::shared_ptr<BasicTSDFVolumetricMap> ConstPtr;
+    typedef CellT VoxelCellType;
+    typedef ColumnT ColumnType;
+    typedef GridMap< ColumnType > GridMapBase;
+    typedef VoxelGridMap<VoxelCellType, ColumnType> VoxelGridBase;
     typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
 
-    TSDFVolumetricMap(): VoxelGridMap<VoxelCellType>(Vector2ui::Zero(), Vector3d::Ones()),
+    BasicTSDFVolumetricMap(): VoxelGridBase(Vector2ui::Zero(), Vector3d::Ones()),
                          truncation(1.f), min_variance(0.001f) {}
 
-    TSDFVolumetricMap(const Vector2ui &num_cells, const Vector3d &resolution, float truncation = 1.f, float min_varaince = 0.001f) :
-                    VoxelGridMap<VoxelCellType>(num_cells, resolution), truncation(truncation), min_variance(min_varaince) {}
-    virtual ~TSDFVolumetricMap() {}
+    BasicTSDFVolumetricMap(const Vector2ui &num_cells, const Vector3d &resolution, float truncation = 1.f, float min_varaince = 0.001f) :
+                    VoxelGridBase(num_cells, resolution), truncation(truncation), min_variance(min_varaince) {}
+    virtual ~BasicTSDFVolumetricMap() {}
+
+    /**
+     * Adds the point cloud to the map.
+     * Rejected points are not reported individually but counted in the returned statistics.
+     */
+    MergeStatistics mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2grid, double measurement_variance = 0.01);
+    MergeStatistics mergePointCloud(const PointCloud& pc, const base::TransformWithCovariance& pc2grid, double measurement_variance = 0.01);
+
+    /**
+     * Same as above, the ray buffer of the caller owned \c context is reused for all points,
+     * see RayIntegrationContext.
+     */
+    MergeStatistics mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2grid, RayIntegrationContext& context, double measurement_variance = 0.01);
+
+    /**
+     * Projective (per pixel) integration of an organized point cloud. The pose of the sensor in the
+     * cloud is given by sensor_origin_ and sensor_orientation_ of the cloud, the z axis of the
+     * sensor is its optical axis.
+     * Instead of tracing a ray per point, all voxels in the bounding box of the measurements are
+     * projected into the image and updated with the signed distance along the viewing ray to the
+     * measurement of their pixel, if it is within the truncation band. Voxels behind the band or in
+     * front of it are not touched. The voxels are addressed like in toVoxelGrid and measurements
+     * outside of the grid are rejected. The columns of the grid are processed in parallel using up to
+     * \c num_threads threads (0 selects the number of hardware threads).
+     * Throws std::runtime_error if the cloud is not organized.
+     */
+    MergeStatistics mergePointCloudProjective(const PointCloud& pc, const base::Transform3d& pc2grid, const PinholeIntrinsics& intrinsics,
+                                              double measurement_variance = 0.01, unsigned num_threads = 0);
 
-    void mergePointCloud(const PointCloud& pc, const base::Transform3d& pc2grid, double measurement_variance = 0.01);
-    void mergePointCloud(const PointCloud& pc, const base::TransformWithCovariance& pc2grid, double measurement_variance = 0.01);
+    /**
+     * Same as above, the intrinsics are estimated from the cloud, see PinholeIntrinsics::fromOrganizedCloud.
+     */
+    MergeStatistics mergePointCloudProjective(const PointCloud& pc, const base::Transform3d& pc2grid,
+                                              double measurement_variance = 0.01, unsigned num_threads = 0);
+
+    /**
+     * Parallel variant of mergePointCloud, the result is the same.
+     * The rays are traced using up to \c num_threads threads (0 selects the number of hardware
+     * threads). The voxel updates are grouped by grid column and each column is updated by a
+     * single thread in the order of the point cloud, hence the result does not depend on the
+     * thread scheduling.
+     */
+    MergeStatistics mergePointCloudParallel(const PointCloud& pc, const base::Transform3d& pc2grid, double measurement_variance = 0.01, unsigned num_threads = 0);
 
     template<int _MatrixOptions>
-    void mergePointCloud(const std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >& pc, const base::TransformWithCovariance& pc2grid,
-                         const base::Vector3d& sensor_origin_in_pc = base::Vector3d::Zero(), double measurement_variance = 0.01);
+    MergeStatistics mergePointCloud(const std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >& pc, const base::TransformWithCovariance& pc2grid,
+                                    const base::Vector3d& sensor_origin_in_pc = base::Vector3d::Zero(), double measurement_variance = 0.01);
 
     template<enum MLSConfig::update_model SurfaceType>
     void projectMLSMap(const maps::grid::MLSMap<SurfaceType>& mls, const base::Transform3d& mls2grid,
@@ -71,8 +144,43 @@ public:
                        const Eigen::Vector2i& end_idx = Eigen::Vector2i(std::numeric_limits<int>::max(), std::numeric_limits<int>::max()),
                        float z_min = -50.f, float z_max = 50.f, float truncation = 1.f, float variance = 0.01f);
 
+    /**
+     * Parallel variant of projectMLSMap, the result is the same.
+     * The map is processed column by column using up to \c num_threads threads (0 selects the
+     * number of hardware threads). If the z axes of both maps are aligned, the MLS cell of a column
+     * is looked up once and only the z range within \c truncation of its patches is visited.
+     */
+    template<enum MLSConfig::update_model SurfaceType>
+    void projectMLSMapParallel(const maps::grid::MLSMap<SurfaceType>& mls, const base::Transform3d& mls2grid,
+                               const Eigen::Vector2i& start_idx = Eigen::Vector2i(0,0),
+                               const Eigen::Vector2i& end_idx = Eigen::Vector2i(std::numeric_limits<int>::max(), std::numeric_limits<int>::max()),
+                               float z_min = -50.f, float z_max = 50.f, float truncation = 1.f, float variance = 0.01f, unsigned num_threads = 0);
+
+    /**
+     * Merges a single measurement, throws std::runtime_error if it can't be added to the map.
+     * A RayIntegrationContext is set up per call, merge many points with the context overloads.
+     */
     void mergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement, double measurement_variance = 0.01);
 
+    /**
+     * Merges a measurement given in the frame of \c context, see RayIntegrationContext::reset.
+     * The ray buffer of the context is reused, throws std::runtime_error if the measurement can't be added.
+     */
+    void mergePoint(RayIntegrationContext& context, const Eigen::Vector3d& measurement, double measurement_variance = 0.01);
+
+    /**
+     * Non-throwing variant of mergePoint.
+     * Returns false if the sensor origin is outside of the grid or the ray is degenerated.
+     * A RayIntegrationContext is set up per call, merge many points with the context overloads.
+     */
+    bool tryMergePoint(const Eigen::Vector3d& sensor_origin, const Eigen::Vector3d& measurement, double measurement_variance = 0.01);
+
+    /**
+     * Merges a measurement given in the frame of \c context, see RayIntegrationContext::reset.
+     * Returns false if the ray is degenerated.
+     */
+    bool tryMergePoint(RayIntegrationContext& context, const Eigen::Vector3d& measurement, double measurement_variance = 0.01);
+
     bool hasSameFrame(const base::Transform3d& local_frame, const Vector2ui &num_cells, const Vector2d &resolution) const;
 
     void setTruncation(float truncation);
@@ -85,6 +193,13 @@ public:
 
 protected:
 
+    /** Returns false and counts all points as outside of the grid if the sensor origin is not inside the grid */
+    bool checkSensorOrigin(const Eigen::Vector3d& sensor_origin, size_t num_points, MergeStatistics& stats) const;
+
+    /** Updates the cells z_first to z_last of the column idx with the measurement of a single ray */
+    void updateSpan(const Index& idx, int32_t z_first, int32_t z_last, const Eigen::Vector3d& sensor_origin,
+                    const Eigen::Vector3d& measurement_normal, double ray_length, double measurement_variance);
+
     /** truncation level of the signed distance function */
     float truncation;
 
@@ -98,42 +213,46 @@ protected:
     template <typename Archive>
     void serialize(Archive &ar, const unsigned int version)
     {
-        ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(VoxelGridMap<VoxelCellType>);
+        ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(VoxelGridBase);
         ar & BOOST_SERIALIZATION_NVP(truncation);
         ar & BOOST_SERIALIZATION_NVP(min_variance);
     }
 };
 
+template<class CellT, class ColumnT>
 template<int _MatrixOptions>
-void TSDFVolumetricMap::mergePointCloud(const std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >& pc, const base::TransformWithCovariance& pc2grid,
-                                        const base::Vector3d& sensor_origin_in_pc, double measurement_variance)
+MergeStatistics BasicTSDFVolumetricMap<CellT, ColumnT>::mergePointCloud(const std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >& pc, const base::TransformWithCovariance& pc2grid,
+                                                   const base::Vector3d& sensor_origin_in_pc, double measurement_variance)
 {
+    MergeStatistics stats;
     Eigen::Vector3d sensor_origin_in_grid = pc2grid.getTransform() * sensor_origin_in_pc;
+    if(!checkSensorOrigin(sensor_origin_in_grid, pc.size(), stats))
+        return stats;
 
+    RayIntegrationContext context;
+    context.reset(*this, base::Transform3d::Identity(), sensor_origin_in_grid);
     for(typename std::vector< Eigen::Matrix<double, 3, 1, _MatrixOptions> >::const_iterator it = pc.begin(); it != pc.end(); ++it)
     {
         std::pair<Eigen::Vector3d, Eigen::Matrix3d> measurement_in_map = pc2grid.composePointWithCovariance(*it, Eigen::Matrix3d::Zero());
-        try
-        {
-            // TODO use variance in the direction of the measurement
-            mergePoint(sensor_origin_in_grid, measurement_in_map.first, measurement_variance + measurement_in_map.second(2,2));
-        }
-        catch(const std::runtime_error& e)
-        {
-            LOG_ERROR_S << e.what();
-        }
+        // TODO use variance in the direction of the measurement
+        if(tryMergePoint(context, measurement_in_map.first, measurement_variance + measurement_in_map.second(2,2)))
+            stats.merged++;
+        else
+            stats.invalid++;
     }
+    return stats;
 }
 
+template<class CellT, class ColumnT>
 template<enum MLSConfig::update_model SurfaceType>
-void TSDFVolumetricMap::projectMLSMap(const maps::grid::MLSMap<SurfaceType>& mls, const base::Transform3d& mls2grid,
+void BasicTSDFVolumetricMap<CellT, ColumnT>::projectMLSMap(const maps::grid::MLSMap<SurfaceType>& mls, const base::Transform3d& mls2grid,
                                       const Eigen::Vector2i& start_idx, const Eigen::Vector2i& end_idx,
                                       float z_min, float z_max, float truncation, float variance)
 {
     base::Transform3d grid2mls = mls2grid.inverse();
-    Eigen::Vector3d res = getVoxelResolution();
+    Eigen::Vector3d res = this->getVoxelResolution();
     Eigen::Vector3i max_idx;
-    max_idx << end_idx.array().min(getNumCells().array().cast<int>()), (int)std::floor(z_max / res.z());
+    max_idx << end_idx.array().min(this->getNumCells().array().template cast<int>()), (int)std::floor(z_max / res.z());
     Eigen::Vector3i min_idx;
     min_idx << start_idx, (int)std::floor(z_min / res.z());
     Eigen::Vector3i idx;
@@ -143,9 +262,10 @@ void TSDFVolumetricMap::projectMLSMap(const maps::grid::MLSMap<SurfaceType>& mls
     {
         for(idx.x() = min_idx.x(); idx.x() < max_idx.x(); idx.x() = idx.x() + 1)
         {
+            bool touched = false;
             for(idx.z() = min_idx.z(); idx.z() < max_idx.z(); idx.z() = idx.z() + 1)
             {
-                if(fromVoxelGrid(idx, cell_center))
+                if(this->fromVoxelGrid(idx, cell_center))
                 {
                     cell_center = grid2mls * cell_center;
                     if(mls.getClosestContactPoint(cell_center, closest_point))
@@ -154,14 +274,162 @@ void TSDFVolumetricMap::projectMLSMap(const maps::grid::MLSMap<SurfaceType>& mls
                         float distance = diff.norm();
                         if(distance < truncation)
                         {
-                            VoxelCellType& cell = getVoxelCell(idx);
+                            VoxelCellType& cell = this->getVoxelCell(idx);
                             cell.update(std::copysign(distance, diff.z()), variance, truncation, min_variance);
+                            touched = true;
                         }
                     }
                 }
             }
+            if(touched)
+                this->markDirty(Index(idx.x(), idx.y()));
+        }
+    }
+}
+
+template<class CellT, class ColumnT>
+template<enum MLSConfig::update_model SurfaceType>
+void BasicTSDFVolumetricMap<CellT, ColumnT>::projectMLSMapParallel(const maps::grid::MLSMap<SurfaceType>& mls, const base::Transform3d& mls2grid,
+                                                         const Eigen::Vector2i& start_idx, const Eigen::Vector2i& end_idx,
+                                                         float z_min, float z_max, float truncation, float variance, unsigned num_threads)
+{
+    typedef typename maps::grid::MLSMap<SurfaceType>::Patch Patch;
+
+    base::Transform3d grid2mls = mls2grid.inverse();
+    Eigen::Vector3d res = this->getVoxelResolution();
+    Eigen::Vector3i max_idx;
+    max_idx << end_idx.array().min(this->getNumCells().array().template cast<int>()), (int)std::floor(z_max / res.z());
+    Eigen::Vector3i min_idx;
+    min_idx << start_idx.cwiseMax(0), (int)std::floor(z_min / res.z());
+    if(max_idx.x() <= min_idx.x() || max_idx.y() <= min_idx.y() || max_idx.z() <= min_idx.z())
+        return;
+
+    // check whether the columns of this map are vertical lines in the MLS grid
+    const base::Transform3d grid2mls_grid = mls.getLocalFrame() * grid2mls;
+    const bool z_aligned = (grid2mls_grid.linear().col(2) - Eigen::Vector3d::UnitZ()).norm() < 1e-9;
+
+    const size_t size_x = max_idx.x() - min_idx.x();
+    const size_t num_columns = size_x * (max_idx.y() - min_idx.y());
+    std::vector<uint8_t> touched(num_columns, 0);
+    tools::parallelFor(0, num_columns, [&](size_t c)
+    {
+        Eigen::Vector3i idx(min_idx.x() + c % size_x, min_idx.y() + c / size_x, min_idx.z());
+        typename GridMapBase::CellType& tree = this->at(Index(idx.x(), idx.y()));
+        Eigen::Vector3d cell_center;
+        Eigen::Vector3d closest_point;
+
+        auto updateVoxel = [&](int32_t z_idx)
+        {
+            Eigen::Vector3d diff = (cell_center - closest_point);
+            float distance = diff.norm();
+            if(distance < truncation)
+            {
+                tree.getCellAt(z_idx).update(std::copysign(distance, diff.z()), variance, truncation, min_variance);
+                touched[c] = 1;
+            }
+        };
+
+        if(!z_aligned)
+        {
+            for(; idx.z() < max_idx.z(); idx.z() = idx.z() + 1)
+            {
+                this->fromVoxelGrid(idx, cell_center, false);
+                cell_center = grid2mls * cell_center;
+                if(mls.getClosestContactPoint(cell_center, closest_point))
+                    updateVoxel(idx.z());
+            }
+            return;
+        }
+
+        // look up the MLS cell once, the voxel centers of the column only differ in z
+        this->fromVoxelGrid(idx, cell_center, false);
+        cell_center.z() = 0.0;
+        Index mls_idx;
+        Eigen::Vector3d column_in_cell;
+        if(!mls.toGrid(grid2mls * cell_center, mls_idx, column_in_cell))
+            return;
+        const typename maps::grid::MLSMap<SurfaceType>::CellType& mls_cell = mls.at(mls_idx);
+        if(mls_cell.empty())
+            return;
+
+        auto voxelInCell = [&](int32_t z_idx) -> Vector3
+        {
+            Vector3 pos_in_cell = column_in_cell.cast<float>();
+            pos_in_cell.z() += tree.getCellCenter(z_idx);
+            return pos_in_cell;
+        };
+
+        // the contact points of a patch move monotonically with z, hence their z range is
+        // given by the contact points of the lowest and the highest voxel
+        float contact_min = std::numeric_limits<float>::max();
+        float contact_max = -std::numeric_limits<float>::max();
+        for(const Patch& patch : mls_cell)
+        {
+            for(int32_t z_idx : {min_idx.z(), max_idx.z() - 1})
+            {
+                Vector3 contact_point;
+                patch.getClosestContactPoint(voxelInCell(z_idx), contact_point);
+                contact_min = std::min(contact_min, contact_point.z());
+                contact_max = std::max(contact_max, contact_point.z());
+            }
+        }
+
+        // voxels further than truncation from all contact points are skipped
+        const int32_t z_first = std::max(min_idx.z(), tree.getCellIndex(contact_min - truncation - column_in_cell.z()));
+        const int32_t z_last = std::min(max_idx.z() - 1, tree.getCellIndex(contact_max + truncation - column_in_cell.z()));
+        for(int32_t z_idx = z_first; z_idx <= z_last; ++z_idx)
+        {
+            idx.z() = z_idx;
+            this->fromVoxelGrid(idx, cell_center, false);
+            cell_center = grid2mls * cell_center;
+
+            // same search as in MLSMap::getClosestContactPoint
+            const Vector3 pos_in_cell = voxelInCell(z_idx);
+            float min_dist = 0.f;
+            bool found_patch = false;
+            Eigen::Vector3d contact_point_in_cell;
+            for(const Patch& patch : mls_cell)
+            {
+                Vector3 contact_point;
+                float dist = std::abs(patch.getClosestContactPoint(pos_in_cell, contact_point));
+                if(found_patch && dist > min_dist)
+                    break;
+                found_patch = true;
+                min_dist = dist;
+                contact_point_in_cell = contact_point.template cast<double>();
+            }
+            if(!found_patch || base::isInfinity<float>(min_dist))
+                continue;
+            mls.fromGrid(mls_idx, closest_point, contact_point_in_cell, false);
+            updateVoxel(z_idx);
+        }
+    }, num_threads, 8);
+
+    if(this->isDirtyTrackingEnabled())
+    {
+        for(size_t c = 0; c < num_columns; ++c)
+        {
+            if(touched[c])
+                this->markDirty(Index(min_idx.x() + c % size_x, min_idx.y() + c / size_x));
         }
     }
 }
 
+/** TSDF map with float distance and variance per voxel */
+typedef BasicTSDFVolumetricMap<TSDFPatch> TSDFVolumetricMap;
+
+/** TSDF map with non-polymorphic float voxels, uses half of the memory of TSDFVolumetricMap */
+typedef BasicTSDFVolumetricMap<PackedTSDFPatchFloat> PackedTSDFVolumetricMap;
+
+/** TSDF map with half precision voxels, uses a third of the memory of TSDFVolumetricMap */
+typedef BasicTSDFVolumetricMap<PackedTSDFPatchHalf> HalfTSDFVolumetricMap;
+
+/** TSDF map with non-polymorphic float voxels in dense columns, see DenseColumn */
+typedef BasicTSDFVolumetricMap<PackedTSDFPatchFloat, DenseColumn<PackedTSDFPatchFloat> > DenseTSDFVolumetricMap;
+
+extern template class BasicTSDFVolumetricMap<TSDFPatch>;
+extern template class BasicTSDFVolumetricMap<PackedTSDFPatchFloat>;
+extern template class BasicTSDFVolumetricMap<PackedTSDFPatchHalf>;
+extern template class BasicTSDFVolumetricMap<PackedTSDFPatchFloat, DenseColumn<PackedTSDFPatchFloat> >;
+
 }}
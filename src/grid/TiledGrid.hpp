@@ -0,0 +1,448 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <vector>
+#include <stdexcept>
+#include <cstdlib>
+
+#include <boost/format.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/serialization/access.hpp>
+#include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost_serialization/ClassVersion.hpp>
+#include <boost_serialization/DynamicSizeSerialization.hpp>
+
+#include <maps/grid/Index.hpp>
+
+namespace maps { namespace grid
+{
+
+    /**
+     * Sparse grid storage, usable as GridT of a GridMap.
+     *
+     * The grid is split into tiles of TileSize x TileSize cells which are
+     * allocated on the first write access. Read access to a cell of a missing
+     * tile returns the shared default value. Iteration (begin/end) and
+     * serialization only cover the cells of allocated tiles, clear() releases
+     * all tiles.
+     */
+    template <typename CellT, unsigned int TileSize = 64>
+    class TiledGrid
+    {
+        static_assert(TileSize > 0, "TileSize must be greater than zero");
+
+        /** Cells of each tile, empty if the tile is not allocated **/
+        std::vector< std::vector<CellT> > tiles;
+
+        /** Number of cells in X-axis and Y-axis **/
+        Vector2ui num_cells;
+
+        /** Number of tiles in X-axis and Y-axis **/
+        Vector2ui num_tiles;
+
+        /** Default value **/
+        CellT default_value;
+
+        /** Iterates the cells of all allocated tiles */
+        template<class GridPtrT, class ValueT>
+        class AllocatedCellIterator : public boost::iterator_facade<AllocatedCellIterator<GridPtrT, ValueT>, ValueT,
+                                                                    boost::forward_traversal_tag>
+        {
+        public:
+            AllocatedCellIterator() : grid(nullptr), tile(0), cell(0) {}
+            AllocatedCellIterator(GridPtrT grid, size_t tile) : grid(grid), tile(tile), cell(0)
+            {
+                skipUnallocated();
+            }
+
+            /** allows conversion from iterator to const_iterator */
+            template<class OtherGridPtrT, class OtherValueT>
+            AllocatedCellIterator(const AllocatedCellIterator<OtherGridPtrT, OtherValueT>& other)
+                : grid(other.grid), tile(other.tile), cell(other.cell) {}
+
+        private:
+            friend class boost::iterator_core_access;
+            template<class, class> friend class AllocatedCellIterator;
+
+            ValueT& dereference() const
+            {
+                return grid->tiles[tile][cell];
+            }
+
+            template<class OtherGridPtrT, class OtherValueT>
+            bool equal(const AllocatedCellIterator<OtherGridPtrT, OtherValueT>& other) const
+            {
+                return tile == other.tile && cell == other.cell;
+            }
+
+            void increment()
+            {
+                if (++cell >= grid->tiles[tile].size())
+                {
+                    cell = 0;
+                    ++tile;
+                    skipUnallocated();
+                }
+            }
+
+            void skipUnallocated()
+            {
+                while (tile < grid->tiles.size() && grid->tiles[tile].empty())
+                    ++tile;
+            }
+
+            GridPtrT grid;
+            size_t tile;
+            size_t cell;
+        };
+
+    public:
+
+        typedef CellT CellType;
+        typedef AllocatedCellIterator<TiledGrid*, CellT> iterator;
+        typedef AllocatedCellIterator<const TiledGrid*, const CellT> const_iterator;
+
+        TiledGrid(Vector2ui size, CellT default_value)
+            : num_cells(0, 0),
+              num_tiles(0, 0),
+              default_value(default_value)
+        {
+            resize(size);
+        }
+
+        TiledGrid(Vector2ui size)
+            : TiledGrid(size, CellT())
+        {
+        }
+
+        TiledGrid()
+            : TiledGrid(Vector2ui(0,0), CellT())
+        {
+        }
+
+        TiledGrid(const TiledGrid &other)
+            : tiles(other.tiles),
+              num_cells(other.num_cells),
+              num_tiles(other.num_tiles),
+              default_value(other.default_value)
+        {
+        }
+
+        template<class CellT2>
+        TiledGrid(const TiledGrid<CellT2, TileSize>& other)
+            : num_cells(0, 0)
+            , num_tiles(0, 0)
+            , default_value(other.getDefaultValue())
+        {
+            resize(other.getNumCells());
+            other.forEachAllocatedTile([this](size_t tile, const std::vector<CellT2>& cells)
+            {
+                tiles[tile].assign(cells.begin(), cells.end());
+            });
+        }
+
+        const CellT &getDefaultValue() const
+        {
+            return default_value;
+        }
+
+        /** Iterator over the cells of the allocated tiles */
+        iterator begin()
+        {
+            return iterator(this, 0);
+        }
+
+        iterator end()
+        {
+            return iterator(this, tiles.size());
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator(this, 0);
+        }
+
+        const_iterator end() const
+        {
+            return const_iterator(this, tiles.size());
+        }
+
+        /**
+         * Resizes the grid. The non-default cells inside the new extents are kept.
+         */
+        void resize(const Vector2ui &new_number_cells)
+        {
+            if (new_number_cells == num_cells)
+                return;
+
+            std::vector< std::vector<CellT> > old_tiles;
+            old_tiles.swap(tiles);
+            const Vector2ui old_num_cells = num_cells;
+            const Vector2ui old_num_tiles = num_tiles;
+
+            num_cells = new_number_cells;
+            num_tiles = Vector2ui((num_cells.x() + TileSize - 1) / TileSize,
+                                  (num_cells.y() + TileSize - 1) / TileSize);
+            tiles.resize(num_tiles.prod());
+
+            copyCells(old_tiles, old_num_cells, old_num_tiles, Index(0, 0));
+        }
+
+        /**
+         * @brief Move the content of the grid cells
+         * @details by the offset described in the argument.
+         * Only the cells of allocated tiles are copied.
+         * @return void
+         */
+        void moveBy(const Index &idx)
+        {
+            // if all grid values should be moved outside
+            if (std::abs(idx.x()) >= int(num_cells.x())
+                || std::abs(idx.y()) >= int(num_cells.y()))
+            {
+                clear();
+                return;
+            }
+
+            std::vector< std::vector<CellT> > old_tiles(num_tiles.prod());
+            old_tiles.swap(tiles);
+            copyCells(old_tiles, num_cells, num_tiles, idx);
+        }
+
+        const CellT& at(const Index &idx) const
+        {
+            return this->at(idx.x(), idx.y());
+        }
+
+        CellT& at(const Index &idx)
+        {
+            return this->at(idx.x(), idx.y());
+        }
+
+        /** Returns the default value if the tile of the cell is not allocated */
+        const CellT& at(size_t x, size_t y) const
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            const std::vector<CellT>& tile = tiles[toTileIdx(x, y)];
+            if (tile.empty())
+                return default_value;
+            return tile[toCellIdx(x, y)];
+        }
+
+        /** Allocates the tile of the cell if necessary */
+        CellT& at(size_t x, size_t y)
+        {
+            if(x >= num_cells.x() || y >= num_cells.y())
+                throw std::runtime_error("Provided index is out of the grid");
+            const size_t tile_idx = toTileIdx(x, y);
+            std::vector<CellT>& tile = tiles[tile_idx];
+            if (tile.empty())
+                tile.resize(getTileCells(tile_idx).prod(), default_value);
+            return tile[toCellIdx(x, y)];
+        }
+
+        const Vector2ui &getNumCells() const
+        {
+            return num_cells;
+        };
+
+        const Vector2ui &getNumTiles() const
+        {
+            return num_tiles;
+        }
+
+        size_t getNumAllocatedTiles() const
+        {
+            size_t count = 0;
+            for (const std::vector<CellT>& tile : tiles)
+            {
+                if (!tile.empty())
+                    count++;
+            }
+            return count;
+        }
+
+        /** Releases all tiles */
+        void clear()
+        {
+            for (std::vector<CellT>& tile : tiles)
+                std::vector<CellT>().swap(tile);
+        };
+
+        /**
+         * Calls f(tile_idx, cells) for every allocated tile.
+         * The cells are stored row-major with getTileCells(tile_idx).x() cells per row.
+         */
+        template<class Function>
+        void forEachAllocatedTile(Function f) const
+        {
+            for (size_t i = 0; i < tiles.size(); ++i)
+            {
+                if (!tiles[i].empty())
+                    f(i, tiles[i]);
+            }
+        }
+
+        /**
+         * Calls f(idx, cell) for every cell of the allocated tiles.
+         * Cells of missing tiles are skipped.
+         */
+        template<class Function>
+        void forEachAllocatedCell(Function f) const
+        {
+            forEachAllocatedTile([this, &f](size_t tile_idx, const std::vector<CellT>& tile)
+            {
+                const Index start = getTileStart(tile_idx);
+                const Vector2ui size = getTileCells(tile_idx);
+                size_t i = 0;
+                for (unsigned int y = 0; y < size.y(); ++y)
+                {
+                    for (unsigned int x = 0; x < size.x(); ++x, ++i)
+                        f(Index(start.x() + x, start.y() + y), tile[i]);
+                }
+            });
+        }
+
+        /** Index of the first cell of a tile */
+        Index getTileStart(size_t tile_idx) const
+        {
+            return Index((tile_idx % num_tiles.x()) * TileSize, (tile_idx / num_tiles.x()) * TileSize);
+        }
+
+        /** Number of cells of a tile, smaller than TileSize at the upper grid borders */
+        Vector2ui getTileCells(size_t tile_idx) const
+        {
+            const Index start = getTileStart(tile_idx);
+            return Vector2ui(std::min(TileSize, unsigned(num_cells.x() - start.x())),
+                             std::min(TileSize, unsigned(num_cells.y() - start.y())));
+        }
+
+    protected:
+        size_t toTileIdx(size_t x, size_t y) const
+        {
+            return x / TileSize + (y / TileSize) * num_tiles.x();
+        }
+
+        size_t toCellIdx(size_t x, size_t y) const
+        {
+            const size_t tile_x = x / TileSize;
+            const size_t tile_width = std::min<size_t>(TileSize, num_cells.x() - tile_x * TileSize);
+            return (x - tile_x * TileSize) + (y % TileSize) * tile_width;
+        }
+
+        /** Writes all non-default cells of the given tiles shifted by offset into this grid */
+        void copyCells(std::vector< std::vector<CellT> >& src_tiles, const Vector2ui& src_num_cells,
+                       const Vector2ui& src_num_tiles, const Index& offset)
+        {
+            for (size_t t = 0; t < src_tiles.size(); ++t)
+            {
+                std::vector<CellT>& tile = src_tiles[t];
+                if (tile.empty())
+                    continue;
+
+                const Index start((t % src_num_tiles.x()) * TileSize, (t / src_num_tiles.x()) * TileSize);
+                const unsigned int width = std::min(TileSize, unsigned(src_num_cells.x() - start.x()));
+                for (size_t i = 0; i < tile.size(); ++i)
+                {
+                    if (tile[i] == default_value)
+                        continue;
+                    const Index idx = start + Index(i % width, i / width) + offset;
+                    if (idx.isInside(num_cells))
+                        std::swap(at(idx.x(), idx.y()), tile[i]);
+                }
+                std::vector<CellT>().swap(tile);
+            }
+        }
+
+        /** Grants access to boost serialization */
+        friend class boost::serialization::access;
+
+        BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+        /** serialize members, only allocated tiles are written */
+        template<class Archive>
+        void save(Archive & ar, const unsigned int version) const
+        {
+            ar << BOOST_SERIALIZATION_NVP(num_cells.derived());
+            ar << BOOST_SERIALIZATION_NVP(default_value);
+            uint64_t tile_size = TileSize;
+            saveSizeValue(ar, tile_size);
+            saveSizeValue(ar, getNumAllocatedTiles());
+
+            forEachAllocatedTile([&ar](size_t tile_idx, const std::vector<CellT>& tile)
+            {
+                saveSizeValue(ar, tile_idx);
+                for (const CellT& cell : tile)
+                    ar << cell;
+            });
+        }
+
+        /** deserialize members */
+        template<class Archive>
+        void load(Archive & ar, const unsigned int version)
+        {
+            Vector2ui new_num_cells;
+            ar >> BOOST_SERIALIZATION_NVP(new_num_cells.derived());
+            ar >> BOOST_SERIALIZATION_NVP(default_value);
+            uint64_t tile_size, allocated_tiles;
+            loadSizeValue(ar, tile_size);
+            loadSizeValue(ar, allocated_tiles);
+            if (tile_size != TileSize)
+                throw std::runtime_error(boost::str(boost::format("TiledGrid: archive has tile size %1%, expected %2%") % tile_size % TileSize));
+
+            tiles.clear();
+            num_cells = Vector2ui(0, 0);
+            resize(new_num_cells);
+
+            for (uint64_t i = 0; i < allocated_tiles; ++i)
+            {
+                uint64_t tile_idx;
+                loadSizeValue(ar, tile_idx);
+                if (tile_idx >= tiles.size())
+                    throw std::runtime_error("TiledGrid: tile index in archive is out of the grid");
+                std::vector<CellT>& tile = tiles[tile_idx];
+                tile.resize(getTileCells(tile_idx).prod(), default_value);
+                for (CellT& cell : tile)
+                    ar >> cell;
+            }
+        }
+    };
+}}
+
+namespace boost { namespace serialization {
+    template<class CellT, unsigned int TileSize>
+    struct version< maps::grid::TiledGrid<CellT, TileSize> >
+    {
+        typedef mpl::int_<1> type;
+        typedef mpl::integral_c_tag tag;
+        BOOST_STATIC_CONSTANT(int, value = version::type::value);
+    };
+}}
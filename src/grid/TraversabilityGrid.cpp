@@ -60,6 +60,7 @@ void TraversabilityGrid::setTraversability(uint8_t traversabilityClassId, size_t
 {
     TraversabilityCell& cell = this->GridMap::at(x, y);
     cell.setTraversabilityClassId(traversabilityClassId);
+    markDirty(Index(x, y));
 }
 
 const TraversabilityClass& TraversabilityGrid::getTraversability(size_t x, size_t y) const
@@ -84,6 +85,7 @@ bool TraversabilityGrid::setProbability(float probability, size_t x, size_t y)
     TraversabilityCell& cell = this->GridMap::at(x, y);
     uint8_t ui8probability = probability * std::numeric_limits<uint8_t>::max();
     cell.setProbability(ui8probability);
+    markDirty(Index(x, y));
     return true;
 }
 
@@ -121,3 +123,17 @@ const std::vector< TraversabilityClass >& TraversabilityGrid::getTraversabilityC
 {
     return traversabilityClasses;
 }
+
+TraversabilityGrid::Delta TraversabilityGrid::createDelta()
+{
+    Delta delta;
+    delta.grid = GridMap::createDelta();
+    delta.traversabilityClasses = traversabilityClasses;
+    return delta;
+}
+
+void TraversabilityGrid::applyDelta(const TraversabilityGrid::Delta& delta)
+{
+    GridMap::applyDelta(delta.grid);
+    traversabilityClasses = delta.traversabilityClasses;
+}
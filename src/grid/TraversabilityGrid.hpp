@@ -35,6 +35,7 @@
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/nvp.hpp>
 #include <boost/serialization/export.hpp>
+#include <boost/serialization/vector.hpp>
 
 namespace maps { namespace grid
 {
@@ -58,6 +59,20 @@ namespace maps { namespace grid
                 CUSTOM_CLASSES = 2
         };
 
+        /** Changed cells together with the traversability classes they refer to */
+        struct Delta
+        {
+            GridDelta<TraversabilityCell> grid;
+            std::vector<TraversabilityClass> traversabilityClasses;
+
+            template <typename Archive>
+            void serialize(Archive &ar, const unsigned int version)
+            {
+                ar & BOOST_SERIALIZATION_NVP(grid);
+                ar & BOOST_SERIALIZATION_NVP(traversabilityClasses);
+            }
+        };
+
     private:
         std::vector<TraversabilityClass> traversabilityClasses;
 
@@ -96,6 +111,12 @@ namespace maps { namespace grid
         const TraversabilityClass &getTraversabilityClass(uint8_t traversabilityClassId) const;
         const std::vector<TraversabilityClass> &getTraversabilityClasses() const;
 
+        // Creates a delta of the cells changed since the last delta, see GridMap::createDelta().
+        Delta createDelta();
+
+        // Applies a delta created by createDelta() on another map, see GridMap::applyDelta().
+        void applyDelta(const Delta& delta);
+
     protected:
 
         /** Grants access to boost serialization */
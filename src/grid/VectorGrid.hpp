@@ -27,15 +27,24 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <sstream>
 #include <stdexcept>
+#include <type_traits>
 
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
 #include <boost/serialization/access.hpp>
+#include <boost/serialization/binary_object.hpp>
 #include <boost/serialization/nvp.hpp>
+#include <boost/serialization/split_member.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost_serialization/ClassVersion.hpp>
 #include <boost_serialization/DynamicSizeSerialization.hpp>
 
 #include <maps/grid/Index.hpp>
+#include <maps/grid/ChunkedArchive.hpp>
+#include <maps/tools/ParallelFor.hpp>
 
 namespace maps { namespace grid
 {
@@ -52,6 +61,9 @@ namespace maps { namespace grid
         /** Default value **/
         CellT default_value;
 
+        /** Archive mode used when saving the grid **/
+        ChunkedArchiveConfig archive_config;
+
     public:
 
         typedef CellT CellType;
@@ -78,7 +90,8 @@ namespace maps { namespace grid
         VectorGrid(const VectorGrid &other) 
             : cells(other.cells), 
               num_cells(other.num_cells), 
-              default_value(other.default_value)
+              default_value(other.default_value),
+              archive_config(other.archive_config)
         {
         }
 
@@ -95,6 +108,20 @@ namespace maps { namespace grid
             return default_value;
         }
 
+        /**
+         * Selects the chunked archive mode for saving and the number of
+         * threads for saving and loading, see ChunkedArchiveConfig.
+         */
+        void setChunkedArchiveConfig(const ChunkedArchiveConfig& config)
+        {
+            archive_config = config;
+        }
+
+        const ChunkedArchiveConfig& getChunkedArchiveConfig() const
+        {
+            return archive_config;
+        }
+
         iterator begin()
         {
             return cells.begin();
@@ -196,6 +223,21 @@ namespace maps { namespace grid
                 e = default_value;
             }
         };      
+
+        /**
+         * Calls f(idx, cell) for every cell backed by storage, i.e. all cells
+         * of this grid. See TiledGrid for a storage which skips empty space.
+         */
+        template<class Function>
+        void forEachAllocatedCell(Function f) const
+        {
+            size_t i = 0;
+            for (unsigned int y = 0; y < num_cells.y(); ++y)
+            {
+                for (unsigned int x = 0; x < num_cells.x(); ++x, ++i)
+                    f(Index(x, y), cells[i]);
+            }
+        }
         
     protected:
         size_t toIdx(size_t x, size_t y) const
@@ -236,14 +278,60 @@ namespace maps { namespace grid
             ar << BOOST_SERIALIZATION_NVP(num_cells.derived());
             ar << BOOST_SERIALIZATION_NVP(default_value);
 
-            const_iterator block_start_cell = cells.begin();
+            bool chunked = archive_config.enabled;
+            ar << BOOST_SERIALIZATION_NVP(chunked);
+            if (chunked)
+                saveChunks(ar);
+            else
+                saveCells(ar, cells.begin(), cells.end());
+        }
+
+        /** deserialize members */
+        template<class Archive>
+        void load(Archive & ar, const unsigned int version)
+        {
+            ar >> BOOST_SERIALIZATION_NVP(num_cells.derived());
+            ar >> BOOST_SERIALIZATION_NVP(default_value);
+            cells.clear();
+            cells.resize(num_cells.x() * num_cells.y(), default_value);
+
+            if (version == 0)
+            {
+                // deserialization of version 0 of VectorGrid
+                u_int32_t first_idx;
+                u_int32_t last_idx;
+                ar >> first_idx;
+                ar >> last_idx;
+                while(first_idx != last_idx)
+                {
+                    ar >> cells[first_idx];
+                    first_idx++;
+                }
+                return;
+            }
+
+            bool chunked = false;
+            if (version >= 2)
+                ar >> BOOST_SERIALIZATION_NVP(chunked);
+            if (chunked)
+                loadChunks(ar);
+            else
+                loadCells(ar, cells.begin(), cells.end());
+        }
+
+    private:
+        /** Writes the cells of a range as blocks of occupied and non-occupied cells */
+        template<class Archive>
+        void saveCells(Archive & ar, const_iterator begin, const_iterator end) const
+        {
+            const_iterator block_start_cell = begin;
             const_iterator block_end_cell;
             uint64_t block_size;
             bool block_occupied;
-            while (block_start_cell != cells.end())
+            while (block_start_cell != end)
             {
                 // identify the next block of occupied or non-occupied cells
-                nextBlock(block_start_cell, block_size, block_occupied, block_end_cell);
+                nextBlock(block_start_cell, end, block_size, block_occupied, block_end_cell);
 
                 // save bock header
                 ar << block_occupied;
@@ -262,76 +350,170 @@ namespace maps { namespace grid
             }
         }
 
-        /** deserialize members */
+        /** Reads the cells of a range written by saveCells */
         template<class Archive>
-        void load(Archive & ar, const unsigned int version)
+        void loadCells(Archive & ar, iterator begin, iterator end)
         {
-            ar >> BOOST_SERIALIZATION_NVP(num_cells.derived());
-            ar >> BOOST_SERIALIZATION_NVP(default_value);
-            cells.clear();
-            cells.resize(num_cells.x() * num_cells.y(), default_value);
-
-            if (version == 0)
+            bool block_occupied;
+            uint64_t block_size;
+            while (begin != end)
             {
-                // deserialization of version 0 of VectorGrid
-                u_int32_t first_idx;
-                u_int32_t last_idx;
-                ar >> first_idx;
-                ar >> last_idx;
-                while(first_idx != last_idx)
+                // receive block header
+                ar >> block_occupied;
+                loadSizeValue(ar, block_size);
+                if (block_size > uint64_t(std::distance(begin, end)))
+                    throw std::runtime_error("VectorGrid: invalid block size in archive");
+                iterator block_end = begin + block_size;
+
+                // skip, if cells of this block are not occupied
+                if (!block_occupied)
+                    begin = block_end;
+
+                // read cells
+                while (begin != block_end)
                 {
-                    ar >> cells[first_idx];
-                    first_idx++;
+                    ar >> *begin;
+                    begin++;
                 }
             }
-            else
+        }
+
+        /**
+         * Upper bound of the encoded size of \c num_cells cells in a chunk. Every cell may
+         * start a block with a bool and a size value. The size of arithmetic cells is known,
+         * for other cells an average of at most MAX_AVERAGE_CELL_SIZE bytes is accepted.
+         */
+        static uint64_t getMaxRawChunkSize(size_t num_cells)
+        {
+            const uint64_t block_header = sizeof(bool) + 2 * sizeof(uint64_t);
+            const uint64_t cell_size = std::is_arithmetic<CellT>::value ? sizeof(CellT) : MAX_AVERAGE_CELL_SIZE;
+            return uint64_t(num_cells) * (block_header + cell_size);
+        }
+
+        /** Checks the stored size of a chunk against its raw size */
+        static bool isValidStoredSize(uint64_t stored_size, uint64_t raw_size, ChunkCompression compression)
+        {
+            switch (compression)
             {
-                // return of cells are empty
-                if (cells.empty())
-                    return;
-
-                bool block_occupied;
-                uint64_t block_size;
-                size_t current_cell = 0;
-                size_t block_end;
-                while (current_cell < cells.size())
-                {
-                    // receive block header
-                    ar >> block_occupied;
-                    loadSizeValue(ar, block_size);
-                    block_end = current_cell + block_size;
+            case CHUNK_COMPRESSION_NONE:
+                return stored_size == raw_size;
+            case CHUNK_COMPRESSION_ZLIB:
+                // zlib grows incompressible data only slightly and compresses at most by 1032:1
+                return stored_size <= raw_size + raw_size / 1000 + 64 && raw_size <= stored_size * 1032 + 64;
+            }
+            return false;
+        }
 
-                    // skip, if cells of this block are not occupied
-                    if (!block_occupied)
-                        current_cell = block_end;
+        /** Number of chunks and cells per chunk of the chunked mode */
+        std::pair<uint64_t, size_t> getChunking(unsigned rows_per_chunk) const
+        {
+            rows_per_chunk = std::max(rows_per_chunk, 1u);
+            return std::make_pair((num_cells.y() + rows_per_chunk - 1) / rows_per_chunk,
+                                  size_t(rows_per_chunk) * num_cells.x());
+        }
 
-                    // read cells
-                    while (current_cell < block_end)
-                    {
-                        ar >> cells[current_cell];
-                        current_cell++;
-                    }
+        /** Encodes bands of rows in parallel, each into its own binary archive */
+        template<class Archive>
+        void saveChunks(Archive & ar) const
+        {
+            uint32_t compression = archive_config.compression;
+            uint32_t rows_per_chunk = std::max(archive_config.rows_per_chunk, 1u);
+            const std::pair<uint64_t, size_t> chunking = getChunking(rows_per_chunk);
+            uint64_t num_chunks = chunking.first;
+
+            std::vector<std::string> chunks(num_chunks);
+            std::vector<uint64_t> raw_sizes(num_chunks);
+            auto encode = [&](size_t c)
+            {
+                const_iterator begin = cells.begin() + std::min(c * chunking.second, cells.size());
+                const_iterator end = cells.begin() + std::min((c + 1) * chunking.second, cells.size());
+                std::ostringstream stream;
+                {
+                    boost::archive::binary_oarchive chunk_archive(stream, boost::archive::no_header);
+                    saveCells(chunk_archive, begin, end);
                 }
+                const std::string raw = stream.str();
+                raw_sizes[c] = raw.size();
+                chunks[c] = compressChunk(raw, archive_config.compression);
+            };
+            // the first chunk is encoded alone, which initializes the serialization singletons
+            if (num_chunks > 0)
+                encode(0);
+            tools::parallelFor(1, num_chunks, encode, archive_config.num_threads, 1);
+
+            ar << BOOST_SERIALIZATION_NVP(compression);
+            ar << BOOST_SERIALIZATION_NVP(rows_per_chunk);
+            ar << BOOST_SERIALIZATION_NVP(num_chunks);
+            for (size_t c = 0; c < num_chunks; ++c)
+            {
+                uint64_t raw_size = raw_sizes[c];
+                uint64_t stored_size = chunks[c].size();
+                ar << BOOST_SERIALIZATION_NVP(raw_size);
+                ar << BOOST_SERIALIZATION_NVP(stored_size);
+                ar << boost::serialization::make_nvp("chunk", boost::serialization::make_binary_object(&chunks[c][0], stored_size));
             }
         }
 
-    private:
+        /** Reads all chunks and decodes them in parallel */
+        template<class Archive>
+        void loadChunks(Archive & ar)
+        {
+            uint32_t compression;
+            uint32_t rows_per_chunk;
+            uint64_t num_chunks;
+            ar >> BOOST_SERIALIZATION_NVP(compression);
+            ar >> BOOST_SERIALIZATION_NVP(rows_per_chunk);
+            ar >> BOOST_SERIALIZATION_NVP(num_chunks);
+            const std::pair<uint64_t, size_t> chunking = getChunking(rows_per_chunk);
+            if (num_chunks != chunking.first)
+                throw std::runtime_error("VectorGrid: invalid number of chunks in archive");
+
+            std::vector<std::string> chunks(num_chunks);
+            std::vector<uint64_t> raw_sizes(num_chunks);
+            for (size_t c = 0; c < num_chunks; ++c)
+            {
+                uint64_t stored_size;
+                ar >> boost::serialization::make_nvp("raw_size", raw_sizes[c]);
+                ar >> BOOST_SERIALIZATION_NVP(stored_size);
+
+                // bound the sizes by the cells of the chunk before allocating or inflating
+                const size_t chunk_cells = std::min((c + 1) * chunking.second, cells.size()) - std::min(c * chunking.second, cells.size());
+                if (raw_sizes[c] > getMaxRawChunkSize(chunk_cells)
+                    || !isValidStoredSize(stored_size, raw_sizes[c], ChunkCompression(compression)))
+                    throw std::runtime_error("VectorGrid: invalid chunk size in archive");
+                chunks[c].resize(stored_size);
+                ar >> boost::serialization::make_nvp("chunk", boost::serialization::make_binary_object(&chunks[c][0], stored_size));
+            }
+
+            auto decode = [&](size_t c)
+            {
+                iterator begin = cells.begin() + std::min(c * chunking.second, cells.size());
+                iterator end = cells.begin() + std::min((c + 1) * chunking.second, cells.size());
+                std::istringstream stream(decompressChunk(chunks[c], raw_sizes[c], ChunkCompression(compression)));
+                boost::archive::binary_iarchive chunk_archive(stream, boost::archive::no_header);
+                loadCells(chunk_archive, begin, end);
+            };
+            // the first chunk is decoded alone, which initializes the serialization singletons
+            if (num_chunks > 0)
+                decode(0);
+            tools::parallelFor(1, num_chunks, decode, archive_config.num_threads, 1);
+        }
 
         /**
          * Identifies the next occupied or non-occupied block from a given start cell.
          * If the start cell is equal to the default cell value the block is considered
          * non-occupied and vice versa.
          */
-        void nextBlock(const_iterator start_cell, uint64_t &block_size, bool &block_occupied, const_iterator &end_cell) const
+        void nextBlock(const_iterator start_cell, const_iterator end, uint64_t &block_size, bool &block_occupied, const_iterator &end_cell) const
         {
             // check if the start cell is occupied
             block_occupied = *start_cell != default_value;
             // find next either occupied or non-occupied cell
             if (block_occupied)
-                end_cell = std::find_if_not(start_cell+1, cells.end(),
+                end_cell = std::find_if_not(start_cell+1, end,
                                                      std::bind1st(std::not_equal_to<CellT>(), default_value));
             else
-                end_cell = std::find_if_not(start_cell+1, cells.end(),
+                end_cell = std::find_if_not(start_cell+1, end,
                                                      std::bind1st(std::equal_to<CellT>(), default_value));
             // compute block size
             block_size = std::distance(start_cell, end_cell);
@@ -339,4 +521,4 @@ namespace maps { namespace grid
     };
 }}
 
-BOOST_TEMPLATED_CLASS_VERSION(maps::grid::VectorGrid, 1)
+BOOST_TEMPLATED_CLASS_VERSION(maps::grid::VectorGrid, 2)
@@ -28,26 +28,35 @@
 
 #include "GridMap.hpp"
 #include "DiscreteTree.hpp"
+#include "DenseColumn.hpp"
 
 namespace maps { namespace grid
 {
 
-template<class CellT>
-class VoxelGridMap : public GridMap< DiscreteTree<CellT> >
+/**
+ * Grid of voxel columns. The column type \c ColumnT defaults to DiscreteTree, which stores
+ * sparse columns. DenseColumn can be used instead for columns which are filled in
+ * contiguous ranges. \c GridT is the storage of the columns, e.g. TiledGrid for
+ * maps which are mostly empty.
+ */
+template<class CellT, class ColumnT = DiscreteTree<CellT>, class GridT = VectorGrid<ColumnT> >
+class VoxelGridMap : public GridMap< ColumnT, GridT >
 {
-    typedef GridMap< DiscreteTree<CellT> > _Base;
+    typedef GridMap< ColumnT, GridT > _Base;
 public:
+    typedef ColumnT ColumnType;
+
     VoxelGridMap(const Vector2ui &num_cells,
                 const Eigen::Vector3d &resolution) :
-                GridMap< DiscreteTree<CellT> >(num_cells,
-                resolution.head<2>(), DiscreteTree<CellT>(resolution.z())) {}
+                _Base(num_cells,
+                resolution.head<2>(), ColumnT(resolution.z())) {}
 
     bool hasVoxelCell(const Eigen::Vector3d &position) const
     {
         Index idx;
         if(_Base::toGrid(position, idx))
         {
-            return _Base::at(idx).hasCell(position.z());
+            return _Base::at(idx).hasCell((float)position.z());
         }
         return false;
     }
@@ -118,7 +127,7 @@ protected:
     template <typename Archive>
     void serialize(Archive &ar, const unsigned int version)
     {
-        ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(GridMap< DiscreteTree<CellT> >);
+        ar & BOOST_SERIALIZATION_BASE_OBJECT_NVP(_Base);
     }
 
 };
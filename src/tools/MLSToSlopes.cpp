@@ -25,8 +25,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 #include "MLSToSlopes.hpp"
-#include <boost/multi_array.hpp>
-#include <numeric/PlaneFitting.hpp>
+#include "ParallelFor.hpp"
 #include <maps/grid/Index.hpp>
 
 using namespace maps;
@@ -35,77 +34,110 @@ using namespace Eigen;
 
 static double const UNKNOWN = -std::numeric_limits<double>::infinity();
 
-static void updateDiffs(grid::MLSMapKalman const& mlsIn,
-        bool useStdDev,
-        boost::multi_array<float,3>& diffs,
-        boost::multi_array<int, 2>& count,
-        int this_index, size_t this_x, size_t this_y,
-        int other_index, size_t other_x, size_t other_y,
-        grid::MLSMapKalman::CellType::const_iterator this_patch)
+/** Size of the tiles of output cells processed by one task */
+static const size_t SLOPES_TILE_SIZE = 64;
+
+namespace
 {
-    const grid::MLSMapKalman::CellType& neighbour_cell = mlsIn.at(grid::Index(other_x, other_y));
-    grid::MLSMapKalman::CellType::const_iterator neighbour_patch =
-        std::max_element(neighbour_cell.begin(), neighbour_cell.end());
-    
-    if (neighbour_patch != neighbour_cell.end())
+    /**
+     * Summed area tables of the moments of the topmost surface heights
+     * needed by the plane fit. Coordinates are local to the tile, heights
+     * are relative to a reference height of the tile to keep the sums small.
+     */
+    struct MomentTables
+    {
+        enum Moment { N, I, J, II, JJ, IJ, H, IH, JH, NUM_MOMENTS };
+
+        size_t stride;
+        std::vector<double> tables[NUM_MOMENTS];
+
+        void build(const grid::MLSTopPatchView& top, size_t x0, size_t y0, size_t width, size_t height, double h_ref)
+        {
+            stride = width + 1;
+            for (std::vector<double>& table : tables)
+                table.assign(stride * (height + 1), 0.0);
+
+            for (size_t j = 0; j < height; ++j)
+            {
+                const float* mean = &top.mean[top.toIdx(x0, y0 + j)];
+                double row[NUM_MOMENTS] = {0., 0., 0., 0., 0., 0., 0., 0., 0.};
+                const size_t offset = (j + 1) * stride + 1;
+                for (size_t i = 0; i < width; ++i)
+                {
+                    if (!std::isnan(mean[i]))
+                    {
+                        const double h = mean[i] - h_ref;
+                        row[N] += 1.;
+                        row[I] += i;
+                        row[J] += j;
+                        row[II] += double(i * i);
+                        row[JJ] += double(j * j);
+                        row[IJ] += double(i * j);
+                        row[H] += h;
+                        row[IH] += i * h;
+                        row[JH] += j * h;
+                    }
+                    for (int m = 0; m < NUM_MOMENTS; ++m)
+                        tables[m][offset + i] = tables[m][offset + i - stride] + row[m];
+                }
+            }
+        }
+
+        /** Sum of a moment in [i0, i1) x [j0, j1) */
+        double sum(Moment m, size_t i0, size_t j0, size_t i1, size_t j1) const
+        {
+            const std::vector<double>& t = tables[m];
+            return t[j1 * stride + i1] - t[j0 * stride + i1] - t[j1 * stride + i0] + t[j0 * stride + i0];
+        }
+    };
+
+    /** Step between two topmost patches, computed as in the original neighbour update */
+    inline float computeStep(const grid::MLSTopPatchView& top, bool useStdDev, size_t idx0, size_t idx1)
     {
-        float z0 = this_patch->getMean();
-        float z1 = neighbour_patch->getMean();
+        float z0 = top.mean[idx0];
+        float z1 = top.mean[idx1];
         float stdev0 = 0;
         float stdev1 = 0;
         if (useStdDev)
         {
-            stdev0 = this_patch->getStandardDeviation();
-            stdev1 = neighbour_patch->getStandardDeviation();
+            stdev0 = top.stddev[idx0];
+            stdev1 = top.stddev[idx1];
         }
-        
+
         if (z0 > z1)
         {
             std::swap(z0, z1);
             std::swap(stdev0, stdev1);
         }
-        
+
         double min_z = z0 - stdev0;
         double max_z = z1 + stdev1;
-        
-        double step = max_z - min_z;
-        
-        diffs[this_y][this_x][this_index] = step;
-        count[this_y][this_x]++;
-        
-        diffs[other_y][other_x][other_index] = step;
-        count[other_y][other_x]++;
-    }
-    
-    else
-    {
-        diffs[this_y][this_x][this_index] = UNKNOWN;
-        diffs[other_y][other_x][other_index] = UNKNOWN;
+
+        return max_z - min_z;
     }
 }
 
-bool MLSToSlopes::computeMaxSteps(const grid::MLSMapKalman& mlsIn, grid::GridMapF& maxStepsOut,
-                                  bool useStdDev, bool correctSteps, float correctedStepThreshold)
+/**
+ * Computes the max steps of the cells in [x0, x1) x [y0, y1) of the output.
+ * topIn has to contain these cells and their direct neighbours, its first cell
+ * is the cell viewOrigin of the output.
+ */
+static void computeMaxStepsInRegion(const grid::MLSTopPatchView& topIn, const grid::Index& viewOrigin, grid::GridMapF& maxStepsOut,
+                                    size_t x0, size_t y0, size_t x1, size_t y1,
+                                    bool useStdDev, bool correctSteps, float correctedStepThreshold,
+                                    unsigned num_threads)
 {
-    // Input has to have width and height > 0.
-    size_t width = mlsIn.getNumCells()[0];
-    size_t height = mlsIn.getNumCells()[1];
-    
-    if( width == 0 || height == 0 )
-        return false;
-    
-    // Fit the output to the size and resolution of the input map and initialize with UNKNOWN.
-    maxStepsOut = grid::GridMapF(mlsIn.getNumCells(), mlsIn.getResolution(), UNKNOWN);
-    
-    boost::multi_array<int,2> counts;
-    counts.resize(boost::extents[(size_t) mlsIn.getNumCells()[1]][(size_t) mlsIn.getNumCells()[0]]);
-    std::fill(counts.data(), counts.data() + counts.num_elements(), 0);
-    
-    boost::multi_array<float,3> diffs;
-    diffs.resize(boost::extents[(size_t) mlsIn.getNumCells()[1]][(size_t) mlsIn.getNumCells()[0]][8]);
-    std::fill(diffs.data(), diffs.data() + diffs.num_elements(), 0);
-    
-    
+    const size_t width = maxStepsOut.getNumCells()[0];
+    const size_t height = maxStepsOut.getNumCells()[1];
+
+    // the border cells of the map are never computed
+    x0 = std::max<size_t>(x0, 1);
+    y0 = std::max<size_t>(y0, 1);
+    x1 = std::min(x1, width - 1);
+    y1 = std::min(y1, height - 1);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
     static const int
         BOTTOM_CENTER = 0,
         TOP_CENTER = 1,
@@ -115,133 +147,290 @@ bool MLSToSlopes::computeMaxSteps(const grid::MLSMapKalman& mlsIn, grid::GridMap
         CENTER_LEFT = 5,
         BOTTOM_RIGHT = 6,
         TOP_LEFT = 7;
-    
-    // Calculate diffs between the cells.
-    for (size_t y = 1; y < height-1; ++y)
-    {
-        for (size_t x = 1; x < width; ++x)
-        {
-            const grid::MLSMapKalman::CellType& this_cell = mlsIn.at(grid::Index(x, y));  
-            grid::MLSMapKalman::CellType::const_iterator this_patch = 
-                        std::max_element(this_cell.begin(), this_cell.end());
-            
-            if (this_patch == this_cell.end())
-                continue;
-            
-            // Compute diffs between the current cell and each neighbour.
-            updateDiffs(mlsIn, useStdDev,  diffs, counts, 
-                    BOTTOM_CENTER, x, y, TOP_CENTER, x, y + 1, this_patch);
-            updateDiffs(mlsIn, useStdDev, diffs, counts,
-                    TOP_RIGHT, x, y, BOTTOM_LEFT, x - 1, y - 1, this_patch);
-            updateDiffs(mlsIn, useStdDev, diffs, counts,
-                    CENTER_RIGHT, x, y, CENTER_LEFT, x - 1, y, this_patch);
-            updateDiffs(mlsIn, useStdDev, diffs, counts,
-                    BOTTOM_RIGHT, x, y, TOP_LEFT, x - 1, y + 1, this_patch);
-        }
-    }
-    
-    // Calculate max_steps and corrected_step_threshold from diffs
-    for (size_t y = 1; y < (height - 1); ++y)
+
+    // Each cell gathers the steps to its neighbours. The pairs are the same as
+    // in the former scatter from cell (x,y) to (x,y+1), (x-1,y-1), (x-1,y) and
+    // (x-1,y+1), which was only done for x in [1, width) and y in [1, height-1).
+    // Slots of pairs which were never visited keep the value 0.
+    tools::parallelFor(y0, y1, [&](size_t y)
     {
-        for (size_t x = 1; x < (width - 1); ++x)
+        for (size_t x = x0; x < x1; ++x)
         {
-            int count = counts[y][x];
+            float diffs[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+            int count = 0;
+
+            // 'first' is the cell which started the pair in the scatter formulation
+            auto updatePair = [&](int slot, size_t first_x, size_t first_y, size_t second_x, size_t second_y)
+            {
+                if (first_y < 1 || first_y + 1 >= height || first_x < 1 || first_x >= width)
+                    return;
+                const size_t first = topIn.toIdx(first_x - viewOrigin.x(), first_y - viewOrigin.y());
+                if (std::isnan(topIn.mean[first]))
+                    return;
+                const size_t second = topIn.toIdx(second_x - viewOrigin.x(), second_y - viewOrigin.y());
+                if (std::isnan(topIn.mean[second]))
+                {
+                    diffs[slot] = UNKNOWN;
+                    return;
+                }
+                diffs[slot] = computeStep(topIn, useStdDev, first, second);
+                count++;
+            };
+
+            updatePair(BOTTOM_CENTER, x, y, x, y + 1);
+            updatePair(TOP_CENTER, x, y - 1, x, y);
+            updatePair(TOP_RIGHT, x, y, x - 1, y - 1);
+            updatePair(BOTTOM_LEFT, x + 1, y + 1, x, y);
+            updatePair(CENTER_RIGHT, x, y, x - 1, y);
+            updatePair(CENTER_LEFT, x + 1, y, x, y);
+            updatePair(BOTTOM_RIGHT, x, y, x - 1, y + 1);
+            updatePair(TOP_LEFT, x + 1, y - 1, x, y);
+
             if (count < 5)
             {
+                maxStepsOut.at(x, y) = UNKNOWN;
                 continue;
             }
-            
+
             double max_step = UNKNOWN;
             double corrected_max_step = UNKNOWN;
             for (int i = 0; i < 8; i += 2)
             {
-                double step0 = diffs[y][x][i];
-                double step1 = diffs[y][x][i + 1];
+                double step0 = diffs[i];
+                double step1 = diffs[i + 1];
                 max_step = std::max(max_step, step0);
                 max_step = std::max(max_step, step1);
                 corrected_max_step = std::max(corrected_max_step, step0 - (step0 + step1) / 4);
                 corrected_max_step = std::max(corrected_max_step, step0 - (step0 + step1) * 3 / 4);
             }
             if (correctSteps && max_step < correctedStepThreshold)
-                maxStepsOut.at(grid::Index(x, y)) = corrected_max_step;
+                maxStepsOut.at(x, y) = corrected_max_step;
             else
-                maxStepsOut.at(grid::Index(x, y)) = max_step;
+                maxStepsOut.at(x, y) = max_step;
         }
-    }
-
-    return true;
+    }, num_threads, 16);
 }
 
-bool MLSToSlopes::computeSlopes(const grid::MLSMapKalman& mlsIn, grid::GridMapF& slopesOut, int windowSize)
+/**
+ * Computes the slopes of the cells in [x0, x1) x [y0, y1) of the output.
+ * topIn has to contain these cells and the window around them, its first cell
+ * is the cell viewOrigin of the output.
+ */
+static void computeSlopesInRegion(const grid::MLSTopPatchView& topIn, const grid::Index& viewOrigin, grid::GridMapF& slopesOut,
+                                  size_t x0, size_t y0, size_t x1, size_t y1,
+                                  int windowSize, unsigned num_threads)
 {
-    // Input has to have width and height > 0.
-    size_t width = mlsIn.getNumCells()[0];
-    size_t height = mlsIn.getNumCells()[1];
-    
-    if( width == 0 || height == 0 )
-        return false;
-    
-    // Fit the output to the size and resolution of the input map and initialize with UNKNOWN.
-    slopesOut = grid::GridMapF(mlsIn.getNumCells(), mlsIn.getResolution(), UNKNOWN);
-    
-    double scalex = mlsIn.getResolution()[0];
-    double scaley = mlsIn.getResolution()[1];
-    
-    for (size_t y = 1; y < height-1; ++y)
+    const size_t width = slopesOut.getNumCells()[0];
+    const size_t height = slopesOut.getNumCells()[1];
+
+    // the border cells of the map are never computed
+    x0 = std::max<size_t>(x0, 1);
+    y0 = std::max<size_t>(y0, 1);
+    x1 = std::min(x1, width - 1);
+    y1 = std::min(y1, height - 1);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    const double scalex = topIn.resolution[0];
+    const double scaley = topIn.resolution[1];
+    const size_t window = std::max(windowSize, 0);
+    const size_t origin_x = viewOrigin.x();
+    const size_t origin_y = viewOrigin.y();
+
+    const size_t tiles_x = (x1 - x0 + SLOPES_TILE_SIZE - 1) / SLOPES_TILE_SIZE;
+    const size_t tiles_y = (y1 - y0 + SLOPES_TILE_SIZE - 1) / SLOPES_TILE_SIZE;
+
+    tools::parallelFor(0, tiles_x * tiles_y, [&](size_t tile)
     {
-        for (size_t x = 1; x < width-1; ++x)
+        // output cells of this tile
+        const size_t out_x0 = x0 + (tile % tiles_x) * SLOPES_TILE_SIZE;
+        const size_t out_y0 = y0 + (tile / tiles_x) * SLOPES_TILE_SIZE;
+        const size_t out_x1 = std::min(x1, out_x0 + SLOPES_TILE_SIZE);
+        const size_t out_y1 = std::min(y1, out_y0 + SLOPES_TILE_SIZE);
+
+        // input region including the window around the output cells
+        const size_t in_x0 = out_x0 > window ? out_x0 - window : 0;
+        const size_t in_y0 = out_y0 > window ? out_y0 - window : 0;
+        const size_t in_x1 = std::min(width, out_x1 + window);
+        const size_t in_y1 = std::min(height, out_y1 + window);
+
+        // reference height, exact for flat areas
+        double h_ref = 0.;
+        bool has_ref = false;
+        for (size_t y = in_y0; y < in_y1 && !has_ref; ++y)
         {
-            const grid::MLSMapKalman::CellType& this_cell = mlsIn.at(grid::Index(x, y));  
-            grid::MLSMapKalman::CellType::const_iterator this_patch = 
-                        std::max_element(this_cell.begin(), this_cell.end());
-            if (this_patch == this_cell.end())
+            for (size_t x = in_x0; x < in_x1 && !has_ref; ++x)
             {
-                continue;
-            }
-            
-            // Compute gradient in 2 * windowSize area around the current cell.
-            numeric::PlaneFitting<double> fitter;
-            int count = 0;
-            double thisHeight = this_patch->getMean();
-            for (int yi = -windowSize; yi <= windowSize; ++yi) {
-                for (int xi = -windowSize; xi <= windowSize; ++xi) {
-                    //skip own entry
-                    if (xi == 0 && yi == 0)
-                        continue;
-                    
-                    const int rx = x + xi;
-                    const int ry = y + yi;
-                    
-                    if ((rx < 0) || (rx >= (int) width) || (ry < 0) || (ry >= (int) height) )
-                        continue;
-                    
-                    const grid::MLSMapKalman::CellType& neighbour_cell = mlsIn.at(grid::Index(rx, ry));
-                    grid::MLSMapKalman::CellType::const_iterator neighbour_patch =
-                        std::max_element(neighbour_cell.begin(), neighbour_cell.end());
-                    
-                    if (neighbour_patch != neighbour_cell.end())
-                    {
-                        count++;
-                        Vector3d point(xi * scalex, yi * scaley, thisHeight - neighbour_patch->getMean());
-                        fitter.update(point);
-                    }
-                }
-            }
-            
-            fitter.update(Vector3d(0, 0, 0));
-            
-            if (count < 5)
-            {
-                slopesOut.at(grid::Index(x, y)) = UNKNOWN;
+                has_ref = topIn.hasPatch(x - origin_x, y - origin_y);
+                if (has_ref)
+                    h_ref = topIn.mean[topIn.toIdx(x - origin_x, y - origin_y)];
             }
-            else
+        }
+
+        MomentTables moments;
+        moments.build(topIn, in_x0 - origin_x, in_y0 - origin_y, in_x1 - in_x0, in_y1 - in_y0, h_ref);
+
+        for (size_t y = out_y0; y < out_y1; ++y)
+        {
+            for (size_t x = out_x0; x < out_x1; ++x)
             {
-                Vector3d fit(fitter.getCoeffs());
+                float& slope = slopesOut.at(x, y);
+                slope = UNKNOWN;
+                if (!topIn.hasPatch(x - origin_x, y - origin_y))
+                    continue;
+
+                // window in tile coordinates, clipped to the map
+                const double ci = x - in_x0;
+                const double cj = y - in_y0;
+                const size_t i0 = (x > window ? x - window : 0) - in_x0;
+                const size_t j0 = (y > window ? y - window : 0) - in_y0;
+                const size_t i1 = std::min(width, x + window + 1) - in_x0;
+                const size_t j1 = std::min(height, y + window + 1) - in_y0;
+
+                // the center cell contributes the point (0, 0, 0), which the plane fit
+                // has always added explicitly, so it is simply included in the sums
+                const double n = moments.sum(MomentTables::N, i0, j0, i1, j1);
+                const int count = int(n) - 1;
+                if (count < 5)
+                    continue;
+
+                const double si = moments.sum(MomentTables::I, i0, j0, i1, j1);
+                const double sj = moments.sum(MomentTables::J, i0, j0, i1, j1);
+                const double sii = moments.sum(MomentTables::II, i0, j0, i1, j1);
+                const double sjj = moments.sum(MomentTables::JJ, i0, j0, i1, j1);
+                const double sij = moments.sum(MomentTables::IJ, i0, j0, i1, j1);
+                const double sh = moments.sum(MomentTables::H, i0, j0, i1, j1);
+                const double sih = moments.sum(MomentTables::IH, i0, j0, i1, j1);
+                const double sjh = moments.sum(MomentTables::JH, i0, j0, i1, j1);
+
+                // moments relative to the center cell
+                const double dx = si - ci * n;
+                const double dy = sj - cj * n;
+                const double dxx = sii - 2. * ci * si + ci * ci * n;
+                const double dyy = sjj - 2. * cj * sj + cj * cj * n;
+                const double dxy = sij - ci * sj - cj * si + ci * cj * n;
+                const double dxh = sih - ci * sh;
+                const double dyh = sjh - cj * sh;
+
+                // points are (dx * scalex, dy * scaley, h_center - h)
+                const double h0 = topIn.mean[topIn.toIdx(x - origin_x, y - origin_y)] - h_ref;
+                Matrix3d A;
+                A << scalex * scalex * dxx, scalex * scaley * dxy, scalex * dx,
+                     scalex * scaley * dxy, scaley * scaley * dyy, scaley * dy,
+                     scalex * dx,           scaley * dy,           n;
+                Vector3d b(scalex * (h0 * dx - dxh), scaley * (h0 * dy - dyh), n * h0 - sh);
+
+                Vector3d fit(A.inverse() * b);
                 const double divider = sqrt(fit.x() * fit.x() + fit.y() * fit.y() + 1);
-                slopesOut.at(grid::Index(x, y)) = acos(1 / divider);
+                slope = acos(1 / divider);
             }
         }
-    }
+    }, num_threads, 1);
+}
+
+/** Returns true if the output grid matches size and resolution of the input map */
+static bool outputFitsInput(const grid::MLSMapKalman& mlsIn, const grid::GridMapF& out)
+{
+    return out.getNumCells() == mlsIn.getNumCells() && out.getResolution() == mlsIn.getResolution();
+}
+
+/** Grows the extents by border cells and clips them to the map */
+static grid::CellExtents growExtents(const grid::CellExtents& extents, unsigned border, const grid::Vector2ui& num_cells)
+{
+    grid::Vector2ui min = extents.min().array() - extents.min().cwiseMin(grid::Vector2ui(border, border)).array();
+    grid::Vector2ui max = (extents.max() + grid::Vector2ui(border, border)).cwiseMin(num_cells - grid::Vector2ui(1, 1));
+    return grid::CellExtents(min, max);
+}
+
+bool MLSToSlopes::computeMaxSteps(const grid::MLSMapKalman& mlsIn, grid::GridMapF& maxStepsOut,
+                                  bool useStdDev, bool correctSteps, float correctedStepThreshold,
+                                  unsigned num_threads)
+{
+    return computeMaxSteps(grid::MLSTopPatchView::fromMLS(mlsIn), maxStepsOut,
+                           useStdDev, correctSteps, correctedStepThreshold, num_threads);
+}
+
+bool MLSToSlopes::computeMaxSteps(const grid::MLSTopPatchView& topIn, grid::GridMapF& maxStepsOut,
+                                  bool useStdDev, bool correctSteps, float correctedStepThreshold,
+                                  unsigned num_threads)
+{
+    // Input has to have width and height > 0.
+    size_t width = topIn.num_cells[0];
+    size_t height = topIn.num_cells[1];
+    
+    if( width == 0 || height == 0 )
+        return false;
+    
+    // Fit the output to the size and resolution of the input map and initialize with UNKNOWN.
+    maxStepsOut = grid::GridMapF(topIn.num_cells, topIn.resolution, UNKNOWN);
+
+    // the output covers the view only, independent of the part of the MLS it was built from
+    computeMaxStepsInRegion(topIn, grid::Index(0, 0), maxStepsOut, 0, 0, width, height,
+                            useStdDev, correctSteps, correctedStepThreshold, num_threads);
+    return true;
+}
+
+bool MLSToSlopes::updateMaxSteps(const grid::MLSMapKalman& mlsIn, grid::GridMapF& maxStepsOut,
+                                 const grid::CellExtents& dirtyCells,
+                                 bool useStdDev, bool correctSteps, float correctedStepThreshold,
+                                 unsigned num_threads)
+{
+    if (!outputFitsInput(mlsIn, maxStepsOut))
+        return computeMaxSteps(mlsIn, maxStepsOut, useStdDev, correctSteps, correctedStepThreshold, num_threads);
+
+    if (dirtyCells.isEmpty() || mlsIn.getNumCells().prod() == 0)
+        return true;
+
+    // a step depends on the direct neighbours only
+    const grid::CellExtents out_cells = growExtents(dirtyCells, 1, mlsIn.getNumCells());
+    const grid::MLSTopPatchView top = grid::MLSTopPatchView::fromMLS(mlsIn, growExtents(out_cells, 1, mlsIn.getNumCells()));
+
+    computeMaxStepsInRegion(top, top.origin, maxStepsOut, out_cells.min().x(), out_cells.min().y(),
+                            out_cells.max().x() + 1, out_cells.max().y() + 1,
+                            useStdDev, correctSteps, correctedStepThreshold, num_threads);
+    return true;
+}
+
+bool MLSToSlopes::computeSlopes(const grid::MLSMapKalman& mlsIn, grid::GridMapF& slopesOut, int windowSize,
+                                unsigned num_threads)
+{
+    return computeSlopes(grid::MLSTopPatchView::fromMLS(mlsIn), slopesOut, windowSize, num_threads);
+}
+
+bool MLSToSlopes::computeSlopes(const grid::MLSTopPatchView& topIn, grid::GridMapF& slopesOut, int windowSize,
+                                unsigned num_threads)
+{
+    // Input has to have width and height > 0.
+    size_t width = topIn.num_cells[0];
+    size_t height = topIn.num_cells[1];
     
+    if( width == 0 || height == 0 )
+        return false;
+    
+    // Fit the output to the size and resolution of the input map and initialize with UNKNOWN.
+    slopesOut = grid::GridMapF(topIn.num_cells, topIn.resolution, UNKNOWN);
+
+    // the output covers the view only, independent of the part of the MLS it was built from
+    computeSlopesInRegion(topIn, grid::Index(0, 0), slopesOut, 0, 0, width, height, windowSize, num_threads);
+    return true;
+}
+
+bool MLSToSlopes::updateSlopes(const grid::MLSMapKalman& mlsIn, grid::GridMapF& slopesOut,
+                               const grid::CellExtents& dirtyCells, int windowSize,
+                               unsigned num_threads)
+{
+    if (!outputFitsInput(mlsIn, slopesOut))
+        return computeSlopes(mlsIn, slopesOut, windowSize, num_threads);
+
+    if (dirtyCells.isEmpty() || mlsIn.getNumCells().prod() == 0)
+        return true;
+
+    // every cell whose window contains a dirty cell is affected
+    const unsigned window = std::max(windowSize, 0);
+    const grid::CellExtents out_cells = growExtents(dirtyCells, window, mlsIn.getNumCells());
+    const grid::MLSTopPatchView top = grid::MLSTopPatchView::fromMLS(mlsIn, growExtents(out_cells, window, mlsIn.getNumCells()));
+
+    computeSlopesInRegion(top, top.origin, slopesOut, out_cells.min().x(), out_cells.min().y(),
+                          out_cells.max().x() + 1, out_cells.max().y() + 1, windowSize, num_threads);
     return true;
 }
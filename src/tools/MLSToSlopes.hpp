@@ -29,6 +29,7 @@
 
 #include "../grid/GridMap.hpp"
 #include "../grid/MLSMap.hpp"
+#include "../grid/CompactMLSMap.hpp"
 
 namespace maps { namespace tools 
 {
@@ -55,15 +56,61 @@ namespace maps { namespace tools
         * @param useStdDev : Set to true to include standard deviation in the calculation of max steps.
         * @param correctSteps :  Set to true to compute corrected max steps instead.
         * @param correctedStepThreshold : If the value for a max step falls under the threshold, it will be corrected.
+        * @param num_threads : Number of threads to use, 0 uses all hardware threads.
         * */
         static bool computeMaxSteps(const maps::grid::MLSMapKalman& mlsIn, maps::grid::GridMapF& maxStepsOut,
-                                    bool useStdDev = false, bool correctSteps = false, float correctedStepThreshold = 0);
+                                    bool useStdDev = false, bool correctSteps = false, float correctedStepThreshold = 0,
+                                    unsigned num_threads = 0);
+
+        /**
+         * @brief Compute maxSteps from the topmost patches of a MLS.
+         * @details The output matches the size of the view, the first cell of a view of a part
+         * of a MLS is the cell (0,0) of the output.
+         * @see computeMaxSteps(const maps::grid::MLSMapKalman&, maps::grid::GridMapF&, bool, bool, float, unsigned)
+         **/
+        static bool computeMaxSteps(const maps::grid::MLSTopPatchView& topIn, maps::grid::GridMapF& maxStepsOut,
+                                    bool useStdDev = false, bool correctSteps = false, float correctedStepThreshold = 0,
+                                    unsigned num_threads = 0);
+
+        /**
+         * @brief Updates maxSteps after the cells in dirtyCells of the MLS have changed.
+         * @details Only the dirty cells and their direct neighbours are recomputed.
+         * If maxStepsOut does not match the size and resolution of the input, all cells are computed.
+         * @see computeMaxSteps(const maps::grid::MLSMapKalman&, maps::grid::GridMapF&, bool, bool, float, unsigned)
+         **/
+        static bool updateMaxSteps(const maps::grid::MLSMapKalman& mlsIn, maps::grid::GridMapF& maxStepsOut,
+                                   const maps::grid::CellExtents& dirtyCells,
+                                   bool useStdDev = false, bool correctSteps = false, float correctedStepThreshold = 0,
+                                   unsigned num_threads = 0);
         
         /**
          * @brief Compute slopes from MLSMapKalman.
+         * @details The plane fit uses summed area tables of the topmost patches,
+         * so the cost per cell does not depend on the window size.
          * @param windowSize: The slope for each cell is computed from -windowSize to windowSize around the cell. Has to be >= 1.
+         * @param num_threads : Number of threads to use, 0 uses all hardware threads.
+         **/
+        static bool computeSlopes(const maps::grid::MLSMapKalman& mlsIn, maps::grid::GridMapF& slopesOut, int windowSize = 1,
+                                  unsigned num_threads = 0);
+
+        /**
+         * @brief Compute slopes from the topmost patches of a MLS.
+         * @details The output matches the size of the view, the first cell of a view of a part
+         * of a MLS is the cell (0,0) of the output.
+         * @see computeSlopes(const maps::grid::MLSMapKalman&, maps::grid::GridMapF&, int, unsigned)
+         **/
+        static bool computeSlopes(const maps::grid::MLSTopPatchView& topIn, maps::grid::GridMapF& slopesOut, int windowSize = 1,
+                                  unsigned num_threads = 0);
+
+        /**
+         * @brief Updates slopes after the cells in dirtyCells of the MLS have changed.
+         * @details Only the cells whose window overlaps the dirty cells are recomputed.
+         * If slopesOut does not match the size and resolution of the input, all cells are computed.
+         * @see computeSlopes(const maps::grid::MLSMapKalman&, maps::grid::GridMapF&, int, unsigned)
          **/
-        static bool computeSlopes(const maps::grid::MLSMapKalman& mlsIn, maps::grid::GridMapF& slopesOut, int windowSize = 1);
+        static bool updateSlopes(const maps::grid::MLSMapKalman& mlsIn, maps::grid::GridMapF& slopesOut,
+                                 const maps::grid::CellExtents& dirtyCells, int windowSize = 1,
+                                 unsigned num_threads = 0);
         
     };
     
@@ -27,6 +27,7 @@
 #pragma once
 
 #include<Eigen/Core>
+#include <vector>
 
 namespace maps { namespace tools
 {
@@ -339,6 +340,13 @@ namespace maps { namespace tools
     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}
   };
 
+  /*
+   * Cube vertices connected by each edge of the cube.
+   */
+  const int edgeVertices[12][2] = {
+    {0, 1}, {1, 2}, {2, 3}, {3, 0}, {4, 5}, {5, 6}, {6, 7}, {7, 4}, {0, 4}, {1, 5}, {2, 6}, {3, 7}
+  };
+
 class MarchingCubes
 {
 public:
@@ -347,6 +355,22 @@ public:
                                 const std::vector<float> &signed_distances,
                                 std::vector< VectorType, Allocator >& surfaces,
                                 float iso_level = 0.f)
+    {
+        std::vector<int>* no_edges = NULL;
+        computeSurfaces(vertices, signed_distances, surfaces, no_edges, iso_level);
+    }
+
+    /**
+     * Same as above, additionally the cube edge (0-11, see edgeVertices) of every vertex
+     * added to \c surfaces is appended to \c edges. This allows sharing the vertices
+     * with the neighboring cubes.
+     */
+    template<class VectorType, class Allocator, class EdgeContainer>
+    static void computeSurfaces(const std::vector< VectorType, Allocator >& vertices,
+                                const std::vector<float> &signed_distances,
+                                std::vector< VectorType, Allocator >& surfaces,
+                                EdgeContainer* edges,
+                                float iso_level = 0.f)
     {
         // identify cube index
         int cubeindex = 0;
@@ -397,6 +421,11 @@ public:
             surfaces.push_back(vertex_list[triTable[cubeindex][i+1]]);
             surfaces.push_back(vertex_list[triTable[cubeindex][i+2]]);
         }
+        if(edges)
+        {
+            for (int i = 0; triTable[cubeindex][i] != -1; i++)
+                edges->push_back(triTable[cubeindex][i]);
+        }
     }
 
 protected:
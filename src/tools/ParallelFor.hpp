@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace maps { namespace tools
+{
+    /**
+     * Returns the number of worker threads to use for a requested thread count.
+     * A request of 0 selects the number of hardware threads.
+     */
+    inline unsigned resolveNumThreads(unsigned num_threads)
+    {
+        if(num_threads == 0)
+            num_threads = std::thread::hardware_concurrency();
+        return std::max(num_threads, 1u);
+    }
+
+    /**
+     * Calls \c f(i, state) for every i in [begin, end) using up to \c num_threads threads.
+     * Every thread default constructs one \c State and passes it to all of its calls, which
+     * allows to reuse scratch buffers across the indices handled by the same thread.
+     * The indices are handed out in chunks of \c grain_size elements, so \c f has to be safe
+     * to call concurrently for different indices.
+     * If \c num_threads is 0 the number of hardware threads is used. With a single thread
+     * \c f is called in order on the calling thread.
+     * The first exception thrown by \c f is rethrown after all threads have finished.
+     */
+    template<class State, class Function>
+    void parallelForWithState(size_t begin, size_t end, Function f, unsigned num_threads = 0, size_t grain_size = 64)
+    {
+        if(end <= begin)
+            return;
+
+        grain_size = std::max<size_t>(grain_size, 1);
+        const size_t num_chunks = (end - begin + grain_size - 1) / grain_size;
+        num_threads = std::min<size_t>(resolveNumThreads(num_threads), num_chunks);
+
+        if(num_threads <= 1)
+        {
+            State state;
+            for(size_t i = begin; i < end; ++i)
+                f(i, state);
+            return;
+        }
+
+        std::atomic<size_t> next_chunk(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto worker = [&]()
+        {
+            try
+            {
+                State state;
+                size_t chunk;
+                while((chunk = next_chunk++) < num_chunks)
+                {
+                    const size_t chunk_begin = begin + chunk * grain_size;
+                    const size_t chunk_end = std::min(chunk_begin + grain_size, end);
+                    for(size_t i = chunk_begin; i < chunk_end; ++i)
+                        f(i, state);
+                }
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if(!error)
+                    error = std::current_exception();
+                // stop handing out further chunks
+                next_chunk = num_chunks;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads - 1);
+        for(unsigned t = 1; t < num_threads; ++t)
+            threads.emplace_back(worker);
+        worker();
+        for(std::thread& thread : threads)
+            thread.join();
+
+        if(error)
+            std::rethrow_exception(error);
+    }
+
+    /**
+     * Calls \c f(i) for every i in [begin, end) using up to \c num_threads threads,
+     * see parallelForWithState.
+     */
+    template<class Function>
+    void parallelFor(size_t begin, size_t end, Function f, unsigned num_threads = 0, size_t grain_size = 64)
+    {
+        struct NoState {};
+        parallelForWithState<NoState>(begin, end, [&f](size_t i, NoState&) { f(i); }, num_threads, grain_size);
+    }
+}
+}
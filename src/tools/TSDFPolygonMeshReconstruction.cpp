@@ -28,15 +28,39 @@
 
 #include <pcl/common/transforms.h>
 #include <pcl/common/io.h>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 
 using namespace maps::tools;
 using namespace maps::grid;
 
-void TSDFPolygonMeshReconstruction::reconstruct(pcl::PolygonMesh& output)
+namespace
 {
-    std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > surfaces;
+    void writeLittleEndian(std::ostream& stream, uint32_t value)
+    {
+        const char bytes[4] = {char(value & 0xFF), char((value >> 8) & 0xFF), char((value >> 16) & 0xFF), char((value >> 24) & 0xFF)};
+        stream.write(bytes, 4);
+    }
+
+    void writeLittleEndian(std::ostream& stream, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        writeLittleEndian(stream, bits);
+    }
+}
+
+template<class MapT>
+void BasicTSDFPolygonMeshReconstruction<MapT>::reconstruct(pcl::PolygonMesh& output)
+{
+    VertexList surfaces;
     std::vector<float> intensities;
-    reconstructSurfaces(surfaces, intensities);
+    std::vector<uint32_t> indices;
+    if(indexed)
+        this->reconstructIndexedSurfaces(surfaces, indices, intensities);
+    else
+        this->reconstructSurfaces(surfaces, intensities);
 
     pcl::PointCloud<pcl::PointXYZI> cloud_with_intensity;
     cloud_with_intensity.resize(surfaces.size());
@@ -48,15 +72,73 @@ void TSDFPolygonMeshReconstruction::reconstruct(pcl::PolygonMesh& output)
 
     pcl::toPCLPointCloud2(cloud_with_intensity, output.cloud);
 
-    output.polygons.resize (cloud_with_intensity.size() / 3);
+    output.polygons.resize ((indexed ? indices.size() : cloud_with_intensity.size()) / 3);
     for(size_t i = 0; i < output.polygons.size(); ++i)
     {
         pcl::Vertices v;
         v.vertices.resize (3);
         for(int j = 0; j < 3; ++j)
         {
-            v.vertices[j] = static_cast<int> (i) * 3 + j;
+            v.vertices[j] = indexed ? indices[i * 3 + j] : static_cast<int> (i) * 3 + j;
         }
         output.polygons[i] = v;
     }
 }
+
+template<class MapT>
+void BasicTSDFPolygonMeshReconstruction<MapT>::reconstruct(VertexList& vertices, std::vector<uint32_t>& indices, std::vector<float>& intensities)
+{
+    vertices.clear();
+    indices.clear();
+    intensities.clear();
+    this->reconstructIndexedSurfaces(vertices, indices, intensities);
+}
+
+template<class MapT>
+void BasicTSDFPolygonMeshReconstruction<MapT>::writePLY(const std::string& filename, const VertexList& vertices, const std::vector<uint32_t>& indices,
+                                                          const std::vector<float>& intensities)
+{
+    if(intensities.size() != vertices.size() || indices.size() % 3 != 0)
+        throw std::runtime_error("Invalid mesh, expected one intensity per vertex and three indices per triangle!");
+
+    std::ofstream file(filename.c_str(), std::ios::binary);
+    if(!file)
+        throw std::runtime_error("Can't open " + filename + " for writing!");
+
+    file << "ply\n"
+         << "format binary_little_endian 1.0\n"
+         << "element vertex " << vertices.size() << "\n"
+         << "property float x\n"
+         << "property float y\n"
+         << "property float z\n"
+         << "property float intensity\n"
+         << "element face " << indices.size() / 3 << "\n"
+         << "property list uchar uint vertex_indices\n"
+         << "end_header\n";
+
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        writeLittleEndian(file, vertices[i].x());
+        writeLittleEndian(file, vertices[i].y());
+        writeLittleEndian(file, vertices[i].z());
+        writeLittleEndian(file, intensities[i]);
+    }
+    for(size_t i = 0; i < indices.size(); i += 3)
+    {
+        file.put(3);
+        writeLittleEndian(file, indices[i]);
+        writeLittleEndian(file, indices[i + 1]);
+        writeLittleEndian(file, indices[i + 2]);
+    }
+
+    if(!file)
+        throw std::runtime_error("Failed to write " + filename + "!");
+}
+
+namespace maps { namespace tools
+{
+    template class BasicTSDFPolygonMeshReconstruction<TSDFVolumetricMap>;
+    template class BasicTSDFPolygonMeshReconstruction<PackedTSDFVolumetricMap>;
+    template class BasicTSDFPolygonMeshReconstruction<HalfTSDFVolumetricMap>;
+    template class BasicTSDFPolygonMeshReconstruction<DenseTSDFVolumetricMap>;
+}}
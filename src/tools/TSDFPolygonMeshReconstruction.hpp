@@ -28,16 +28,55 @@
 
 #include <pcl/PolygonMesh.h>
 #include "TSDFSurfaceReconstruction.hpp"
+#include <string>
 
 namespace maps { namespace tools
 {
 
-class TSDFPolygonMeshReconstruction : public TSDFSurfaceReconstruction<pcl::PolygonMesh>
+/**
+ * Reconstructs a polygon mesh from a TSDF map of type \c MapT,
+ * see TSDFPolygonMeshReconstruction.
+ */
+template<class MapT>
+class BasicTSDFPolygonMeshReconstruction : public TSDFSurfaceReconstruction<pcl::PolygonMesh, MapT>
 {
 public:
-    TSDFPolygonMeshReconstruction() : TSDFSurfaceReconstruction<pcl::PolygonMesh>() {}
+    typedef std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > VertexList;
+
+    BasicTSDFPolygonMeshReconstruction() : TSDFSurfaceReconstruction<pcl::PolygonMesh, MapT>(), indexed(false) {}
+
+    /**
+     * If set, vertices on the same voxel edge are shared between the triangles of the mesh,
+     * otherwise every triangle has its own three vertices.
+     */
+    inline void setIndexedOutput(bool indexed) { this->indexed = indexed; }
+    inline bool getIndexedOutput() { return this->indexed; }
 
     void reconstruct(pcl::PolygonMesh &output);
+
+    /**
+     * Reconstructs an indexed mesh with shared vertices without the conversion to PCL types.
+     * Every three entries of \c indices form a triangle, the intensities are given per vertex.
+     */
+    void reconstruct(VertexList& vertices, std::vector<uint32_t>& indices, std::vector<float>& intensities);
+
+    /**
+     * Writes an indexed mesh as binary little endian PLY file.
+     * Throws std::runtime_error if the file can't be written.
+     */
+    static void writePLY(const std::string& filename, const VertexList& vertices, const std::vector<uint32_t>& indices,
+                         const std::vector<float>& intensities);
+
+private:
+    bool indexed;
 };
 
+/** Polygon mesh reconstruction of a TSDFVolumetricMap */
+typedef BasicTSDFPolygonMeshReconstruction<grid::TSDFVolumetricMap> TSDFPolygonMeshReconstruction;
+
+extern template class BasicTSDFPolygonMeshReconstruction<grid::TSDFVolumetricMap>;
+extern template class BasicTSDFPolygonMeshReconstruction<grid::PackedTSDFVolumetricMap>;
+extern template class BasicTSDFPolygonMeshReconstruction<grid::HalfTSDFVolumetricMap>;
+extern template class BasicTSDFPolygonMeshReconstruction<grid::DenseTSDFVolumetricMap>;
+
 }}
@@ -29,21 +29,29 @@
 #include <Eigen/Core>
 #include <maps/grid/TSDFVolumetricMap.hpp>
 #include "MarchingCubes.hpp"
+#include "ParallelFor.hpp"
+#include <unordered_map>
 
 namespace maps { namespace tools
 {
 
-template<class T>
+/**
+ * Extracts the iso surface of a TSDF map. \c T is the output type of reconstruct, \c MapT the
+ * type of the TSDF map, e.g. PackedTSDFVolumetricMap or HalfTSDFVolumetricMap.
+ */
+template<class T, class MapT = grid::TSDFVolumetricMap>
 class TSDFSurfaceReconstruction
 {
 public:
-    TSDFSurfaceReconstruction() : std_threshold(1.f), iso_level(0.f) {}
+    typedef MapT TSDFMapType;
+
+    TSDFSurfaceReconstruction() : std_threshold(1.f), iso_level(0.f), num_threads(1) {}
     virtual ~TSDFSurfaceReconstruction() {}
 
-    void setTSDFMap(grid::TSDFVolumetricMap::Ptr map, float z_min = -50.f, float z_max = 50.f)
+    void setTSDFMap(typename MapT::Ptr map, float z_min = -50.f, float z_max = 50.f)
     {
         tsdf_map = map;
-        voxel_res = tsdf_map->getVoxelResolution().cast<float>();
+        voxel_res = tsdf_map->getVoxelResolution().template cast<float>();
         z_idx_min = (int32_t)std::floor(z_min / voxel_res.z());
         z_idx_max = (int32_t)std::floor(z_max / voxel_res.z());
 
@@ -69,76 +77,274 @@ public:
     inline void setStdThreshold(float threshold) { this->std_threshold = threshold; }
     inline float getStdThreshold() { return this->std_threshold; }
 
+    /**
+     * Number of threads used for the extraction, 0 selects the number of hardware threads.
+     * With more than one thread blocks of columns are processed in parallel, the result
+     * is the same as the serial one.
+     */
+    inline void setNumThreads(unsigned num_threads) { this->num_threads = num_threads; }
+    inline unsigned getNumThreads() { return this->num_threads; }
+
     virtual void reconstruct(T &output) = 0;
 
 protected:
     void reconstructSurfaces(std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& surfaces, std::vector<float>& intensities, bool surfaces_in_global_frame = true)
     {
-        if(!tsdf_map)
-            throw std::runtime_error("TSDF map is not set!");
+        extractSurfaces(surfaces, intensities, NULL);
 
-        maps::grid::CellExtents extends = tsdf_map->calculateCellExtents();
-        for(unsigned y = extends.min().y(); y < extends.max().y(); y++)
+        // transform points to global frame
+        if(surfaces_in_global_frame)
+            transformToGlobalFrame(surfaces);
+    }
+
+    /**
+     * Indexed variant of reconstructSurfaces. Vertices on the same voxel edge are shared
+     * between the neighboring cubes, every three entries of \c indices form a triangle.
+     * The intensities are given per vertex.
+     */
+    void reconstructIndexedSurfaces(std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& vertices, std::vector<uint32_t>& indices,
+                                    std::vector<float>& intensities, bool surfaces_in_global_frame = true)
+    {
+        std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > surfaces;
+        std::vector<float> surface_intensities;
+        std::vector<uint64_t> edge_keys;
+        extractSurfaces(surfaces, surface_intensities, &edge_keys);
+
+        std::unordered_map<uint64_t, uint32_t> vertex_ids;
+        vertex_ids.reserve(surfaces.size() / 2);
+        indices.reserve(indices.size() + surfaces.size());
+        for(size_t i = 0; i < surfaces.size(); ++i)
         {
-            for(unsigned x = extends.min().x(); x < extends.max().x(); x++)
+            std::pair<std::unordered_map<uint64_t, uint32_t>::iterator, bool> vertex = vertex_ids.emplace(edge_keys[i], (uint32_t)vertices.size());
+            if(vertex.second)
             {
-                const maps::grid::TSDFVolumetricMap::GridMapBase::CellType& tree = tsdf_map->at(x,y);
-                for(maps::grid::TSDFVolumetricMap::GridMapBase::CellType::const_iterator cell = tree.begin(); cell != tree.end(); cell++)
-                {
-                    if(cell->first > z_idx_min && cell->first < z_idx_max)
-                    {
-                        Eigen::Vector3i idx(x,y,cell->first);
-                        reconstructVoxel(cell->second, idx, surfaces, intensities);
-                    }
-                }
+                vertices.push_back(surfaces[i]);
+                intensities.push_back(surface_intensities[i]);
             }
+            indices.push_back(vertex.first->second);
         }
 
-        // transform points to global frame
         if(surfaces_in_global_frame)
-        {
-            Eigen::Affine3f local_frame = tsdf_map->getLocalFrame().inverse().cast<float>();
-            for(Eigen::Vector3f& point : surfaces)
-                point = local_frame * point;
-        }
+            transformToGlobalFrame(vertices);
     }
 
-    void reconstructVoxel(const grid::TSDFVolumetricMap::VoxelCellType& voxel, Eigen::Vector3i& idx,
-                          std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& surfaces, std::vector<float>& intensities)
+    void reconstructVoxel(const typename MapT::VoxelCellType& voxel, Eigen::Vector3i& idx,
+                          std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& surfaces, std::vector<float>& intensities,
+                          std::vector<uint64_t>* edge_keys = NULL)
     {
         if(std::abs(voxel.getDistance()) < tsdf_map->getTruncation() && voxel.getStandardDeviation() < std_threshold)
         {
             std::vector<float> leaf_node(8, 0.f);
             leaf_node[0] = voxel.getDistance();
             if(getValidNeighborList(leaf_node, idx))
+                addVoxelSurfaces(voxel, idx, leaf_node, surfaces, intensities, edge_keys);
+        }
+    }
+
+private:
+    typedef typename MapT::ColumnType ColumnType;
+
+    /**
+     * Extracts the triangles of all voxels, if \c edge_keys is given the key of the voxel edge
+     * of every vertex is added, see edgeKey. Only the non-empty columns of the allocated cells
+     * are visited, empty space is skipped by sparse grid storages.
+     */
+    void extractSurfaces(std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& surfaces, std::vector<float>& intensities,
+                         std::vector<uint64_t>* edge_keys)
+    {
+        if(!tsdf_map)
+            throw std::runtime_error("TSDF map is not set!");
+
+        std::vector< std::pair<grid::Index, const ColumnType*> > columns;
+        tsdf_map->forEachAllocatedCell([&columns](const grid::Index& idx, const ColumnType& tree)
+        {
+            if(!tree.empty())
+                columns.push_back(std::make_pair(idx, &tree));
+        });
+
+        if(num_threads == 1)
+        {
+            extractColumns(columns, 0, columns.size(), surfaces, intensities, edge_keys);
+            return;
+        }
+
+        reconstructSurfacesParallel(columns, surfaces, intensities, edge_keys);
+    }
+
+    void transformToGlobalFrame(std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& points) const
+    {
+        Eigen::Affine3f local_frame = tsdf_map->getLocalFrame().inverse().template cast<float>();
+        for(Eigen::Vector3f& point : points)
+            point = local_frame * point;
+    }
+
+    /**
+     * Unique key of an edge of the cube of voxel \c idx. The edge is identified by its lower
+     * corner and its axis, hence neighboring cubes get the same key for a shared edge.
+     * Supports grids of up to 2^20 cells in x and y and z indices within +-2^21.
+     */
+    static uint64_t edgeKey(const Eigen::Vector3i& idx, int edge)
+    {
+        Eigen::Vector3i corner = idx;
+        int axis = 0;
+        const int a = edgeVertices[edge][0];
+        const int b = edgeVertices[edge][1];
+        const Eigen::Vector3i offset_a(((a & 0x1) ^ ((a >> 1) & 0x1)), (a >> 2) & 0x1, (a >> 1) & 0x1);
+        const Eigen::Vector3i offset_b(((b & 0x1) ^ ((b >> 1) & 0x1)), (b >> 2) & 0x1, (b >> 1) & 0x1);
+        for(int i = 0; i < 3; ++i)
+        {
+            corner[i] += std::min(offset_a[i], offset_b[i]);
+            if(offset_a[i] != offset_b[i])
+                axis = i;
+        }
+        return (uint64_t(corner.x()) & 0xFFFFF) | ((uint64_t(corner.y()) & 0xFFFFF) << 20) |
+               ((uint64_t(corner.z() + (1 << 21)) & 0x3FFFFF) << 40) | (uint64_t(axis) << 62);
+    }
+
+    /** Looks up the voxels z and z+1 of a column, z must not decrease between the calls */
+    class ColumnCursor
+    {
+    public:
+        ColumnCursor() : column(NULL) {}
+        explicit ColumnCursor(const ColumnType& column) : column(&column), it(column.begin()) {}
+
+        /** Returns false if one of both voxels doesn't exist or exceeds the standard deviation threshold */
+        bool getDistances(int32_t z, float std_threshold, float& lower, float& upper)
+        {
+            if(!column)
+                return false;
+            while(it != column->end() && it->first < z)
+                ++it;
+            if(it == column->end() || it->first != z)
+                return false;
+            typename ColumnType::const_iterator next = it;
+            ++next;
+            if(next == column->end() || next->first != z + 1)
+                return false;
+            if(it->second.getStandardDeviation() >= std_threshold || next->second.getStandardDeviation() >= std_threshold)
+                return false;
+            lower = it->second.getDistance();
+            upper = next->second.getDistance();
+            return true;
+        }
+
+    private:
+        const ColumnType* column;
+        typename ColumnType::const_iterator it;
+    };
+
+    /**
+     * Processes blocks of columns in parallel. Every block collects its triangles in its own
+     * buffer, the buffers are concatenated in block order, hence the result is the same as
+     * the serial one.
+     */
+    void reconstructSurfacesParallel(const std::vector< std::pair<grid::Index, const ColumnType*> >& columns,
+                                     std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& surfaces, std::vector<float>& intensities,
+                                     std::vector<uint64_t>* edge_keys)
+    {
+        // number of columns processed as one unit
+        const size_t block_size = 256;
+        const size_t num_blocks = (columns.size() + block_size - 1) / block_size;
+        std::vector< std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > > block_surfaces(num_blocks);
+        std::vector< std::vector<float> > block_intensities(num_blocks);
+        std::vector< std::vector<uint64_t> > block_edge_keys(edge_keys ? num_blocks : 0);
+        parallelFor(0, num_blocks, [&](size_t block)
+        {
+            const size_t begin = block * block_size;
+            extractColumns(columns, begin, std::min(begin + block_size, columns.size()), block_surfaces[block],
+                           block_intensities[block], edge_keys ? &block_edge_keys[block] : NULL);
+        }, num_threads, 1);
+
+        for(size_t block = 0; block < num_blocks; ++block)
+        {
+            surfaces.insert(surfaces.end(), block_surfaces[block].begin(), block_surfaces[block].end());
+            intensities.insert(intensities.end(), block_intensities[block].begin(), block_intensities[block].end());
+            if(edge_keys)
+                edge_keys->insert(edge_keys->end(), block_edge_keys[block].begin(), block_edge_keys[block].end());
+        }
+    }
+
+    /**
+     * Extracts the triangles of the columns [begin, end). Instead of looking up the neighbors
+     * of each voxel, the four columns of a cube are walked with cursors in ascending z order.
+     */
+    void extractColumns(const std::vector< std::pair<grid::Index, const ColumnType*> >& columns, size_t begin, size_t end,
+                        std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& surfaces, std::vector<float>& intensities,
+                        std::vector<uint64_t>* edge_keys)
+    {
+        const MapT& map = *tsdf_map;
+        const size_t num_cells_x = map.getNumCells().x();
+        const size_t num_cells_y = map.getNumCells().y();
+        const float truncation = tsdf_map->getTruncation();
+        std::vector<float> leaf_node(8, 0.f);
+        for(size_t i = begin; i < end; ++i)
+        {
+            const size_t x = columns[i].first.x();
+            const size_t y = columns[i].first.y();
+            const ColumnType& tree = *columns[i].second;
+
+            // the neighbor columns are missing at the border of the grid
+            const bool has_next_x = x + 1 < num_cells_x;
+            const bool has_next_y = y + 1 < num_cells_y;
+            ColumnCursor column(tree);
+            ColumnCursor next_x = has_next_x ? ColumnCursor(map.at(grid::Index(x + 1, y))) : ColumnCursor();
+            ColumnCursor next_y = has_next_y ? ColumnCursor(map.at(grid::Index(x, y + 1))) : ColumnCursor();
+            ColumnCursor next_xy = has_next_x && has_next_y ? ColumnCursor(map.at(grid::Index(x + 1, y + 1))) : ColumnCursor();
+            for(typename ColumnType::const_iterator cell = tree.begin(); cell != tree.end(); cell++)
             {
-                size_t size = surfaces.size();
-                // create surface
-                MarchingCubes::computeSurfaces(vertices, leaf_node, surfaces, iso_level);
-
-                // move surfaces to the current cell
-                Eigen::Vector3f cell_center = (idx.cast<float>() + Eigen::Vector3f(0.5f, 0.5f, 0.5f)).cwiseProduct(voxel_res);
-                for(size_t i = size; i < surfaces.size(); i++)
-                    surfaces[i] = cell_center + surfaces[i];
-
-                // add intensity information
-                size_t new_points = surfaces.size() - size;
-                float intensity = std::max( 0.f, (std_threshold - voxel.getStandardDeviation() - std::sqrt(tsdf_map->getMinVariance())) / std_threshold);
-                for(size_t i = 0; i < new_points; i++)
+                const int32_t z = cell->first;
+                const typename MapT::VoxelCellType& voxel = cell->second;
+                if(!(z > z_idx_min && z < z_idx_max) ||
+                   !(std::abs(voxel.getDistance()) < truncation && voxel.getStandardDeviation() < std_threshold))
+                    continue;
+
+                if(column.getDistances(z, std_threshold, leaf_node[0], leaf_node[3]) &&
+                   next_x.getDistances(z, std_threshold, leaf_node[1], leaf_node[2]) &&
+                   next_y.getDistances(z, std_threshold, leaf_node[4], leaf_node[7]) &&
+                   next_xy.getDistances(z, std_threshold, leaf_node[5], leaf_node[6]))
                 {
-                    intensities.push_back(intensity);
+                    addVoxelSurfaces(voxel, Eigen::Vector3i(x, y, z), leaf_node, surfaces, intensities, edge_keys);
                 }
             }
         }
     }
 
-private:
+    /** Creates the surfaces of a voxel from the distances at its corners */
+    void addVoxelSurfaces(const typename MapT::VoxelCellType& voxel, const Eigen::Vector3i& idx, const std::vector<float>& leaf_node,
+                          std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> >& surfaces, std::vector<float>& intensities,
+                          std::vector<uint64_t>* edge_keys)
+    {
+        size_t size = surfaces.size();
+        // create surface
+        MarchingCubes::computeSurfaces(vertices, leaf_node, surfaces, edge_keys, iso_level);
+        if(edge_keys)
+        {
+            // the cube edges are replaced by their keys
+            for(size_t i = edge_keys->size() - (surfaces.size() - size); i < edge_keys->size(); i++)
+                (*edge_keys)[i] = edgeKey(idx, (int)(*edge_keys)[i]);
+        }
+
+        // move surfaces to the current cell
+        Eigen::Vector3f cell_center = (idx.cast<float>() + Eigen::Vector3f(0.5f, 0.5f, 0.5f)).cwiseProduct(voxel_res);
+        for(size_t i = size; i < surfaces.size(); i++)
+            surfaces[i] = cell_center + surfaces[i];
+
+        // add intensity information
+        size_t new_points = surfaces.size() - size;
+        float intensity = std::max( 0.f, (std_threshold - voxel.getStandardDeviation() - std::sqrt(tsdf_map->getMinVariance())) / std_threshold);
+        for(size_t i = 0; i < new_points; i++)
+        {
+            intensities.push_back(intensity);
+        }
+    }
+
     bool getGridValue(Eigen::Vector3i pos, float &distance)
     {
-        if(!tsdf_map->hasVoxelCell(pos))
+        // the neighbors of the voxels at the border of the grid are missing
+        if(!tsdf_map->inGrid(pos.head<2>()) || !tsdf_map->hasVoxelCell(pos))
             return false;
 
-        const maps::grid::TSDFPatch& cell = tsdf_map->getVoxelCell(pos);
+        const typename MapT::VoxelCellType& cell = tsdf_map->getVoxelCell(pos);
 
         if(cell.getStandardDeviation() >= std_threshold)
             return false;
@@ -167,11 +373,12 @@ private:
     }
 
 protected:
-    grid::TSDFVolumetricMap::Ptr tsdf_map;
+    typename MapT::Ptr tsdf_map;
 
 private:
     float std_threshold;
     float iso_level;
+    unsigned num_threads;
     int32_t z_idx_min;
     int32_t z_idx_max;
     Eigen::Vector3f voxel_res;
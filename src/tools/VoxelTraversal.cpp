@@ -27,6 +27,8 @@
 #include "VoxelTraversal.hpp"
 
 #include <base/Timeout.hpp>
+#include <cmath>
+#include <limits>
 
 using namespace maps::tools;
 
@@ -133,3 +135,94 @@ void VoxelTraversal::computeRay(const Eigen::Vector3d& grid_res, const Eigen::Ve
             ray.pop_back();
     }
 }
+
+void VoxelTraversal::computeRays(const Eigen::Vector3d& grid_res, const Eigen::Vector3d& origin, const Eigen::Vector3i& origin_idx,
+                                 const Eigen::Vector3d* measurements, size_t num_measurements, RayBuffer& rays)
+{
+    rays.clear();
+    rays.offsets.reserve(num_measurements + 1);
+    rays.offsets.push_back(0);
+
+    // the aligned origin index and the borders of the origin cell are shared by all rays
+    const double scale[3] = {1.0/grid_res.x(), 1.0/grid_res.y(), 1.0/grid_res.z()};
+    int32_t local_origin_idx[3];
+    double voxel_border[3][2];
+    for(unsigned i = 0; i < 3; i++)
+    {
+        local_origin_idx[i] = int32_t(std::round(origin(i) * scale[i]));
+        const double origin_cell_center = double(local_origin_idx[i]) * grid_res(i);
+        voxel_border[i][0] = origin_cell_center + -1.0 * grid_res(i) * 0.5;
+        voxel_border[i][1] = origin_cell_center + 1.0 * grid_res(i) * 0.5;
+    }
+
+    for(size_t r = 0; r < num_measurements; ++r)
+    {
+        const Eigen::Vector3d& measurement = measurements[r];
+        const Eigen::Vector3d direction = (measurement - origin).normalized();
+        const double distance = (measurement - origin).norm();
+
+        int32_t step[3];
+        double t_max[3];
+        double t_delta[3];
+        int32_t ray_idx[3];
+        int32_t measurement_idx[3];
+        for(unsigned i = 0; i < 3; i++)
+        {
+            step[i] = direction(i) > 0.0 ? 1 : (direction(i) < 0.0 ? -1 : 0);
+            t_max[i] = std::numeric_limits<double>::max();
+            t_delta[i] = 0.0;
+            if(step[i] != 0)
+            {
+                t_max[i] = (voxel_border[i][step[i] > 0] - origin(i)) / direction(i);
+                t_delta[i] = grid_res(i) / fabs(direction(i));
+            }
+            ray_idx[i] = origin_idx(i);
+            measurement_idx[i] = origin_idx(i) + (int32_t(std::round(measurement(i) * scale[i])) - local_origin_idx[i]);
+        }
+
+        if(step[0] == 0 && step[1] == 0 && step[2] == 0)
+        {
+            rays.offsets.push_back(rays.elements.size());
+            continue;
+        }
+
+        const size_t ray_start = rays.elements.size();
+        rays.elements.push_back(RayElement(Eigen::Vector3i(ray_idx[0], ray_idx[1], ray_idx[2]), step[2]));
+
+        // traverse ray
+        bool missed = false;
+        while(ray_idx[0] != measurement_idx[0] || ray_idx[1] != measurement_idx[1] || ray_idx[2] != measurement_idx[2])
+        {
+            // identify axis to increase
+            const int axis = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+
+            // check for a potential miss of the last cell due to discretization errors
+            if(t_max[axis] > distance)
+            {
+                missed = true;
+                break;
+            }
+
+            // increase index
+            ray_idx[axis] += step[axis];
+            t_max[axis] += t_delta[axis];
+            if(axis != 2)
+                rays.elements.push_back(RayElement(Eigen::Vector3i(ray_idx[0], ray_idx[1], ray_idx[2]), step[2]));
+            else
+                rays.elements.back().z_last = ray_idx[2];
+        }
+
+        if(missed)
+            rays.elements.erase(rays.elements.begin() + ray_start, rays.elements.end());
+        else
+        {
+            // remove last element from ray
+            RayElement& last = rays.elements.back();
+            if(last.z_last != last.z_first)
+                last.z_last -= step[2];
+            else
+                rays.elements.pop_back();
+        }
+        rays.offsets.push_back(rays.elements.size());
+    }
+}
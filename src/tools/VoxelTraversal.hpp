@@ -47,6 +47,32 @@ public:
         int32_t z_step;
     };
 
+    /**
+     * Flat storage of the rays computed by computeRays.
+     * The elements of ray i are stored in [offsets[i], offsets[i+1]). The buffer can be reused
+     * between calls to avoid allocations.
+     */
+    struct RayBuffer
+    {
+        std::vector<RayElement> elements;
+        std::vector<size_t> offsets;
+
+        /** Number of rays in the buffer */
+        size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+        /** True if ray i is empty, i.e. the measurement was missed or is the origin cell */
+        bool empty(size_t i) const { return offsets[i] == offsets[i + 1]; }
+
+        std::vector<RayElement>::const_iterator begin(size_t i) const { return elements.begin() + offsets[i]; }
+        std::vector<RayElement>::const_iterator end(size_t i) const { return elements.begin() + offsets[i + 1]; }
+
+        void clear()
+        {
+            elements.clear();
+            offsets.clear();
+        }
+    };
+
     /**
      * Computes measurement_idx and origin_cell_center before calling computeRay.
      * If you are unsure about the cell alignment, use this method.
@@ -64,6 +90,16 @@ public:
                            const Eigen::Vector3d& measurement, const Eigen::Vector3i& measurement_idx,
                            std::vector<RayElement>& ray);
 
+    /**
+     * Computes the rays from a common origin to all measurements, each ray is the same as the
+     * one of the corresponding computeRay call with the same origin and origin_idx.
+     * The terms depending on the origin are computed once and the rays are written into
+     * one flat buffer, see RayBuffer.
+     */
+    static void computeRays(const Eigen::Vector3d& grid_res, const Eigen::Vector3d& origin,
+                            const Eigen::Vector3i& origin_idx, const Eigen::Vector3d* measurements,
+                            size_t num_measurements, RayBuffer& rays);
+
 };
 
 
@@ -0,0 +1,169 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE GridTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/DenseColumn.hpp>
+#include <maps/grid/DiscreteTree.hpp>
+#include <maps/grid/VoxelGridMap.hpp>
+#include <maps/grid/OccupancyPatch.hpp>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+using namespace maps::grid;
+
+BOOST_AUTO_TEST_CASE(test_dense_column_access)
+{
+    DenseColumn<float> column(0.5);
+    DiscreteTree<float> tree(0.5);
+    BOOST_CHECK(column.empty());
+    BOOST_CHECK(column.begin() == column.end());
+
+    // grow at both ends with gaps in between
+    const int32_t indices[] = {3, 4, 5, -2, 20, 7, -30, 4, 0};
+    for(int32_t idx : indices)
+    {
+        column.getCellAt(idx) += idx;
+        tree.getCellAt(idx) += idx;
+    }
+
+    BOOST_CHECK_EQUAL(column.size(), tree.size());
+    DiscreteTree<float>::const_iterator tree_it = tree.begin();
+    for(DenseColumn<float>::const_iterator it = column.begin(); it != column.end(); ++it, ++tree_it)
+    {
+        BOOST_CHECK_EQUAL(it->first, tree_it->first);
+        BOOST_CHECK_EQUAL(it->second, tree_it->second);
+    }
+    BOOST_CHECK(tree_it == tree.end());
+
+    BOOST_CHECK(column.hasCell(-30));
+    BOOST_CHECK(!column.hasCell(-29));
+    BOOST_CHECK(!column.hasCell(100));
+    BOOST_CHECK(column.hasCell(2.1f));
+    BOOST_CHECK_EQUAL(column.getCellAt(4), 8.f);
+    BOOST_CHECK_EQUAL(column[10.2f], 20.f);
+    BOOST_CHECK(column.find(6) == column.end());
+
+    const DenseColumn<float>& const_column = column;
+    BOOST_CHECK_EQUAL(const_column.getCellAt(-2), -2.f);
+    BOOST_CHECK_THROW(const_column.getCellAt(6), std::out_of_range);
+
+    // reserving doesn't create cells
+    column.reserve(-100, 100);
+    BOOST_CHECK_EQUAL(column.size(), tree.size());
+    BOOST_CHECK(!column.hasCell(50));
+
+    DenseColumn<float> copy = column;
+    BOOST_CHECK(copy == column);
+    copy.getCellAt(50) = 1.f;
+    BOOST_CHECK(copy != column);
+
+    column.clear();
+    BOOST_CHECK(column.empty());
+    BOOST_CHECK(!column.hasCell(3));
+}
+
+BOOST_AUTO_TEST_CASE(test_dense_voxel_grid_map)
+{
+    typedef VoxelGridMap<OccupancyPatch, DenseColumn<OccupancyPatch> > DenseVoxelMap;
+    DenseVoxelMap map(Vector2ui(10, 10), Eigen::Vector3d(0.1, 0.1, 0.1));
+
+    Eigen::Vector3d position(0.55, 0.25, -0.33);
+    Eigen::Vector3i idx;
+    BOOST_REQUIRE(map.toVoxelGrid(position, idx));
+    BOOST_CHECK(!map.hasVoxelCell(idx));
+    map.getVoxelCell(idx).updateLogOdds(1.f);
+    BOOST_CHECK(map.hasVoxelCell(idx));
+    BOOST_CHECK(map.hasVoxelCell(position));
+    BOOST_CHECK_EQUAL(map.getVoxelCell(position).getLogOdds(), 1.f);
+
+    // fill a ray span
+    DenseVoxelMap::ColumnType& column = map.at(Index(2, 3));
+    column.reserve(-10, 10);
+    for(int32_t z = -10; z <= 10; ++z)
+        column.getCellAt(z).updateLogOdds(-0.5f);
+    BOOST_CHECK_EQUAL(column.size(), 21);
+
+    std::stringstream stream;
+    boost::archive::binary_oarchive oa(stream);
+    oa << map;
+
+    DenseVoxelMap map_out(Vector2ui(1, 1), Eigen::Vector3d(1.0, 1.0, 1.0));
+    boost::archive::binary_iarchive ia(stream);
+    ia >> map_out;
+
+    BOOST_CHECK_EQUAL(map_out.getNumCells(), map.getNumCells());
+    BOOST_CHECK(map_out.getVoxelResolution().isApprox(map.getVoxelResolution()));
+    BOOST_CHECK_EQUAL(map_out.getVoxelCell(idx).getLogOdds(), 1.f);
+    const DenseVoxelMap::ColumnType& column_out = map_out.at(Index(2, 3));
+    BOOST_CHECK_EQUAL(column_out.size(), 21);
+    for(DenseVoxelMap::ColumnType::const_iterator it = column_out.begin(); it != column_out.end(); ++it)
+        BOOST_CHECK_EQUAL(it->second.getLogOdds(), -0.5f);
+}
+
+BOOST_AUTO_TEST_CASE(test_update_range)
+{
+    DenseColumn<float> column(0.1);
+    DiscreteTree<float> tree(0.1);
+    DiscreteTree<float> reference(0.1);
+
+    // existing cells within and around the ranges
+    const int32_t existing[] = {-7, -3, 0, 2, 12};
+    for(int32_t idx : existing)
+    {
+        column.getCellAt(idx) = 100.f;
+        tree.getCellAt(idx) = 100.f;
+        reference.getCellAt(idx) = 100.f;
+    }
+
+    const std::pair<int32_t, int32_t> ranges[] = {{-5, 3}, {3, -5}, {10, 10}, {15, 11}, {-3, -3}};
+    for(const std::pair<int32_t, int32_t>& range : ranges)
+    {
+        std::vector<int32_t> visited;
+        auto update = [&](int32_t idx, float& cell) { cell += idx; visited.push_back(idx); };
+        tree.updateRange(range.first, range.second, update);
+        std::vector<int32_t> tree_visited;
+        tree_visited.swap(visited);
+        column.updateRange(range.first, range.second, update);
+        BOOST_CHECK(tree_visited == visited);
+
+        const int32_t z_min = std::min(range.first, range.second);
+        const int32_t z_max = std::max(range.first, range.second);
+        BOOST_REQUIRE_EQUAL(visited.size(), z_max - z_min + 1);
+        for(int32_t idx = z_min; idx <= z_max; ++idx)
+        {
+            BOOST_CHECK_EQUAL(visited[idx - z_min], idx);
+            reference.getCellAt(idx) += idx;
+        }
+    }
+
+    BOOST_CHECK(tree == reference);
+    BOOST_CHECK_EQUAL(column.size(), reference.size());
+    for(DiscreteTree<float>::const_iterator it = reference.begin(); it != reference.end(); ++it)
+        BOOST_CHECK_EQUAL(column.getCellAt(it->first), it->second);
+}
@@ -1501,3 +1501,95 @@ BOOST_AUTO_TEST_CASE(test_to_from_grid)
         }
     }
 }
+
+BOOST_AUTO_TEST_CASE(test_dirty_tracking)
+{
+    GridMap<double> grid_map(Vector2ui(100, 50), Vector2d(0.1, 0.1), -1.);
+
+    // disabled by default
+    grid_map.markDirty(Index(3, 4));
+    BOOST_CHECK(!grid_map.isDirtyTrackingEnabled());
+    BOOST_CHECK(grid_map.getDirtyExtents().isEmpty());
+
+    // newly enabled tracking reports all cells
+    grid_map.setDirtyTracking(true);
+    BOOST_CHECK_EQUAL(grid_map.getDirtyExtents().max(), Vector2ui(99, 49));
+    grid_map.resetDirty();
+    BOOST_CHECK(grid_map.getDirtyExtents().isEmpty());
+
+    grid_map.markDirty(Index(3, 4));
+    grid_map.markDirty(Index(70, 20));
+    grid_map.markDirty(Index(3, 4));
+    BOOST_CHECK_EQUAL(grid_map.getDirtyExtents().min(), Vector2ui(3, 4));
+    BOOST_CHECK_EQUAL(grid_map.getDirtyExtents().max(), Vector2ui(70, 20));
+    BOOST_CHECK(grid_map.isDirty(Index(70, 20)));
+    BOOST_CHECK(!grid_map.isDirty(Index(4, 4)));
+
+    std::vector<Index> dirty;
+    grid_map.forEachDirtyCell([&](const Index& idx) { dirty.push_back(idx); });
+    BOOST_REQUIRE_EQUAL(dirty.size(), 2);
+    BOOST_CHECK_EQUAL(dirty[0], Index(3, 4));
+    BOOST_CHECK_EQUAL(dirty[1], Index(70, 20));
+
+    // moving the content changes all cells
+    grid_map.resetDirty();
+    grid_map.moveBy(Index(2, 0));
+    BOOST_CHECK_EQUAL(grid_map.getDirtyExtents().min(), Vector2ui(0, 0));
+    BOOST_CHECK_EQUAL(grid_map.getDirtyExtents().max(), Vector2ui(99, 49));
+    size_t count = 0;
+    grid_map.forEachDirtyCell([&](const Index&) { count++; });
+    BOOST_CHECK_EQUAL(count, grid_map.getNumElements());
+
+    // so does resizing
+    grid_map.resetDirty();
+    grid_map.extend(Vector2ui(120, 50));
+    BOOST_CHECK_EQUAL(grid_map.getDirtyExtents().max(), Vector2ui(119, 49));
+    grid_map.resetDirty();
+    grid_map.markDirty(Index(110, 10));
+    BOOST_CHECK_EQUAL(grid_map.getDirtyExtents().min(), Vector2ui(110, 10));
+}
+
+BOOST_AUTO_TEST_CASE(test_consecutive_deltas)
+{
+    GridMap<double> grid_map(Vector2ui(20, 10), Vector2d(0.1, 0.1), -1.);
+    GridMap<double> copy(grid_map);
+    grid_map.setDirtyTracking(true);
+    grid_map.setRevision(0);
+
+    grid_map.at(Index(3, 4)) = 2.;
+    grid_map.markDirty(Index(3, 4));
+    GridDelta<double> first = grid_map.createDelta();
+    BOOST_CHECK_EQUAL(first.size(), 1);
+
+    // creating a delta doesn't touch the dirty cells and vice versa
+    BOOST_CHECK(grid_map.isDirty(Index(3, 4)));
+    BOOST_CHECK(grid_map.isDirty(Index(0, 0)));
+    grid_map.resetDirty();
+
+    // the second delta only contains the changes after the first one
+    grid_map.at(Index(7, 1)) = 5.;
+    grid_map.markDirty(Index(7, 1));
+    GridDelta<double> second = grid_map.createDelta();
+    BOOST_REQUIRE_EQUAL(second.size(), 1);
+    BOOST_CHECK_EQUAL(second.indices[0], Index(7, 1));
+    BOOST_CHECK_EQUAL(second.base_revision, first.revision);
+    BOOST_CHECK_EQUAL(grid_map.getRevision(), 2);
+
+    copy.applyDelta(first);
+    copy.applyDelta(second);
+    BOOST_CHECK(std::equal(grid_map.begin(), grid_map.end(), copy.begin()));
+
+    BOOST_CHECK(grid_map.isDirty(Index(7, 1)));
+    BOOST_CHECK(!grid_map.isDirty(Index(3, 4)));
+
+    // without changes the delta is empty
+    BOOST_CHECK_EQUAL(grid_map.createDelta().size(), 0);
+
+    // deltas with cells outside of the map are rejected
+    grid_map.at(Index(2, 2)) = 1.;
+    grid_map.markDirty(Index(2, 2));
+    GridDelta<double> corrupt = grid_map.createDelta();
+    corrupt.indices[0] = Index(20, 2);
+    BOOST_CHECK_THROW(copy.applyDelta(corrupt), std::runtime_error);
+    BOOST_CHECK_EQUAL(copy.getRevision(), 2);
+}
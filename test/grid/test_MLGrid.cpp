@@ -33,6 +33,7 @@
 #include <maps/grid/VectorGridAccess.hpp>
 #include <maps/grid/GridFacade.hpp>
 #include <maps/grid/LevelList.hpp>
+#include <maps/tools/ParallelFor.hpp>
 
 using namespace ::maps::grid;
 class PatchBase
@@ -341,3 +342,115 @@ BOOST_AUTO_TEST_CASE(test_mapAccess2)
 }*/
 
 
+
+BOOST_AUTO_TEST_CASE(test_arena_allocator)
+{
+    typedef MultiLevelGridMap<int, ArenaAllocator<int> > ArenaGrid;
+    ArenaGrid grid(Vector2ui(20, 20), Eigen::Vector2d(0.1, 0.1));
+    const boost::shared_ptr<MemoryArena> arena = grid.getDefaultValue().get_allocator().getArena();
+    BOOST_CHECK_EQUAL(arena->getNumAllocations(), 0);
+
+    for(unsigned y = 0; y < 20; ++y)
+    {
+        for(unsigned x = 0; x < 20; ++x)
+        {
+            for(int i = 0; i < int(x % 5); ++i)
+                grid.at(Index(x, y)).insert(i);
+        }
+    }
+
+    // all cells take their memory from the arena of the map
+    BOOST_CHECK(grid.at(Index(3, 3)).get_allocator() == grid.getDefaultValue().get_allocator());
+    BOOST_CHECK_EQUAL(arena->getNumAllocations(), 20 * 16);
+    BOOST_CHECK_EQUAL(grid.at(Index(4, 7)).size(), 4);
+    BOOST_CHECK_EQUAL(*grid.at(Index(4, 7)).rbegin(), 3);
+
+    // a converted map gets its own arena
+    MultiLevelGridMap<int> converted(grid);
+    ArenaGrid converted_back(converted);
+    BOOST_CHECK(converted_back.at(Index(3, 3)).get_allocator() != grid.at(Index(3, 3)).get_allocator());
+    BOOST_CHECK(std::equal(converted.at(Index(4, 7)).begin(), converted.at(Index(4, 7)).end(),
+                           converted_back.at(Index(4, 7)).begin()));
+
+    // a converted map can take the arena of another map
+    ArenaGrid converted_shared(converted, grid.getDefaultValue().get_allocator());
+    BOOST_CHECK(converted_shared.at(Index(3, 3)).get_allocator() == grid.getDefaultValue().get_allocator());
+    BOOST_CHECK(converted_shared.getDefaultValue().get_allocator() == grid.getDefaultValue().get_allocator());
+    converted_shared.clear();
+
+    grid.setDirtyTracking(true);
+    grid.resetDirty();
+    grid.clear();
+    BOOST_CHECK(grid.at(Index(4, 7)).empty());
+    BOOST_CHECK(grid.at(Index(4, 7)).get_allocator() == grid.getDefaultValue().get_allocator());
+    BOOST_CHECK(grid.isDirty(Index(4, 7)));
+    BOOST_CHECK_EQUAL(arena->getNumAllocations(), 0);
+    BOOST_CHECK(arena->getReservedBytes() <= 64 * 1024);
+
+    // a default constructed allocator has no arena, so default constructed cells don't allocate one
+    BOOST_CHECK(!ArenaAllocator<int>().getArena());
+    BOOST_CHECK(!ArenaGrid::CellType().get_allocator().getArena());
+}
+
+BOOST_AUTO_TEST_CASE(test_arena_allocator_parallel)
+{
+    typedef MultiLevelGridMap<int, ArenaAllocator<int> > ArenaGrid;
+    ArenaGrid grid(Vector2ui(64, 64), Eigen::Vector2d(0.1, 0.1));
+    const boost::shared_ptr<MemoryArena> arena = grid.getDefaultValue().get_allocator().getArena();
+
+    // rows are filled and shrunk by different threads
+    maps::tools::parallelFor(0, 64, [&grid](size_t y)
+    {
+        for(unsigned x = 0; x < 64; ++x)
+        {
+            for(int i = 0; i < int(x % 7) + 1; ++i)
+                grid.at(Index(x, y)).insert(i);
+        }
+        for(unsigned x = 0; x < 64; x += 2)
+        {
+            grid.at(Index(x, y)).clear();
+            grid.at(Index(x, y)).shrink_to_fit();
+        }
+    }, 4, 1);
+    BOOST_CHECK_EQUAL(arena->getNumAllocations(), 64 * 32);
+    BOOST_CHECK_EQUAL(grid.at(Index(5, 9)).size(), 6);
+    BOOST_CHECK(!arena->release());
+
+    grid.clear();
+    BOOST_CHECK_EQUAL(arena->getNumAllocations(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_clear_delta)
+{
+    MultiLevelGridMap<int> grid(Vector2ui(10, 10), Eigen::Vector2d(0.1, 0.1));
+    grid.at(Index(2, 3)).insert(5);
+    MultiLevelGridMap<int> copy(grid);
+
+    grid.setDirtyTracking(true);
+    grid.setRevision(0);
+    grid.clear();
+
+    // the delta of a cleared map resets the cells of the copy
+    copy.applyDelta(grid.createDelta());
+    BOOST_CHECK(copy.at(Index(2, 3)).empty());
+}
+
+#if BOOST_VERSION >= 106600
+BOOST_AUTO_TEST_CASE(test_small_arena_container)
+{
+    MultiLevelGridMap<int, SmallArenaContainer<int> > grid(Vector2ui(10, 10), Eigen::Vector2d(0.1, 0.1));
+    const boost::shared_ptr<MemoryArena> arena = grid.getDefaultValue().get_allocator().getArena();
+
+    // up to two elements are stored inline
+    grid.at(Index(1, 1)).insert(1);
+    grid.at(Index(1, 1)).insert(2);
+    BOOST_CHECK_EQUAL(arena->getNumAllocations(), 0);
+
+    grid.at(Index(1, 1)).insert(3);
+    BOOST_CHECK_EQUAL(arena->getNumAllocations(), 1);
+    BOOST_CHECK_EQUAL(grid.at(Index(1, 1)).size(), 3);
+
+    grid.clear();
+    BOOST_CHECK_EQUAL(arena->getNumAllocations(), 0);
+}
+#endif
@@ -0,0 +1,202 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE MLSMapTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/MLSMap.hpp>
+#include <maps/grid/CompactMLSMap.hpp>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <cstring>
+#include <sstream>
+
+using namespace ::maps::grid;
+
+static PointCloud generateCloud(size_t num_points, double extent)
+{
+    PointCloud pc;
+    srand(42);
+    for(size_t i = 0; i < num_points; ++i)
+    {
+        double x = extent * (double(rand()) / RAND_MAX - 0.5);
+        double y = extent * (double(rand()) / RAND_MAX - 0.5);
+        double z = 0.1 * std::sin(x) * std::cos(y) + 0.01 * double(rand()) / RAND_MAX;
+        // add a second layer on some points
+        if(i % 7 == 0)
+            z += 2.0;
+        pc.push_back(pcl::PointXYZ(x, y, z));
+    }
+    return pc;
+}
+
+template<MLSConfig::update_model SurfaceType>
+static void checkBatchedMerge(const MLSConfig& config)
+{
+    MLSMap<SurfaceType> mls_serial(Vector2ui(100, 100), Vector2d(0.1, 0.1), config);
+    mls_serial.getLocalFrame().translation() << 0.5 * mls_serial.getSize(), 0;
+    MLSMap<SurfaceType> mls_batched(mls_serial);
+
+    // the cloud is larger than the map, so some of the points are outside of the grid
+    PointCloud pc = generateCloud(20000, 10.4);
+    base::Transform3d pc2mls = base::Transform3d::Identity();
+    pc2mls.translation() << 0.3, -0.2, 0.1;
+
+    MergeStatistics serial_stats = mls_serial.mergePointCloud(pc, pc2mls);
+    MergeStatistics batched_stats = mls_batched.mergePointCloudBatched(pc, pc2mls, 0.01, 4);
+
+    BOOST_CHECK_EQUAL(serial_stats.getTotal(), pc.size());
+    BOOST_CHECK_GT(serial_stats.outside_grid, 0);
+    BOOST_CHECK_EQUAL(serial_stats.merged, batched_stats.merged);
+    BOOST_CHECK_EQUAL(serial_stats.outside_grid, batched_stats.outside_grid);
+
+    for(size_t y = 0; y < mls_serial.getNumCells().y(); ++y)
+    {
+        for(size_t x = 0; x < mls_serial.getNumCells().x(); ++x)
+        {
+            const typename MLSMap<SurfaceType>::CellType& serial = mls_serial.at(x, y);
+            const typename MLSMap<SurfaceType>::CellType& batched = mls_batched.at(x, y);
+            BOOST_REQUIRE_EQUAL(serial.size(), batched.size());
+            BOOST_CHECK(std::equal(serial.begin(), serial.end(), batched.begin()));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_batched_merge_kalman)
+{
+    MLSConfig config;
+    config.updateModel = MLSConfig::KALMAN;
+    checkBatchedMerge<MLSConfig::KALMAN>(config);
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_batched_merge_slope)
+{
+    MLSConfig config;
+    config.updateModel = MLSConfig::SLOPE;
+    checkBatchedMerge<MLSConfig::SLOPE>(config);
+}
+
+BOOST_AUTO_TEST_CASE(test_compact_mls)
+{
+    MLSConfig config;
+    config.updateModel = MLSConfig::KALMAN;
+    MLSMapKalman mls(Vector2ui(100, 100), Vector2d(0.1, 0.1), config);
+    mls.getLocalFrame().translation() << 0.5 * mls.getSize(), 0;
+    mls.mergePointCloud(generateCloud(20000, 10.4), base::Transform3d::Identity());
+
+    CompactMLSMapKalman compact(mls);
+    MLSTopPatchView view = compact.getTopPatchView();
+    MLSTopPatchView mls_view = MLSTopPatchView::fromMLS(mls);
+
+    size_t num_patches = 0;
+    for(size_t y = 0; y < mls.getNumCells().y(); ++y)
+    {
+        for(size_t x = 0; x < mls.getNumCells().x(); ++x)
+        {
+            const MLSMapKalman::CellType& cell = mls.at(x, y);
+            CompactMLSMapKalman::PatchRange range = compact.at(x, y);
+            BOOST_REQUIRE_EQUAL(cell.size(), range.size());
+            BOOST_CHECK(std::equal(cell.begin(), cell.end(), range.begin()));
+            num_patches += cell.size();
+
+            const size_t idx = view.toIdx(x, y);
+            BOOST_REQUIRE_EQUAL(view.hasPatch(x, y), !cell.empty());
+            if(cell.empty())
+                continue;
+            MLSMapKalman::CellType::const_iterator top = std::max_element(cell.begin(), cell.end());
+            BOOST_CHECK_EQUAL(compact.getTopPatch(Index(x, y))->getMean(), top->getMean());
+            BOOST_CHECK_EQUAL(view.mean[idx], top->getMean());
+            BOOST_CHECK_EQUAL(view.stddev[idx], top->getStandardDeviation());
+            BOOST_CHECK_EQUAL(mls_view.mean[idx], view.mean[idx]);
+            BOOST_CHECK_EQUAL(mls_view.stddev[idx], view.stddev[idx]);
+        }
+    }
+    BOOST_CHECK_EQUAL(compact.getNumPatches(), num_patches);
+    BOOST_CHECK_THROW(compact.at(100, 0), std::runtime_error);
+
+    // conversion back to a MLSMap
+    MLSMapKalman restored = compact.toMLSMap();
+    BOOST_CHECK(restored.getLocalFrame().isApprox(mls.getLocalFrame()));
+    BOOST_CHECK(std::equal(mls.begin(), mls.end(), restored.begin()));
+
+    // serialization
+    std::stringstream stream;
+    {
+        boost::archive::binary_oarchive oa(stream);
+        oa << compact;
+    }
+    CompactMLSMapKalman loaded;
+    boost::archive::binary_iarchive ia(stream);
+    ia >> loaded;
+    BOOST_CHECK_EQUAL(loaded.getNumCells(), compact.getNumCells());
+    BOOST_CHECK(loaded.getCellOffsets() == compact.getCellOffsets());
+    BOOST_CHECK(loaded.getPatches() == compact.getPatches());
+
+    // offsets pointing behind the patches are rejected
+    std::string archive = stream.str();
+    const uint32_t last_offset = compact.getNumPatches();
+    const uint32_t corrupt_offset = last_offset + 1;
+    BOOST_REQUIRE_GE(archive.size(), sizeof(last_offset));
+    BOOST_REQUIRE(std::memcmp(&archive[archive.size() - sizeof(last_offset)], &last_offset, sizeof(last_offset)) == 0);
+    std::memcpy(&archive[archive.size() - sizeof(corrupt_offset)], &corrupt_offset, sizeof(corrupt_offset));
+    std::stringstream corrupt_stream(archive);
+    boost::archive::binary_iarchive corrupt_ia(corrupt_stream);
+    CompactMLSMapKalman corrupt;
+    BOOST_CHECK_THROW(corrupt_ia >> corrupt, std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_dirty_tracking)
+{
+    MLSMapKalman mls(Vector2ui(100, 100), Vector2d(0.1, 0.1), MLSConfig());
+    mls.setDirtyTracking(true);
+    mls.resetDirty();
+
+    mls.mergePatch(Index(10, 20), MLSMapKalman::Patch(1.f, 0.1f));
+    mls.mergePatch(Index(15, 12), MLSMapKalman::Patch(1.f, 0.1f));
+    BOOST_CHECK_EQUAL(mls.getDirtyExtents().min(), Vector2ui(10, 12));
+    BOOST_CHECK_EQUAL(mls.getDirtyExtents().max(), Vector2ui(15, 20));
+    mls.resetDirty();
+
+    // the batched merge marks exactly the cells which received points
+    PointCloud pc = generateCloud(2000, 3.0);
+    base::Transform3d pc2mls = base::Transform3d::Identity();
+    pc2mls.translation() << 5., 5., 0.;
+    mls.mergePointCloudBatched(pc, pc2mls, 0.01, 4);
+    size_t num_dirty = 0;
+    mls.forEachDirtyCell([&](const Index& idx)
+    {
+        BOOST_CHECK(!mls.at(idx).empty());
+        num_dirty++;
+    });
+    size_t num_filled = 0;
+    for(const MLSMapKalman::CellType& cell : mls)
+        num_filled += !cell.empty();
+    BOOST_CHECK_GT(num_dirty, 0);
+    // the two patches merged before the reset are not dirty anymore
+    BOOST_CHECK_EQUAL(num_dirty + 2, num_filled);
+}
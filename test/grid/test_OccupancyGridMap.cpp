@@ -0,0 +1,310 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE GridTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/OccupancyGridMap.hpp>
+
+#include <type_traits>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/shared_ptr.hpp>
+
+using namespace maps::grid;
+
+namespace
+{
+    std::vector<Eigen::Vector3d> generateMeasurements(size_t num_points)
+    {
+        std::vector<Eigen::Vector3d> points;
+        for(size_t i = 0; i < num_points; ++i)
+        {
+            double angle = 2.0 * M_PI * i / num_points;
+            double range = 2.0 + 1.5 * std::sin(7.0 * angle);
+            points.push_back(Eigen::Vector3d(range * std::cos(angle), range * std::sin(angle), -0.5 + 0.1 * (i % 13)));
+        }
+        // points outside of the grid
+        points.push_back(Eigen::Vector3d(20.0, 0.0, 0.0));
+        points.push_back(Eigen::Vector3d(0.0, -20.0, 0.0));
+        return points;
+    }
+
+    template<class MapA, class MapB>
+    void checkEqual(const MapA& map, const MapB& other)
+    {
+        for(size_t y = 0; y < map.getNumCells().y(); ++y)
+        {
+            for(size_t x = 0; x < map.getNumCells().x(); ++x)
+            {
+                const typename MapA::ColumnType& tree = map.at(Index(x, y));
+                const typename MapB::ColumnType& other_tree = other.at(Index(x, y));
+                BOOST_REQUIRE_EQUAL(tree.size(), other_tree.size());
+                typename MapA::ColumnType::const_iterator it = tree.begin();
+                typename MapB::ColumnType::const_iterator other_it = other_tree.begin();
+                for(; it != tree.end(); ++it, ++other_it)
+                {
+                    BOOST_REQUIRE_EQUAL(it->first, other_it->first);
+                    BOOST_REQUIRE_EQUAL(it->second.getLogOdds(), other_it->second.getLogOdds());
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_ray_integration)
+{
+    base::Transform3d pc2grid = base::Transform3d::Identity();
+    pc2grid.translation() << 5.0, 5.0, 2.0;
+    std::vector<Eigen::Vector3d> points = generateMeasurements(5000);
+
+    OccupancyGridMap serial_map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), OccupancyConfiguration());
+    OccupancyGridMap parallel_map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), OccupancyConfiguration());
+    parallel_map.setDirtyTracking(true);
+    parallel_map.resetDirty();
+
+    // merge twice to saturate some of the cells at the log-odds limits
+    for(int i = 0; i < 2; ++i)
+    {
+        MergeStatistics serial_stats = serial_map.mergePointCloud(points, pc2grid);
+        MergeStatistics parallel_stats = parallel_map.mergePointCloudParallel(points, pc2grid, base::Vector3d::Zero(), 4);
+        BOOST_CHECK_EQUAL(serial_stats.merged, parallel_stats.merged);
+        BOOST_CHECK_EQUAL(serial_stats.outside_grid, parallel_stats.outside_grid);
+        BOOST_CHECK_EQUAL(parallel_stats.outside_grid, 2);
+    }
+
+    checkEqual(serial_map, parallel_map);
+    BOOST_CHECK(parallel_map.isDirty(Index(50, 50)));
+    BOOST_CHECK(!parallel_map.isDirty(Index(0, 0)));
+
+    // sensor origin outside of the grid
+    base::Transform3d outside = base::Transform3d::Identity();
+    outside.translation() << -5.0, 5.0, 2.0;
+    MergeStatistics stats = parallel_map.mergePointCloudParallel(points, outside, base::Vector3d::Zero(), 4);
+    BOOST_CHECK_EQUAL(stats.merged, 0);
+    BOOST_CHECK_EQUAL(stats.outside_grid, points.size());
+}
+
+BOOST_AUTO_TEST_CASE(test_coalesced_ray_integration)
+{
+    base::Transform3d pc2grid = base::Transform3d::Identity();
+    pc2grid.translation() << 5.0, 5.0, 2.0;
+    std::vector<Eigen::Vector3d> points = generateMeasurements(5000);
+    OccupancyConfiguration config;
+
+    OccupancyGridMap serial_map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), config);
+    OccupancyGridMap coalesced_map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), config);
+
+    MergeStatistics serial_stats = serial_map.mergePointCloud(points, pc2grid);
+    MergeStatistics coalesced_stats = coalesced_map.mergePointCloud(points, pc2grid, base::Vector3d::Zero(), true);
+    BOOST_CHECK_EQUAL(serial_stats.merged, coalesced_stats.merged);
+    BOOST_CHECK_EQUAL(serial_stats.outside_grid, coalesced_stats.outside_grid);
+
+    // the same voxels are touched, but every voxel is updated exactly once
+    size_t num_occupied = 0;
+    for(size_t y = 0; y < serial_map.getNumCells().y(); ++y)
+    {
+        for(size_t x = 0; x < serial_map.getNumCells().x(); ++x)
+        {
+            const DiscreteTree<OccupancyPatch>& tree = serial_map.at(Index(x, y));
+            const DiscreteTree<OccupancyPatch>& coalesced_tree = coalesced_map.at(Index(x, y));
+            BOOST_REQUIRE_EQUAL(tree.size(), coalesced_tree.size());
+            for(DiscreteTree<OccupancyPatch>::const_iterator it = coalesced_tree.begin(); it != coalesced_tree.end(); ++it)
+            {
+                float log_odds = it->second.getLogOdds();
+                BOOST_REQUIRE(log_odds == config.hit_logodds || log_odds == config.miss_logodds);
+                if(log_odds == config.hit_logodds)
+                    num_occupied++;
+            }
+        }
+    }
+    BOOST_CHECK_GT(num_occupied, 0);
+
+    // occupied wins against the misses of other rays
+    for(const Eigen::Vector3d& point : points)
+    {
+        Eigen::Vector3d point_in_grid = pc2grid * point;
+        Eigen::Vector3i idx;
+        if(coalesced_map.toVoxelGrid(point_in_grid, idx))
+            BOOST_CHECK_EQUAL(coalesced_map.getVoxelCell(idx).getLogOdds(), config.hit_logodds);
+    }
+
+    // the result is independent of the number of threads
+    OccupancyGridMap single_thread_map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), config);
+    single_thread_map.mergePointCloud(points, pc2grid, base::Vector3d::Zero(), true, 1);
+    checkEqual(single_thread_map, coalesced_map);
+}
+
+BOOST_AUTO_TEST_CASE(test_ray_integration_context)
+{
+    std::vector<Eigen::Vector3d> points = generateMeasurements(2000);
+    OccupancyGridMap::PointCloud pc;
+    for(const Eigen::Vector3d& point : points)
+        pc.push_back(pcl::PointXYZ(point.x(), point.y(), point.z()));
+
+    OccupancyGridMap map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), OccupancyConfiguration());
+    OccupancyGridMap context_map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), OccupancyConfiguration());
+
+    // the context is reused for clouds from different sensor poses
+    RayIntegrationContext context;
+    for(int i = 0; i < 2; ++i)
+    {
+        base::Transform3d pc2grid = base::Transform3d::Identity();
+        pc2grid.translation() << 5.0 - 0.5 * i, 5.0, 2.0;
+        MergeStatistics stats = context_map.mergePointCloud(pc, pc2grid, context);
+        BOOST_CHECK_EQUAL(stats.merged, points.size() - 2);
+        BOOST_CHECK_EQUAL(stats.outside_grid, 2);
+        BOOST_CHECK(context.sensor_origin.isApprox(pc2grid.translation()));
+
+        for(const pcl::PointXYZ& point : pc.points)
+            map.tryMergePoint(pc2grid.translation(), pc2grid * Eigen::Vector3d(point.getArray3fMap().cast<double>()));
+    }
+    BOOST_CHECK_GT(context.ray.capacity(), 0);
+    checkEqual(map, context_map);
+
+    // single points merged with the context, the points are given in the frame of the last cloud
+    const base::Transform3d pc2grid = context.pc2grid;
+    for(size_t i = 0; i < 100; ++i)
+    {
+        context_map.mergePoint(context, points[i]);
+        map.mergePoint(pc2grid.translation(), pc2grid * points[i]);
+    }
+    checkEqual(map, context_map);
+    BOOST_CHECK_THROW(context_map.mergePoint(context, points.back()), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_quantized_occupancy_patch)
+{
+    BOOST_CHECK(std::is_trivially_copyable<QuantizedOccupancyPatch>::value);
+    BOOST_CHECK_EQUAL(sizeof(QuantizedOccupancyPatch), 2);
+    BOOST_CHECK_LE(3 * sizeof(std::pair<int32_t, QuantizedOccupancyPatch>), sizeof(std::pair<int32_t, OccupancyPatch>));
+
+    OccupancyConfiguration config;
+    QuantizedOccupancyPatch patch;
+    BOOST_CHECK_EQUAL(patch.getLogOdds(), 0.f);
+    for(int i = 0; i < 100; ++i)
+        patch.updateLogOdds(config.hit_logodds, config.min_logodds, config.max_logodds);
+    BOOST_CHECK_EQUAL(patch.getQuantizedLogOdds(), QuantizedOccupancyPatch::quantize(config.max_logodds));
+    BOOST_CHECK_CLOSE(patch.getLogOdds(), config.max_logodds, 0.1);
+    for(int i = 0; i < 100; ++i)
+        patch.updateLogOdds(config.miss_logodds, config.min_logodds, config.max_logodds);
+    BOOST_CHECK_EQUAL(patch.getQuantizedLogOdds(), QuantizedOccupancyPatch::quantize(config.min_logodds));
+    BOOST_CHECK_CLOSE(QuantizedOccupancyPatch(0.7).getPropability(), 0.7, 0.1);
+
+    // saturation of the fixed-point range
+    BOOST_CHECK_EQUAL(QuantizedOccupancyPatch::quantize(100.f), INT16_MAX);
+    BOOST_CHECK_EQUAL(QuantizedOccupancyPatch::quantize(-100.f), INT16_MIN);
+}
+
+BOOST_AUTO_TEST_CASE(test_quantized_occupancy_grid_map)
+{
+    base::Transform3d pc2grid = base::Transform3d::Identity();
+    pc2grid.translation() << 5.0, 5.0, 2.0;
+    std::vector<Eigen::Vector3d> points = generateMeasurements(5000);
+    OccupancyConfiguration config;
+
+    OccupancyGridMap map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), config);
+    QuantizedOccupancyGridMap quantized_map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), config);
+    QuantizedOccupancyGridMap serial_quantized_map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), config);
+    for(int i = 0; i < 3; ++i)
+    {
+        map.mergePointCloud(points, pc2grid);
+        quantized_map.mergePointCloudParallel(points, pc2grid, base::Vector3d::Zero(), 4);
+        serial_quantized_map.mergePointCloud(points, pc2grid);
+    }
+
+    // the pre-quantized updates are applied the same way by both implementations
+    checkEqual(serial_quantized_map, quantized_map);
+
+    // same voxels with log-odds within the quantization error, hence the same classification
+    for(size_t y = 0; y < map.getNumCells().y(); ++y)
+    {
+        for(size_t x = 0; x < map.getNumCells().x(); ++x)
+        {
+            const DiscreteTree<OccupancyPatch>& tree = map.at(Index(x, y));
+            const DiscreteTree<QuantizedOccupancyPatch>& quantized_tree = quantized_map.at(Index(x, y));
+            BOOST_REQUIRE_EQUAL(tree.size(), quantized_tree.size());
+            for(DiscreteTree<OccupancyPatch>::const_iterator it = tree.begin(); it != tree.end(); ++it)
+            {
+                BOOST_REQUIRE(quantized_tree.hasCell(it->first));
+                BOOST_CHECK_SMALL(it->second.getLogOdds() - quantized_tree.getCellAt(it->first).getLogOdds(), 0.05f);
+                float z = tree.getCellCenter(it->first);
+                BOOST_CHECK_EQUAL(map.isOccupied(Index(x, y), z), quantized_map.isOccupied(Index(x, y), z));
+                BOOST_CHECK_EQUAL(map.isFreeSpace(Index(x, y), z), quantized_map.isFreeSpace(Index(x, y), z));
+            }
+        }
+    }
+
+    std::stringstream stream;
+    boost::archive::binary_oarchive oa(stream);
+    oa << quantized_map;
+
+    QuantizedOccupancyGridMap map_out;
+    boost::archive::binary_iarchive ia(stream);
+    ia >> map_out;
+
+    BOOST_CHECK_EQUAL(map_out.getNumCells(), quantized_map.getNumCells());
+    BOOST_CHECK_EQUAL(map_out.getConfig().hit_logodds, config.hit_logodds);
+    BOOST_CHECK(map_out.at(Index(50, 50)) == quantized_map.at(Index(50, 50)));
+}
+
+BOOST_AUTO_TEST_CASE(test_dense_columns)
+{
+    base::Transform3d pc2grid = base::Transform3d::Identity();
+    pc2grid.translation() << 5.0, 5.0, 2.0;
+    std::vector<Eigen::Vector3d> points = generateMeasurements(3000);
+
+    OccupancyGridMap map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), OccupancyConfiguration());
+    DenseOccupancyGridMap dense_map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), OccupancyConfiguration());
+    DenseOccupancyGridMap dense_parallel_map(Vector2ui(100, 100), Eigen::Vector3d(0.1, 0.1, 0.1), OccupancyConfiguration());
+    map.mergePointCloud(points, pc2grid);
+    dense_map.mergePointCloud(points, pc2grid);
+    dense_parallel_map.mergePointCloudParallel(points, pc2grid, base::Vector3d::Zero(), 4);
+
+    checkEqual(map, dense_map);
+    checkEqual(map, dense_parallel_map);
+
+    for(size_t i = 0; i + 2 < points.size(); i += 100)
+    {
+        const Eigen::Vector3d point = pc2grid * (0.5 * points[i]);
+        BOOST_CHECK_EQUAL(dense_map.isOccupied(point), map.isOccupied(point));
+        BOOST_CHECK_EQUAL(dense_map.isFreeSpace(point), map.isFreeSpace(point));
+    }
+
+    // serializable as free space map of a MLSMap
+    boost::shared_ptr<OccupancyGridMapBase> free_space_map(new DenseOccupancyGridMap(dense_map));
+    std::stringstream stream;
+    {
+        boost::archive::binary_oarchive oa(stream);
+        oa << free_space_map;
+    }
+    boost::shared_ptr<OccupancyGridMapBase> map_out;
+    boost::archive::binary_iarchive ia(stream);
+    ia >> map_out;
+    boost::shared_ptr<DenseOccupancyGridMap> dense_map_out = boost::dynamic_pointer_cast<DenseOccupancyGridMap>(map_out);
+    BOOST_REQUIRE(dense_map_out);
+    checkEqual(map, *dense_map_out);
+}
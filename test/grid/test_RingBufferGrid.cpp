@@ -0,0 +1,188 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE GridTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/RingBufferGrid.hpp>
+#include <maps/grid/GridMap.hpp>
+#include <maps/grid/MLSMap.hpp>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <sstream>
+
+using namespace ::maps::grid;
+
+template <typename GridA, typename GridB>
+void checkEqual(const GridA& a, const GridB& b)
+{
+    BOOST_REQUIRE_EQUAL(a.getNumCells(), b.getNumCells());
+    for (unsigned int y = 0; y < a.getNumCells().y(); ++y)
+        for (unsigned int x = 0; x < a.getNumCells().x(); ++x)
+            BOOST_REQUIRE_EQUAL(a.at(x, y), b.at(x, y));
+    BOOST_CHECK(std::equal(a.begin(), a.end(), b.begin()));
+}
+
+BOOST_AUTO_TEST_CASE(test_move_matches_vector_grid)
+{
+    Vector2ui num_cells(7, 5);
+    VectorGrid<int> vector_grid(num_cells, -1);
+    RingBufferGrid<int> ring_grid(num_cells, -1);
+
+    srand(42);
+    for (int i = 0; i < 200; ++i)
+    {
+        for (int n = 0; n < 10; ++n)
+        {
+            Index idx(rand() % num_cells.x(), rand() % num_cells.y());
+            int value = rand() % 100;
+            vector_grid.at(idx) = value;
+            ring_grid.at(idx) = value;
+        }
+
+        Index offset(rand() % 17 - 8, rand() % 13 - 6);
+        vector_grid.moveBy(offset);
+        ring_grid.moveBy(offset);
+        checkEqual(vector_grid, ring_grid);
+    }
+
+    BOOST_CHECK_THROW(ring_grid.at(7, 0), std::runtime_error);
+    BOOST_CHECK_THROW(ring_grid.at(0, 5), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_resize)
+{
+    VectorGrid<int> vector_grid(Vector2ui(4, 3), 0);
+    RingBufferGrid<int> ring_grid(Vector2ui(4, 3), 0);
+    for (unsigned int y = 0; y < 3; ++y)
+        for (unsigned int x = 0; x < 4; ++x)
+            vector_grid.at(x, y) = ring_grid.at(x, y) = 1 + x + 10 * y;
+
+    vector_grid.moveBy(Index(1, -1));
+    ring_grid.moveBy(Index(1, -1));
+
+    ring_grid.resize(Vector2ui(6, 2));
+    BOOST_CHECK_EQUAL(ring_grid.getOrigin(), Vector2ui(0, 0));
+    for (unsigned int y = 0; y < 2; ++y)
+    {
+        for (unsigned int x = 0; x < 6; ++x)
+        {
+            int expected = x < 4 ? vector_grid.at(x, y) : 0;
+            BOOST_CHECK_EQUAL(ring_grid.at(x, y), expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_serialization)
+{
+    VectorGrid<int> vector_grid(Vector2ui(9, 6), 0);
+    RingBufferGrid<int> ring_grid(Vector2ui(9, 6), 0);
+    for (unsigned int i = 0; i < 20; ++i)
+    {
+        Index idx(rand() % 9, rand() % 6);
+        vector_grid.at(idx) = ring_grid.at(idx) = i + 1;
+    }
+    vector_grid.moveBy(Index(-3, 2));
+    ring_grid.moveBy(Index(-3, 2));
+
+    // the ring buffer uses the same format as the vector grid
+    std::stringstream ring_stream, vector_stream;
+    {
+        boost::archive::binary_oarchive oa(ring_stream);
+        oa << ring_grid;
+        boost::archive::binary_oarchive ov(vector_stream);
+        ov << vector_grid;
+    }
+    BOOST_CHECK_EQUAL(ring_stream.str(), vector_stream.str());
+
+    RingBufferGrid<int> loaded;
+    boost::archive::binary_iarchive ia(ring_stream);
+    ia >> loaded;
+    checkEqual(vector_grid, loaded);
+}
+
+BOOST_AUTO_TEST_CASE(test_grid_map)
+{
+    GridMap<double, VectorGrid<double> > vector_map(Vector2ui(20, 10), Vector2d(0.1, 0.1), -1.);
+    GridMap<double, RingBufferGrid<double> > ring_map(Vector2ui(20, 10), Vector2d(0.1, 0.1), -1.);
+
+    vector_map.at(Index(3, 4)) = ring_map.at(Index(3, 4)) = 2.;
+    vector_map.at(Vector3d(1.55, 0.25, 0.)) = ring_map.at(Vector3d(1.55, 0.25, 0.)) = 5.;
+
+    vector_map.moveBy(Index(4, 3));
+    ring_map.moveBy(Index(4, 3));
+    checkEqual(vector_map, ring_map);
+
+    CellExtents vector_extents = vector_map.calculateCellExtents();
+    CellExtents ring_extents = ring_map.calculateCellExtents();
+    BOOST_CHECK_EQUAL(vector_extents.min(), ring_extents.min());
+    BOOST_CHECK_EQUAL(vector_extents.max(), ring_extents.max());
+
+    BOOST_CHECK_EQUAL(ring_map.getMax(), 5.);
+    BOOST_CHECK_EQUAL(ring_map.getMin(false), 2.);
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_map)
+{
+    typedef MLSMap<MLSConfig::KALMAN, MLSMapKalman::allocator_type, RingBufferGrid<MLSMapKalman::CellType> > RingMLSMap;
+
+    MLSConfig config;
+    config.updateModel = MLSConfig::KALMAN;
+    MLSMapKalman vector_mls(Vector2ui(20, 10), Vector2d(0.1, 0.1), config);
+    RingMLSMap ring_mls(Vector2ui(20, 10), Vector2d(0.1, 0.1), config);
+
+    PointCloud pc;
+    for (int i = 0; i < 500; ++i)
+        pc.push_back(pcl::PointXYZ(0.004 * i, 0.002 * i, 0.1 * std::sin(0.05 * i)));
+    vector_mls.mergePointCloud(pc, base::Transform3d::Identity());
+    ring_mls.mergePointCloud(pc, base::Transform3d::Identity());
+
+    vector_mls.moveBy(Index(3, -2));
+    ring_mls.moveBy(Index(3, -2));
+
+    size_t num_patches = 0;
+    for (unsigned int y = 0; y < 10; ++y)
+    {
+        for (unsigned int x = 0; x < 20; ++x)
+        {
+            const MLSMapKalman::CellType& vector_cell = vector_mls.at(Index(x, y));
+            const RingMLSMap::CellType& ring_cell = ring_mls.at(Index(x, y));
+            BOOST_REQUIRE_EQUAL(vector_cell.size(), ring_cell.size());
+            for (MLSMapKalman::CellType::const_iterator a = vector_cell.begin(), b = ring_cell.begin(); a != vector_cell.end(); ++a, ++b)
+                BOOST_CHECK_EQUAL(a->getMean(), b->getMean());
+            num_patches += ring_cell.size();
+        }
+    }
+    BOOST_CHECK_GT(num_patches, 0);
+
+    // converting between the grid storages keeps the patches
+    MLSMapKalman converted(ring_mls);
+    for (unsigned int y = 0; y < 10; ++y)
+        for (unsigned int x = 0; x < 20; ++x)
+            BOOST_CHECK_EQUAL(converted.at(Index(x, y)).size(), vector_mls.at(Index(x, y)).size());
+}
@@ -0,0 +1,459 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE GridTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/TSDFVolumetricMap.hpp>
+
+#include <type_traits>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+using namespace maps::grid;
+
+namespace
+{
+    template<class MapT>
+    void fillMap(MapT& map)
+    {
+        Eigen::Vector3d sensor_origin(2.0, 2.0, 1.5);
+        for(int i = 0; i < 2000; ++i)
+        {
+            double angle = 2.0 * M_PI * i / 2000.0;
+            Eigen::Vector3d measurement(2.0 + 1.2 * std::cos(angle), 2.0 + 1.2 * std::sin(angle), 0.2 + 0.3 * std::sin(5.0 * angle));
+            map.tryMergePoint(sensor_origin, measurement, 0.01);
+        }
+    }
+
+    /** Checks that both maps contain the same voxels with distances and variances within tolerance */
+    template<class MapA, class MapB>
+    void checkSimilar(const MapA& map, const MapB& other, float tolerance)
+    {
+        size_t num_voxels = 0;
+        for(size_t y = 0; y < map.getNumCells().y(); ++y)
+        {
+            for(size_t x = 0; x < map.getNumCells().x(); ++x)
+            {
+                const typename MapA::GridMapBase::CellType& tree = map.at(Index(x, y));
+                const typename MapB::GridMapBase::CellType& other_tree = other.at(Index(x, y));
+                BOOST_REQUIRE_EQUAL(tree.size(), other_tree.size());
+                typename MapB::GridMapBase::CellType::const_iterator other_it = other_tree.begin();
+                for(typename MapA::GridMapBase::CellType::const_iterator it = tree.begin(); it != tree.end(); ++it, ++other_it)
+                {
+                    BOOST_REQUIRE_EQUAL(it->first, other_it->first);
+                    BOOST_CHECK_SMALL(it->second.getDistance() - other_it->second.getDistance(), tolerance);
+                    BOOST_CHECK_SMALL(it->second.getVariance() - other_it->second.getVariance(), tolerance);
+                    num_voxels++;
+                }
+            }
+        }
+        BOOST_CHECK_GT(num_voxels, 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_half_float)
+{
+    const float exact[] = {0.f, -0.f, 1.f, -2.5f, 0.125f, 1024.f, 65504.f, 0.000061035156f, 0.000000059604645f};
+    for(float value : exact)
+        BOOST_CHECK_EQUAL((float)HalfFloat(value), value);
+
+    BOOST_CHECK(std::isnan((float)HalfFloat(base::NaN<float>())));
+    BOOST_CHECK(std::isinf((float)HalfFloat(1e6f)));
+    BOOST_CHECK(std::isinf((float)HalfFloat(-std::numeric_limits<float>::infinity())));
+    BOOST_CHECK_EQUAL((float)HalfFloat(1e-9f), 0.f);
+
+    // round to nearest even
+    BOOST_CHECK_EQUAL((float)HalfFloat(1.f + 1.f / 2048.f), 1.f);
+    BOOST_CHECK_EQUAL((float)HalfFloat(1.f + 3.f / 2048.f), 1.f + 2.f / 1024.f);
+    BOOST_CHECK_CLOSE((float)HalfFloat(0.3337f), 0.3337f, 0.05);
+}
+
+BOOST_AUTO_TEST_CASE(test_packed_tsdf_patch)
+{
+    BOOST_CHECK(std::is_trivially_copyable<PackedTSDFPatchFloat>::value);
+    BOOST_CHECK(std::is_trivially_copyable<PackedTSDFPatchHalf>::value);
+    BOOST_CHECK_EQUAL(sizeof(std::pair<int32_t, PackedTSDFPatchFloat>), 12);
+    BOOST_CHECK_EQUAL(sizeof(std::pair<int32_t, PackedTSDFPatchHalf>), 8);
+    BOOST_CHECK_LE(2 * sizeof(std::pair<int32_t, PackedTSDFPatchFloat>), sizeof(std::pair<int32_t, TSDFPatch>));
+
+    TSDFPatch patch;
+    PackedTSDFPatchFloat packed;
+    PackedTSDFPatchHalf half;
+    BOOST_CHECK(base::isNaN(packed.getDistance()));
+    BOOST_CHECK(base::isNaN(half.getDistance()));
+    const float measurements[] = {0.5f, 0.3f, -0.2f, 0.1f, 0.0f, 0.05f};
+    for(float distance : measurements)
+    {
+        patch.update(distance, 0.02f, 1.f, 0.001f);
+        packed.update(distance, 0.02f, 1.f, 0.001f);
+        half.update(distance, 0.02f, 1.f, 0.001f);
+        BOOST_CHECK_EQUAL(packed.getDistance(), patch.getDistance());
+        BOOST_CHECK_EQUAL(packed.getVariance(), patch.getVariance());
+        BOOST_CHECK_SMALL(half.getDistance() - patch.getDistance(), 1e-3f);
+        BOOST_CHECK_CLOSE(half.getVariance(), patch.getVariance(), 0.5);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_packed_tsdf_map)
+{
+    TSDFVolumetricMap map(Vector2ui(40, 40), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    PackedTSDFVolumetricMap packed_map(Vector2ui(40, 40), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    HalfTSDFVolumetricMap half_map(Vector2ui(40, 40), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    fillMap(map);
+    fillMap(packed_map);
+    fillMap(half_map);
+
+    checkSimilar(map, packed_map, 0.f);
+    // the rounding errors of the half precision voxels accumulate over the updates
+    checkSimilar(map, half_map, 0.1f);
+}
+
+BOOST_AUTO_TEST_CASE(test_dense_tsdf_map)
+{
+    PackedTSDFVolumetricMap packed_map(Vector2ui(40, 40), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    DenseTSDFVolumetricMap dense_map(Vector2ui(40, 40), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    fillMap(packed_map);
+    fillMap(dense_map);
+
+    checkSimilar(packed_map, dense_map, 0.f);
+}
+
+BOOST_AUTO_TEST_CASE(test_packed_tsdf_serialization)
+{
+    TSDFVolumetricMap map(Vector2ui(40, 40), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    fillMap(map);
+
+    // float archives can be loaded by all voxel types
+    std::stringstream stream;
+    {
+        boost::archive::binary_oarchive oa(stream);
+        oa << map;
+    }
+    HalfTSDFVolumetricMap half_map;
+    {
+        boost::archive::binary_iarchive ia(stream);
+        ia >> half_map;
+    }
+    BOOST_CHECK_EQUAL(half_map.getTruncation(), 0.3f);
+    checkSimilar(map, half_map, 0.01f);
+
+    // half precision archives are written with version 1 of the voxel
+    std::stringstream half_stream;
+    {
+        boost::archive::binary_oarchive oa(half_stream);
+        oa << half_map;
+    }
+    BOOST_CHECK_LT(half_stream.str().size(), stream.str().size());
+
+    TSDFVolumetricMap map_out;
+    PackedTSDFVolumetricMap packed_map_out;
+    {
+        std::stringstream copy(half_stream.str());
+        boost::archive::binary_iarchive ia(copy);
+        ia >> map_out;
+    }
+    {
+        boost::archive::binary_iarchive ia(half_stream);
+        ia >> packed_map_out;
+    }
+    checkSimilar(half_map, map_out, 0.f);
+    checkSimilar(half_map, packed_map_out, 0.f);
+}
+
+/** Organized cloud of a wall 2m in front of a pinhole camera */
+TSDFVolumetricMap::PointCloud generateWall(const PinholeIntrinsics& intrinsics)
+{
+    TSDFVolumetricMap::PointCloud pc;
+    pc.width = 64;
+    pc.height = 48;
+    pc.points.resize(pc.width * pc.height);
+    for(uint32_t v = 0; v < pc.height; ++v)
+    {
+        for(uint32_t u = 0; u < pc.width; ++u)
+        {
+            pcl::PointXYZ& point = pc.at(u, v);
+            point.z = 2.f;
+            point.x = (u - intrinsics.cx) * point.z / intrinsics.fx;
+            point.y = (v - intrinsics.cy) * point.z / intrinsics.fy;
+        }
+    }
+    return pc;
+}
+
+BOOST_AUTO_TEST_CASE(test_projective_integration)
+{
+    const PinholeIntrinsics intrinsics(100.0, 100.0, 32.0, 24.0);
+    TSDFVolumetricMap::PointCloud pc = generateWall(intrinsics);
+    pc.at(10, 10).x = pc.at(10, 10).y = pc.at(10, 10).z = base::NaN<float>();
+
+    PinholeIntrinsics estimated = PinholeIntrinsics::fromOrganizedCloud(pc);
+    BOOST_CHECK_CLOSE(estimated.fx, intrinsics.fx, 1e-3);
+    BOOST_CHECK_CLOSE(estimated.fy, intrinsics.fy, 1e-3);
+    BOOST_CHECK_SMALL(estimated.cx - intrinsics.cx, 1e-3);
+    BOOST_CHECK_SMALL(estimated.cy - intrinsics.cy, 1e-3);
+
+    // camera at (1.05, 2.05, 1.05) looking along the x axis of the grid, the wall is at x = 3.05
+    base::Transform3d pc2grid = base::Transform3d::Identity();
+    pc2grid.linear() << 0, 0, 1,
+                       -1, 0, 0,
+                        0, -1, 0;
+    pc2grid.translation() << 1.05, 2.05, 1.05;
+
+    TSDFVolumetricMap map(Vector2ui(50, 50), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    MergeStatistics stats = map.mergePointCloudProjective(pc, pc2grid, 0.01, 4);
+    BOOST_CHECK_EQUAL(stats.merged, pc.size() - 1);
+    BOOST_CHECK_EQUAL(stats.invalid, 1);
+
+    // voxels along the optical axis
+    const DiscreteTree<TSDFPatch>& tree = map.at(Index(30, 20));
+    BOOST_CHECK(!tree.empty());
+    for(int x = 0; x < 50; ++x)
+    {
+        Eigen::Vector3i voxel_idx(x, 20, 10);
+        Eigen::Vector3d center;
+        map.fromVoxelGrid(voxel_idx, center);
+        const double expected = 3.05 - center.x();
+        if(std::abs(expected) <= 0.25)
+        {
+            BOOST_REQUIRE(map.hasVoxelCell(voxel_idx));
+            BOOST_CHECK_SMALL(map.getVoxelCell(voxel_idx).getDistance() - expected, 1e-3);
+        }
+        else if(std::abs(expected) > 0.35)
+            BOOST_CHECK(!map.hasVoxelCell(voxel_idx));
+    }
+
+    // the result doesn't depend on the number of threads
+    TSDFVolumetricMap serial_map(Vector2ui(50, 50), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    serial_map.mergePointCloudProjective(pc, pc2grid, intrinsics, 0.01, 1);
+    checkSimilar(map, serial_map, 0.f);
+
+    // the same cloud in a frame in which the sensor is rotated and shifted, given by the sensor pose of the cloud
+    base::Transform3d sensor2pc = base::Transform3d::Identity();
+    sensor2pc.linear() = Eigen::AngleAxisd(0.5 * M_PI, Eigen::Vector3d::UnitZ()).toRotationMatrix();
+    sensor2pc.translation() << 0.5, -0.25, 1.0;
+    TSDFVolumetricMap::PointCloud moved_pc = pc;
+    for(pcl::PointXYZ& point : moved_pc.points)
+        point.getVector3fMap() = (sensor2pc * point.getVector3fMap().cast<double>()).cast<float>();
+    moved_pc.sensor_origin_ << 0.5f, -0.25f, 1.0f, 0.f;
+    moved_pc.sensor_orientation_ = Eigen::Quaternionf(sensor2pc.linear().cast<float>());
+    PinholeIntrinsics moved_estimated = PinholeIntrinsics::fromOrganizedCloud(moved_pc);
+    BOOST_CHECK_CLOSE(moved_estimated.fx, intrinsics.fx, 1e-3);
+    BOOST_CHECK_SMALL(moved_estimated.cy - intrinsics.cy, 1e-3);
+    TSDFVolumetricMap moved_map(Vector2ui(50, 50), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    stats = moved_map.mergePointCloudProjective(moved_pc, pc2grid * sensor2pc.inverse(), intrinsics, 0.01, 4);
+    BOOST_CHECK_EQUAL(stats.merged, pc.size() - 1);
+    checkSimilar(map, moved_map, 1e-4f);
+
+    // unorganized clouds are rejected
+    TSDFVolumetricMap::PointCloud unorganized;
+    unorganized.push_back(pcl::PointXYZ(1.f, 1.f, 1.f));
+    BOOST_CHECK_THROW(map.mergePointCloudProjective(unorganized, pc2grid), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_projective_integration_local_frame)
+{
+    const PinholeIntrinsics intrinsics(100.0, 100.0, 32.0, 24.0);
+    TSDFVolumetricMap::PointCloud pc = generateWall(intrinsics);
+
+    // camera looking along the x axis of the grid, the wall columns with u < 10 are beyond y = 2.5
+    base::Transform3d pc2grid = base::Transform3d::Identity();
+    pc2grid.linear() << 0, 0, 1,
+                       -1, 0, 0,
+                        0, -1, 0;
+    pc2grid.translation() << 1.05, 2.05, 1.05;
+    TSDFVolumetricMap map(Vector2ui(50, 25), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    MergeStatistics stats = map.mergePointCloudProjective(pc, pc2grid, intrinsics, 0.01, 4);
+    BOOST_CHECK_EQUAL(stats.invalid, 10 * pc.height);
+    BOOST_CHECK_EQUAL(stats.merged, pc.size() - 10 * pc.height);
+
+    // like in toVoxelGrid the local frame only applies to x and y, so the z offset doesn't move the voxels
+    TSDFVolumetricMap rotated_map(Vector2ui(50, 25), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    rotated_map.getLocalFrame() = Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitZ()) * Eigen::Translation3d(0.4, -0.3, 0.7);
+    base::Transform3d local_frame_2d = rotated_map.getLocalFrame();
+    local_frame_2d.translation().z() = 0.0;
+    stats = rotated_map.mergePointCloudProjective(pc, local_frame_2d.inverse() * pc2grid, intrinsics, 0.01, 4);
+    BOOST_CHECK_EQUAL(stats.invalid, 10 * pc.height);
+    checkSimilar(map, rotated_map, 1e-4f);
+
+    // same voxels as the ray based integration, which doesn't support rotated local frames
+    base::Transform3d shifted_frame(Eigen::Translation3d(0.5, -0.3, 0.7));
+    TSDFVolumetricMap shifted_map(Vector2ui(50, 25), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    shifted_map.getLocalFrame() = shifted_frame;
+    shifted_map.mergePointCloudProjective(pc, Eigen::Translation3d(-0.5, 0.3, 0.0) * pc2grid, intrinsics, 0.01, 4);
+    checkSimilar(map, shifted_map, 1e-4f);
+
+    TSDFVolumetricMap ray_map(Vector2ui(50, 25), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f);
+    ray_map.getLocalFrame() = shifted_frame;
+    const Eigen::Vector3d sensor_origin(0.55, 2.35, 1.05);
+    const Eigen::Vector3d measurement = sensor_origin + Eigen::Vector3d(2.0, 0.0, 0.0);
+    ray_map.mergePoint(sensor_origin, measurement);
+    Eigen::Vector3i measurement_idx;
+    BOOST_REQUIRE(ray_map.toVoxelGrid(measurement, measurement_idx));
+    BOOST_CHECK_EQUAL(measurement_idx, Eigen::Vector3i(30, 20, 10));
+    BOOST_REQUIRE(ray_map.hasVoxelCell(measurement_idx));
+    BOOST_REQUIRE(shifted_map.hasVoxelCell(measurement_idx));
+    BOOST_CHECK_SMALL(shifted_map.getVoxelCell(measurement_idx).getDistance() - ray_map.getVoxelCell(measurement_idx).getDistance(), 1e-3f);
+}
+
+template<enum MLSConfig::update_model SurfaceType>
+void checkParallelMLSProjection()
+{
+    MLSConfig config;
+    config.updateModel = SurfaceType;
+    MLSMap<SurfaceType> mls(Vector2ui(50, 50), Vector2d(0.1, 0.1), config);
+    mls.getLocalFrame().translation() << 0.5 * mls.getSize(), 0;
+    for(double x = -2.5; x < 2.5; x += 0.025)
+    {
+        for(double y = -2.5; y < 2.5; y += 0.025)
+            mls.mergePoint(Eigen::Vector3d(x, y, 0.5 * std::cos(x * 1.3) * std::sin(y * 0.9)));
+    }
+
+    base::Transform3d tilted(Eigen::AngleAxisd(0.2, Eigen::Vector3d::UnitX()));
+    const base::Transform3d transforms[] = {base::Transform3d(Eigen::Translation3d(2.0, 2.0, 1.0)), Eigen::Translation3d(2.0, 2.0, 1.0) * tilted};
+    for(const base::Transform3d& mls2grid : transforms)
+    {
+        TSDFVolumetricMap serial(Vector2ui(40, 40), Vector3d(0.1, 0.1, 0.1), 0.3f);
+        TSDFVolumetricMap parallel(Vector2ui(40, 40), Vector3d(0.1, 0.1, 0.1), 0.3f);
+        serial.setDirtyTracking(true);
+        serial.resetDirty();
+        parallel.setDirtyTracking(true);
+        parallel.resetDirty();
+        serial.projectMLSMap(mls, mls2grid, Eigen::Vector2i(0, 0), Eigen::Vector2i(40, 40), -1.f, 3.f, 0.3f);
+        parallel.projectMLSMapParallel(mls, mls2grid, Eigen::Vector2i(0, 0), Eigen::Vector2i(40, 40), -1.f, 3.f, 0.3f, 0.01f, 4);
+        checkSimilar(serial, parallel, 1e-4f);
+
+        // both variants report the same changed columns
+        BOOST_REQUIRE(!serial.getDirtyExtents().isEmpty());
+        BOOST_CHECK_EQUAL(serial.getDirtyExtents().min(), parallel.getDirtyExtents().min());
+        BOOST_CHECK_EQUAL(serial.getDirtyExtents().max(), parallel.getDirtyExtents().max());
+        for(unsigned y = 0; y < 40; ++y)
+        {
+            for(unsigned x = 0; x < 40; ++x)
+                BOOST_CHECK_EQUAL(serial.isDirty(Index(x, y)), parallel.isDirty(Index(x, y)));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_mls_projection_kalman)
+{
+    checkParallelMLSProjection<MLSConfig::KALMAN>();
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_mls_projection_slope)
+{
+    checkParallelMLSProjection<MLSConfig::SLOPE>();
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_fusion)
+{
+    TSDFVolumetricMap::PointCloud pc;
+    pc.sensor_origin_ << 2.0f, 2.0f, 1.5f, 0.f;
+    for(int i = 0; i < 5000; ++i)
+    {
+        double angle = 2.0 * M_PI * i / 5000.0;
+        double radius = (i % 100 == 0) ? 5.0 : 1.2 + 0.2 * std::cos(7.0 * angle);
+        pc.push_back(pcl::PointXYZ(2.0 + radius * std::cos(angle), 2.0 + radius * std::sin(angle), 0.2 + 0.3 * std::sin(5.0 * angle)));
+    }
+
+    TSDFVolumetricMap serial(Vector2ui(40, 40), Vector3d(0.1, 0.1, 0.1), 0.3f);
+    TSDFVolumetricMap parallel(Vector2ui(40, 40), Vector3d(0.1, 0.1, 0.1), 0.3f);
+    MergeStatistics serial_stats = serial.mergePointCloud(pc, base::Transform3d::Identity());
+    MergeStatistics parallel_stats = parallel.mergePointCloudParallel(pc, base::Transform3d::Identity(), 0.01, 4);
+    BOOST_CHECK_EQUAL(serial_stats.merged, parallel_stats.merged);
+    BOOST_CHECK_EQUAL(serial_stats.invalid, parallel_stats.invalid);
+    checkSimilar(serial, parallel, 1e-6f);
+}
+
+BOOST_AUTO_TEST_CASE(test_ray_integration_context)
+{
+    TSDFVolumetricMap::PointCloud pc;
+    for(int i = 0; i < 2000; ++i)
+    {
+        double angle = 2.0 * M_PI * i / 2000.0;
+        pc.push_back(pcl::PointXYZ(1.2 * std::cos(angle), 1.2 * std::sin(angle), -1.3 + 0.3 * std::sin(5.0 * angle)));
+    }
+
+    TSDFVolumetricMap map(Vector2ui(40, 40), Vector3d(0.1, 0.1, 0.1), 0.3f);
+    TSDFVolumetricMap context_map(Vector2ui(40, 40), Vector3d(0.1, 0.1, 0.1), 0.3f);
+
+    // the context is reused for clouds from different sensor poses
+    RayIntegrationContext context;
+    for(int i = 0; i < 2; ++i)
+    {
+        base::Transform3d pc2grid = base::Transform3d::Identity();
+        pc2grid.translation() << 2.0 - 0.3 * i, 2.0, 1.5;
+        MergeStatistics stats = context_map.mergePointCloud(pc, pc2grid, context);
+        BOOST_CHECK_EQUAL(stats.merged, pc.size());
+        BOOST_CHECK(context.sensor_origin.isApprox(pc2grid.translation()));
+
+        for(const pcl::PointXYZ& point : pc.points)
+            map.mergePoint(pc2grid.translation(), pc2grid * Eigen::Vector3d(point.getArray3fMap().cast<double>()));
+    }
+    BOOST_CHECK_GT(context.ray.capacity(), 0);
+    checkSimilar(map, context_map, 0.f);
+
+    // single points merged with the context, the points are given in the frame of the last cloud
+    const base::Transform3d pc2grid = context.pc2grid;
+    for(size_t i = 0; i < 100; ++i)
+    {
+        const Eigen::Vector3d point = pc.points[i].getArray3fMap().cast<double>();
+        context_map.mergePoint(context, point);
+        map.mergePoint(pc2grid.translation(), pc2grid * point);
+    }
+    checkSimilar(map, context_map, 0.f);
+    BOOST_CHECK_THROW(context_map.mergePoint(context, Eigen::Vector3d::Zero()), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_merge_point_errors)
+{
+    TSDFVolumetricMap map(Vector2ui(40, 40), Vector3d(0.1, 0.1, 0.1), 0.3f);
+    const Eigen::Vector3d sensor_origin(2.0, 2.0, 1.5);
+
+    BOOST_CHECK_NO_THROW(map.mergePoint(sensor_origin, Eigen::Vector3d(2.5, 2.0, 0.5)));
+
+    try
+    {
+        map.mergePoint(Eigen::Vector3d(-1.0, 2.0, 1.5), Eigen::Vector3d(2.5, 2.0, 0.5));
+        BOOST_FAIL("expected an exception");
+    }
+    catch(const std::runtime_error& e)
+    {
+        BOOST_CHECK(std::string(e.what()).find("Sensor origin") != std::string::npos);
+    }
+
+    try
+    {
+        map.mergePoint(sensor_origin, sensor_origin);
+        BOOST_FAIL("expected an exception");
+    }
+    catch(const std::runtime_error& e)
+    {
+        BOOST_CHECK(std::string(e.what()).find("equal to the sensor origin") != std::string::npos);
+    }
+
+    BOOST_CHECK(!map.tryMergePoint(sensor_origin, sensor_origin));
+}
@@ -0,0 +1,266 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE GridTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/TiledGrid.hpp>
+#include <maps/grid/GridMap.hpp>
+#include <maps/grid/VoxelGridMap.hpp>
+#include <maps/grid/MLSMap.hpp>
+#include <maps/grid/CompactMLSMap.hpp>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
+#include <sstream>
+
+using namespace ::maps::grid;
+
+typedef TiledGrid<int, 4> TiledGridI;
+
+template <typename GridA, typename GridB>
+void checkEqual(const GridA& a, const GridB& b)
+{
+    BOOST_REQUIRE_EQUAL(a.getNumCells(), b.getNumCells());
+    for (unsigned int y = 0; y < a.getNumCells().y(); ++y)
+        for (unsigned int x = 0; x < a.getNumCells().x(); ++x)
+            BOOST_REQUIRE_EQUAL(a.at(x, y), b.at(x, y));
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_allocation)
+{
+    TiledGridI grid(Vector2ui(10, 7), -1);
+    const TiledGridI& const_grid = grid;
+
+    BOOST_CHECK_EQUAL(grid.getNumTiles(), Vector2ui(3, 2));
+    BOOST_CHECK_EQUAL(grid.getNumAllocatedTiles(), 0);
+    BOOST_CHECK(grid.begin() == grid.end());
+
+    // read access does not allocate
+    BOOST_CHECK_EQUAL(const_grid.at(9, 6), -1);
+    BOOST_CHECK_EQUAL(grid.getNumAllocatedTiles(), 0);
+    BOOST_CHECK_THROW(const_grid.at(10, 0), std::runtime_error);
+    BOOST_CHECK_THROW(grid.at(0, 7), std::runtime_error);
+
+    // write access to a border tile
+    grid.at(9, 6) = 5;
+    BOOST_CHECK_EQUAL(grid.getNumAllocatedTiles(), 1);
+    BOOST_CHECK_EQUAL(grid.getTileCells(5), Vector2ui(2, 3));
+    BOOST_CHECK_EQUAL(std::distance(grid.begin(), grid.end()), 6);
+    BOOST_CHECK_EQUAL(const_grid.at(9, 6), 5);
+    BOOST_CHECK_EQUAL(const_grid.at(8, 6), -1);
+
+    size_t visited = 0;
+    grid.forEachAllocatedCell([&](const Index& idx, const int& cell)
+    {
+        BOOST_CHECK(idx.x() >= 8 && idx.y() >= 4);
+        BOOST_CHECK_EQUAL(cell, const_grid.at(idx));
+        visited++;
+    });
+    BOOST_CHECK_EQUAL(visited, 6);
+
+    grid.clear();
+    BOOST_CHECK_EQUAL(grid.getNumAllocatedTiles(), 0);
+    BOOST_CHECK_EQUAL(const_grid.at(9, 6), -1);
+}
+
+BOOST_AUTO_TEST_CASE(test_move_and_resize_match_vector_grid)
+{
+    Vector2ui num_cells(11, 9);
+    VectorGrid<int> vector_grid(num_cells, -1);
+    TiledGridI tiled_grid(num_cells, -1);
+
+    srand(42);
+    for (int i = 0; i < 200; ++i)
+    {
+        for (int n = 0; n < 5; ++n)
+        {
+            Index idx(rand() % num_cells.x(), rand() % num_cells.y());
+            int value = rand() % 100;
+            vector_grid.at(idx) = value;
+            tiled_grid.at(idx) = value;
+        }
+
+        Index offset(rand() % 25 - 12, rand() % 21 - 10);
+        vector_grid.moveBy(offset);
+        tiled_grid.moveBy(offset);
+        checkEqual(vector_grid, tiled_grid);
+    }
+
+    tiled_grid.resize(Vector2ui(6, 13));
+    for (unsigned int y = 0; y < 13; ++y)
+    {
+        for (unsigned int x = 0; x < 6; ++x)
+        {
+            int expected = y < num_cells.y() ? vector_grid.at(x, y) : -1;
+            BOOST_CHECK_EQUAL(tiled_grid.at(x, y), expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_serialization)
+{
+    TiledGridI grid(Vector2ui(30, 20), 0);
+    grid.at(1, 1) = 3;
+    grid.at(29, 19) = 7;
+    grid.at(17, 5) = 9;
+
+    std::stringstream stream;
+    {
+        boost::archive::binary_oarchive oa(stream);
+        oa << grid;
+    }
+
+    TiledGridI loaded;
+    boost::archive::binary_iarchive ia(stream);
+    ia >> loaded;
+
+    BOOST_CHECK_EQUAL(loaded.getNumAllocatedTiles(), 3);
+    checkEqual(grid, loaded);
+}
+
+BOOST_AUTO_TEST_CASE(test_grid_map)
+{
+    GridMap<double, VectorGrid<double> > vector_map(Vector2ui(200, 100), Vector2d(0.1, 0.1), -1.);
+    GridMap<double, TiledGrid<double, 16> > tiled_map(Vector2ui(200, 100), Vector2d(0.1, 0.1), -1.);
+
+    vector_map.at(Index(30, 40)) = tiled_map.at(Index(30, 40)) = 2.;
+    vector_map.at(Vector3d(15.55, 0.25, 0.)) = tiled_map.at(Vector3d(15.55, 0.25, 0.)) = 5.;
+    BOOST_CHECK_EQUAL(tiled_map.getNumAllocatedTiles(), 2);
+
+    vector_map.moveBy(Index(4, 3));
+    tiled_map.moveBy(Index(4, 3));
+    checkEqual(vector_map, tiled_map);
+
+    CellExtents vector_extents = vector_map.calculateCellExtents();
+    CellExtents tiled_extents = tiled_map.calculateCellExtents();
+    BOOST_CHECK_EQUAL(vector_extents.min(), tiled_extents.min());
+    BOOST_CHECK_EQUAL(vector_extents.max(), tiled_extents.max());
+
+    BOOST_CHECK_EQUAL(tiled_map.getMax(), 5.);
+    BOOST_CHECK_EQUAL(tiled_map.getMin(false), 2.);
+}
+
+BOOST_AUTO_TEST_CASE(test_grid_map_min_max)
+{
+    // only the first tile is allocated and it contains no default value
+    GridMap<double, TiledGrid<double, 16> > tiled_map(Vector2ui(32, 16), Vector2d(0.1, 0.1), 10.);
+    for (unsigned int y = 0; y < 16; ++y)
+    {
+        for (unsigned int x = 0; x < 16; ++x)
+            tiled_map.at(Index(x, y)) = 1. + 0.1 * x + 0.2 * y;
+    }
+    BOOST_CHECK_EQUAL(tiled_map.getNumAllocatedTiles(), 1);
+
+    // the cells of the unallocated tile have the default value
+    BOOST_CHECK_EQUAL(tiled_map.getMax(), 10.);
+    BOOST_CHECK_CLOSE(tiled_map.getMax(false), 5.5, 1e-9);
+    BOOST_CHECK_EQUAL(tiled_map.getMin(), 1.);
+    BOOST_CHECK_EQUAL(tiled_map.getMin(false), 1.);
+
+    GridMap<double, TiledGrid<double, 16> > negative_default(Vector2ui(32, 16), Vector2d(0.1, 0.1), -10.);
+    negative_default.at(Index(3, 4)) = 2.;
+    BOOST_CHECK_EQUAL(negative_default.getMin(), -10.);
+    BOOST_CHECK_EQUAL(negative_default.getMax(), 2.);
+}
+
+BOOST_AUTO_TEST_CASE(test_empty_grid_map)
+{
+    GridMap<double, TiledGrid<double, 16> > tiled_map(Vector2ui(200, 100), Vector2d(0.1, 0.1), -1.);
+    BOOST_CHECK_EQUAL(tiled_map.getNumAllocatedTiles(), 0);
+    BOOST_CHECK(tiled_map.begin() == tiled_map.end());
+
+    BOOST_CHECK_EQUAL(tiled_map.getMax(), -1.);
+    BOOST_CHECK_EQUAL(tiled_map.getMin(), -1.);
+    BOOST_CHECK_THROW(tiled_map.getMax(false), std::runtime_error);
+    BOOST_CHECK_THROW(tiled_map.getMin(false), std::runtime_error);
+
+    GridMap<double, TiledGrid<double, 16> > no_cells(Vector2ui(0, 0), Vector2d(0.1, 0.1), -1.);
+    BOOST_CHECK_THROW(no_cells.getMax(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_voxel_grid_map)
+{
+    typedef DiscreteTree<int> Column;
+    VoxelGridMap<int, Column, TiledGrid<Column, 16> > voxel_map(Vector2ui(200, 100), Vector3d(0.1, 0.1, 0.1));
+    const VoxelGridMap<int, Column, TiledGrid<Column, 16> >& const_map = voxel_map;
+
+    Eigen::Vector3i idx;
+    BOOST_REQUIRE(voxel_map.toVoxelGrid(Eigen::Vector3d(15.55, 0.25, 0.35), idx));
+    BOOST_CHECK(!const_map.hasVoxelCell(idx));
+    BOOST_CHECK_EQUAL(voxel_map.getNumAllocatedTiles(), 0);
+
+    voxel_map.getVoxelCell(idx) = 3;
+    BOOST_CHECK(const_map.hasVoxelCell(idx));
+    BOOST_CHECK_EQUAL(voxel_map.getNumAllocatedTiles(), 1);
+
+    Eigen::Vector3d position;
+    BOOST_REQUIRE(voxel_map.fromVoxelGrid(idx, position));
+    BOOST_CHECK_SMALL(position.z() - 0.35, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_map)
+{
+    typedef MLSMap<MLSConfig::KALMAN, MLSMapKalman::allocator_type, TiledGrid<MLSMapKalman::CellType, 16> > TiledMLSMap;
+
+    MLSConfig config;
+    config.updateModel = MLSConfig::KALMAN;
+    MLSMapKalman vector_mls(Vector2ui(200, 100), Vector2d(0.1, 0.1), config);
+    TiledMLSMap tiled_mls(Vector2ui(200, 100), Vector2d(0.1, 0.1), config);
+
+    PointCloud pc;
+    for (int i = 0; i < 500; ++i)
+        pc.push_back(pcl::PointXYZ(10.0 + 0.001 * i, 5.0 + 0.001 * i, 0.1 * std::sin(0.05 * i)));
+    vector_mls.mergePointCloud(pc, base::Transform3d::Identity());
+    tiled_mls.mergePointCloudBatched(pc, base::Transform3d::Identity(), 0.01, 4);
+    BOOST_CHECK_EQUAL(tiled_mls.getNumAllocatedTiles(), 1);
+
+    // converting between the grid storages keeps the patches
+    MLSMapKalman converted(tiled_mls);
+    size_t num_patches = 0;
+    for (unsigned int y = 0; y < 100; ++y)
+    {
+        for (unsigned int x = 0; x < 200; ++x)
+        {
+            const MLSMapKalman::CellType& vector_cell = vector_mls.at(Index(x, y));
+            BOOST_REQUIRE_EQUAL(vector_cell.size(), tiled_mls.at(Index(x, y)).size());
+            BOOST_REQUIRE_EQUAL(vector_cell.size(), converted.at(Index(x, y)).size());
+            num_patches += vector_cell.size();
+        }
+    }
+    BOOST_CHECK_GT(num_patches, 0);
+
+    // the compact copy reads the cells of unallocated tiles as empty
+    CompactMLSMapKalman compact(tiled_mls);
+    BOOST_CHECK_EQUAL(compact.getNumPatches(), num_patches);
+    BOOST_CHECK_EQUAL(compact.getCellOffsets().size(), 200 * 100 + 1);
+    for (unsigned int y = 0; y < 100; ++y)
+    {
+        for (unsigned int x = 0; x < 200; ++x)
+            BOOST_REQUIRE_EQUAL(compact.at(x, y).size(), vector_mls.at(Index(x, y)).size());
+    }
+}
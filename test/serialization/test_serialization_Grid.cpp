@@ -30,11 +30,14 @@
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
 
+#include <cstring>
+
 /** Grid maps **/
 #include <maps/grid/GridMap.hpp>
 #include <maps/grid/LevelList.hpp>
 #include <maps/grid/MultiLevelGridMap.hpp>
 #include <maps/grid/TraversabilityGrid.hpp>
+#include <maps/grid/OccupancyGridMap.hpp>
 
 using namespace ::maps::grid;
 
@@ -169,6 +172,84 @@ BOOST_AUTO_TEST_CASE(test_gridmap_serialization)
     }
 }
 
+BOOST_AUTO_TEST_CASE(test_gridmap_chunked_serialization)
+{
+    GridMap<double> grid_map_o(Vector2ui(130, 203), Vector2d(0.1, 0.1), -1.);
+    for (unsigned int y = 0; y < 203; ++y)
+        for (unsigned int x = 0; x < 130; ++x)
+            if ((x * 7 + y) % 5 != 0)
+                grid_map_o.at(x, y) = x + 0.001 * y;
+
+    for (int compression = CHUNK_COMPRESSION_NONE; compression <= CHUNK_COMPRESSION_ZLIB; ++compression)
+    {
+        ChunkedArchiveConfig config;
+        config.enabled = true;
+        config.rows_per_chunk = 16;
+        config.compression = ChunkCompression(compression);
+        config.num_threads = 4;
+        grid_map_o.setChunkedArchiveConfig(config);
+
+        std::stringstream stream;
+        boost::archive::binary_oarchive oa(stream);
+        oa << grid_map_o;
+
+        // the loading side detects the chunked mode by itself
+        boost::archive::binary_iarchive ia(stream);
+        GridMap<double> grid_map_i;
+        ia >> grid_map_i;
+
+        BOOST_CHECK(grid_map_i.getNumCells() == grid_map_o.getNumCells());
+        BOOST_CHECK_EQUAL(grid_map_i.getDefaultValue(), -1.);
+        BOOST_CHECK(std::equal(grid_map_i.begin(), grid_map_i.end(), grid_map_o.begin()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_vectorgrid_chunked_invalid_sizes)
+{
+    // a single uncompressed chunk, which is the end of the archive
+    VectorGrid<double> grid_o(Vector2ui(20, 10), -1.);
+    grid_o.at(3, 4) = 2.;
+    ChunkedArchiveConfig config;
+    config.enabled = true;
+    config.rows_per_chunk = 16;
+    grid_o.setChunkedArchiveConfig(config);
+
+    std::stringstream stream;
+    {
+        boost::archive::binary_oarchive oa(stream);
+        oa << grid_o;
+    }
+    const std::string archive = stream.str();
+
+    // raw_size and stored_size are equal and directly precede the chunk
+    size_t sizes_pos = 0;
+    for (size_t pos = 0; pos + 2 * sizeof(uint64_t) <= archive.size(); ++pos)
+    {
+        uint64_t sizes[2];
+        std::memcpy(sizes, &archive[pos], sizeof(sizes));
+        if (sizes[0] == sizes[1] && pos + sizeof(sizes) + sizes[1] == archive.size())
+            sizes_pos = pos;
+    }
+    BOOST_REQUIRE_GT(sizes_pos, 0);
+
+    // sizes beyond the encoded size of the cells of the chunk are rejected before allocating
+    for (uint64_t corrupt_size : {uint64_t(1) << 40, uint64_t(200 * 100)})
+    {
+        std::string corrupt = archive;
+        const uint64_t sizes[2] = {corrupt_size, corrupt_size};
+        std::memcpy(&corrupt[sizes_pos], sizes, sizeof(sizes));
+        std::stringstream corrupt_stream(corrupt);
+        boost::archive::binary_iarchive ia(corrupt_stream);
+        VectorGrid<double> grid_i;
+        BOOST_CHECK_THROW(ia >> grid_i, std::runtime_error);
+    }
+
+    boost::archive::binary_iarchive ia(stream);
+    VectorGrid<double> grid_i;
+    ia >> grid_i;
+    BOOST_CHECK_EQUAL(grid_i.at(3, 4), 2.);
+}
+
 BOOST_AUTO_TEST_CASE(test_levellist_serialization)
 {
     LevelList<int> list;
@@ -285,6 +366,72 @@ BOOST_AUTO_TEST_CASE(test_traversabilityGrid_serialization)
     }
 }
 
+BOOST_AUTO_TEST_CASE(test_traversabilityGrid_delta_serialization)
+{
+    TraversabilityGrid grid_out(Vector2ui(20, 10), Vector2d(0.1, 0.1), TraversabilityCell());
+    TraversabilityGrid grid_in(grid_out);
+    grid_out.setDirtyTracking(true);
+    grid_out.setRevision(0);
+
+    uint8_t class_id;
+    BOOST_CHECK(grid_out.registerNewTraversabilityClass(class_id, TraversabilityClass(0.7)));
+    grid_out.setTraversabilityAndProbability(class_id, 0.5, 3, 4);
+    grid_out.setProbability(0.2, 17, 9);
+
+    TraversabilityGrid::Delta delta_out = grid_out.createDelta();
+    BOOST_CHECK_EQUAL(delta_out.grid.size(), 2);
+
+    std::stringstream stream;
+    boost::archive::binary_oarchive outarchive(stream);
+    outarchive << delta_out;
+    boost::archive::binary_iarchive inarchive(stream);
+    TraversabilityGrid::Delta delta_in;
+    inarchive >> delta_in;
+
+    grid_in.applyDelta(delta_in);
+    BOOST_CHECK_EQUAL(grid_in.getTraversabilityClasses().size(), grid_out.getTraversabilityClasses().size());
+    BOOST_CHECK_EQUAL(grid_in.getTraversability(3, 4).getDrivability(), 0.7f);
+    BOOST_CHECK(std::equal(grid_in.begin(), grid_in.end(), grid_out.begin()));
+}
+
+BOOST_AUTO_TEST_CASE(test_occupancyGridMap_delta_serialization)
+{
+    OccupancyGridMap map_out(Vector2ui(50, 50), Eigen::Vector3d(0.1, 0.1, 0.1), OccupancyConfiguration());
+    OccupancyGridMap map_in(map_out);
+    map_out.setDirtyTracking(true);
+    map_out.setRevision(0);
+
+    map_out.mergePoint(Eigen::Vector3d(0.55, 0.55, 0.25), Eigen::Vector3d(3.05, 1.25, 0.65));
+    map_out.mergePoint(Eigen::Vector3d(0.55, 0.55, 0.25), Eigen::Vector3d(1.05, 4.15, 0.05));
+
+    GridDelta<OccupancyGridMap::GridMapBase::CellType> delta_out = map_out.createDelta();
+    BOOST_CHECK_GT(delta_out.size(), 0);
+    BOOST_CHECK_LT(delta_out.size(), 100);
+
+    std::stringstream stream;
+    boost::archive::binary_oarchive outarchive(stream);
+    outarchive << delta_out;
+    boost::archive::binary_iarchive inarchive(stream);
+    GridDelta<OccupancyGridMap::GridMapBase::CellType> delta_in(map_in.getDefaultValue());
+    inarchive >> delta_in;
+
+    map_in.applyDelta(delta_in);
+    for(unsigned x = 0; x < 50; x++)
+    {
+        for(unsigned y = 0; y < 50; y++)
+        {
+            const OccupancyGridMap::GridMapBase::CellType& tree_in = map_in.at(x, y);
+            const OccupancyGridMap::GridMapBase::CellType& tree_out = map_out.at(x, y);
+            BOOST_REQUIRE_EQUAL(tree_in.size(), tree_out.size());
+            for(auto it_in = tree_in.begin(), it_out = tree_out.begin(); it_in != tree_in.end(); ++it_in, ++it_out)
+            {
+                BOOST_CHECK_EQUAL(it_in->first, it_out->first);
+                BOOST_CHECK_EQUAL(it_in->second.getLogOdds(), it_out->second.getLogOdds());
+            }
+        }
+    }
+}
+
 /*BOOST_AUTO_TEST_CASE(test_grid_serialization)
 {
     Grid grid_o(Vector2ui(100, 100), Vector2d(0.153, 0.257));
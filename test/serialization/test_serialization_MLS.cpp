@@ -176,3 +176,96 @@ BOOST_AUTO_TEST_CASE(test_mls_serialization)
     }
 
 }
+
+BOOST_AUTO_TEST_CASE(test_mls_delta_serialization)
+{
+    MLSMapKalman mls_o(Vector2ui(100, 100), Vector2d(0.1, 0.1), MLSConfig());
+    for (size_t x = 0; x < 100; ++x)
+        for (size_t y = 0; y < 100; ++y)
+            mls_o.mergePatch(Index(x, y), MLSMapKalman::Patch(0.01f * x, 0.1f));
+
+    // the receiver gets the full map once
+    MLSMapKalman mls_i;
+    {
+        std::stringstream stream;
+        boost::archive::binary_oarchive oa(stream);
+        oa << mls_o;
+        boost::archive::binary_iarchive ia(stream);
+        ia >> mls_i;
+    }
+    mls_o.setDirtyTracking(true);
+    mls_o.setRevision(0);
+
+    // afterwards only the changes are sent
+    for (size_t i = 0; i < 20; ++i)
+        mls_o.mergePatch(Index(40 + i, 30), MLSMapKalman::Patch(3.f, 0.1f));
+    mls_o.at(Index(5, 5)).clear();
+    mls_o.markDirty(Index(5, 5));
+
+    GridDelta<MLSMapKalman::CellType> delta_o = mls_o.createDelta();
+    BOOST_CHECK_EQUAL(delta_o.size(), 21);
+    BOOST_CHECK_EQUAL(delta_o.base_revision, 0);
+    BOOST_CHECK_EQUAL(delta_o.revision, 1);
+
+    std::stringstream stream;
+    boost::archive::binary_oarchive oa(stream);
+    oa << delta_o;
+    boost::archive::binary_iarchive ia(stream);
+    GridDelta<MLSMapKalman::CellType> delta_i;
+    ia >> delta_i;
+
+    mls_i.applyDelta(delta_i);
+    BOOST_CHECK_EQUAL(mls_i.getRevision(), 1);
+    for (size_t x = 0; x < 100; ++x)
+    {
+        for (size_t y = 0; y < 100; ++y)
+        {
+            const MLSMapKalman::CellType& cell_o = mls_o.at(x, y);
+            const MLSMapKalman::CellType& cell_i = mls_i.at(x, y);
+            BOOST_REQUIRE_EQUAL(cell_o.size(), cell_i.size());
+            BOOST_CHECK(std::equal(cell_o.begin(), cell_o.end(), cell_i.begin()));
+        }
+    }
+
+    // a delta can only be applied to its base revision
+    BOOST_CHECK_THROW(mls_i.applyDelta(delta_i), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_chunked_serialization)
+{
+    MLSMapSloped mls_o(Vector2ui(100, 90), Vector2d(0.05, 0.05), MLSConfig());
+    for (size_t x = 0; x < 100; ++x)
+    {
+        for (size_t y = 0; y < 90; y += 1 + x % 3)
+        {
+            mls_o.mergePoint(Eigen::Vector3d(0.05 * x + 0.01, 0.05 * y + 0.02, std::sin(0.1 * x)));
+            if (y % 7 == 0)
+                mls_o.mergePoint(Eigen::Vector3d(0.05 * x + 0.02, 0.05 * y + 0.01, 3.));
+        }
+    }
+
+    ChunkedArchiveConfig config;
+    config.enabled = true;
+    config.rows_per_chunk = 8;
+    config.compression = CHUNK_COMPRESSION_ZLIB;
+    mls_o.setChunkedArchiveConfig(config);
+
+    std::stringstream stream;
+    boost::archive::binary_oarchive oa(stream);
+    oa << mls_o;
+    boost::archive::binary_iarchive ia(stream);
+    MLSMapSloped mls_i;
+    ia >> mls_i;
+
+    BOOST_REQUIRE(mls_i.getNumCells() == mls_o.getNumCells());
+    for (size_t x = 0; x < 100; ++x)
+    {
+        for (size_t y = 0; y < 90; ++y)
+        {
+            const MLSMapSloped::CellType& cell_o = mls_o.at(x, y);
+            const MLSMapSloped::CellType& cell_i = mls_i.at(x, y);
+            BOOST_REQUIRE_EQUAL(cell_o.size(), cell_i.size());
+            BOOST_CHECK(std::equal(cell_o.begin(), cell_o.end(), cell_i.begin()));
+        }
+    }
+}
@@ -0,0 +1,192 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE SnapshotTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/grid/MapSnapshot.hpp>
+
+#include <cstdio>
+#include <fstream>
+
+using namespace ::maps::grid;
+
+BOOST_AUTO_TEST_CASE(test_gridmap_snapshot)
+{
+    GridMap<float> grid(Vector2ui(30, 20), Vector2d(0.1, 0.2), -1.f);
+    grid.getId() = "grid";
+    grid.getLocalFrame().translation() << 1., 2., 3.;
+    for (unsigned y = 0; y < 20; ++y)
+        for (unsigned x = 0; x < 30; ++x)
+            if ((x + y) % 3)
+                grid.at(x, y) = x * 0.5f + y;
+
+    saveSnapshot("grid.snapshot", grid);
+
+    MappedGridMap<float> mapped("grid.snapshot");
+    BOOST_CHECK_EQUAL(mapped.getNumCells(), grid.getNumCells());
+    BOOST_CHECK_EQUAL(mapped.getResolution(), grid.getResolution());
+    BOOST_CHECK_EQUAL(mapped.getId(), "grid");
+    BOOST_CHECK(mapped.getLocalFrame().isApprox(grid.getLocalFrame()));
+    BOOST_CHECK_EQUAL(mapped.getDefaultValue(), -1.f);
+    BOOST_CHECK(std::equal(mapped.begin(), mapped.end(), grid.begin()));
+    BOOST_CHECK_EQUAL(mapped.at(4, 5), grid.at(4, 5));
+    BOOST_CHECK_THROW(mapped.at(30, 0), std::runtime_error);
+
+    GridMap<float> copy = mapped.toMap();
+    BOOST_CHECK(std::equal(copy.begin(), copy.end(), grid.begin()));
+
+    // the content type is checked
+    BOOST_CHECK_THROW(MappedGridMap<double>("grid.snapshot"), std::runtime_error);
+    BOOST_CHECK_THROW(MappedMLSMap<MLSConfig::KALMAN>("grid.snapshot"), std::runtime_error);
+    std::remove("grid.snapshot");
+}
+
+BOOST_AUTO_TEST_CASE(test_mls_snapshot)
+{
+    MLSConfig config;
+    config.gapSize = 0.3;
+    MLSMapKalman mls(Vector2ui(40, 40), Vector2d(0.05, 0.05), config);
+    mls.getEPSGCode() = "EPSG::4978";
+    for (unsigned y = 0; y < 40; ++y)
+    {
+        for (unsigned x = 0; x < 40; ++x)
+        {
+            if (x % 5 == 0)
+                continue;
+            mls.mergePatch(Index(x, y), MLSMapKalman::Patch(0.01f * x, 0.1f));
+            if (y % 4 == 0)
+                mls.mergePatch(Index(x, y), MLSMapKalman::Patch(2.f + 0.01f * y, 0.2f));
+        }
+    }
+
+    // convert from a boost archive
+    {
+        std::ofstream out("mls.bin", std::ios::binary);
+        boost::archive::binary_oarchive oa(out);
+        oa << mls;
+    }
+    convertArchiveToSnapshot<MLSMapKalman>("mls.bin", "mls.snapshot");
+
+    // the mapping is released before the file is rewritten below
+    size_t num_patches = 0;
+    {
+        MappedMLSMap<MLSConfig::KALMAN> mapped("mls.snapshot");
+        BOOST_CHECK_EQUAL(mapped.getNumCells(), mls.getNumCells());
+        BOOST_CHECK_EQUAL(mapped.getEPSGCode(), "EPSG::4978");
+        BOOST_CHECK_EQUAL(mapped.getConfig().gapSize, 0.3f);
+        BOOST_CHECK_EQUAL(mapped.getConfig().updateModel, MLSConfig::KALMAN);
+        for (unsigned y = 0; y < 40; ++y)
+        {
+            for (unsigned x = 0; x < 40; ++x)
+            {
+                MappedMLSMap<MLSConfig::KALMAN>::CellType cell = mapped.at(x, y);
+                BOOST_REQUIRE_EQUAL(cell.size(), mls.at(x, y).size());
+                BOOST_CHECK(std::equal(cell.begin(), cell.end(), mls.at(x, y).begin()));
+                num_patches += cell.size();
+            }
+        }
+        BOOST_CHECK_EQUAL(mapped.getNumPatches(), num_patches);
+    }
+    BOOST_CHECK_THROW(MappedMLSMap<MLSConfig::SLOPE>("mls.snapshot"), std::runtime_error);
+
+    // and back
+    convertSnapshotToArchive<MappedMLSMap<MLSConfig::KALMAN> >("mls.snapshot", "mls2.bin");
+    MLSMapKalman loaded;
+    {
+        std::ifstream in("mls2.bin", std::ios::binary);
+        boost::archive::binary_iarchive ia(in);
+        ia >> loaded;
+    }
+    BOOST_CHECK_EQUAL(loaded.getEPSGCode(), "EPSG::4978");
+    BOOST_CHECK_EQUAL(loaded.getConfig().gapSize, 0.3f);
+    for (unsigned y = 0; y < 40; ++y)
+    {
+        for (unsigned x = 0; x < 40; ++x)
+        {
+            BOOST_REQUIRE_EQUAL(loaded.at(x, y).size(), mls.at(x, y).size());
+            BOOST_CHECK(std::equal(loaded.at(x, y).begin(), loaded.at(x, y).end(), mls.at(x, y).begin()));
+        }
+    }
+
+    // offsets exceeding the patches of the snapshot
+    {
+        SnapshotHeader header = MapSnapshot::readHeader("mls.snapshot");
+        const uint32_t offset = num_patches + 1;
+        std::fstream file("mls.snapshot", std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(header.offsets_offset + sizeof(uint32_t));
+        file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    }
+    BOOST_CHECK_THROW(MappedMLSMap<MLSConfig::KALMAN>("mls.snapshot"), std::runtime_error);
+
+    // section sizes overflowing in 64 bit and misaligned sections
+    convertArchiveToSnapshot<MLSMapKalman>("mls.bin", "mls.snapshot");
+    SnapshotHeader header = MapSnapshot::readHeader("mls.snapshot");
+    SnapshotHeader overflowing = header;
+    overflowing.offsets_count = uint64_t(1) << 62;
+    SnapshotHeader misaligned = header;
+    misaligned.extra_offset += 4;
+    for (const SnapshotHeader& corrupt : {overflowing, misaligned})
+    {
+        {
+            BOOST_REQUIRE_NO_THROW(MappedMLSMap<MLSConfig::KALMAN>("mls.snapshot"));
+            std::fstream file("mls.snapshot", std::ios::binary | std::ios::in | std::ios::out);
+            file.write(reinterpret_cast<const char*>(&corrupt), sizeof(corrupt));
+        }
+        BOOST_CHECK_THROW(MappedMLSMap<MLSConfig::KALMAN>("mls.snapshot"), std::runtime_error);
+        convertArchiveToSnapshot<MLSMapKalman>("mls.bin", "mls.snapshot");
+    }
+
+    std::remove("mls.bin");
+    std::remove("mls2.bin");
+    std::remove("mls.snapshot");
+}
+
+BOOST_AUTO_TEST_CASE(test_traversabilityGrid_snapshot)
+{
+    TraversabilityGrid grid(Vector2ui(10, 15), Vector2d(0.1, 0.1), TraversabilityCell(0, 10));
+    uint8_t class_id;
+    grid.setTraversabilityClass(2, TraversabilityClass(0.4));
+    BOOST_CHECK(grid.registerNewTraversabilityClass(class_id, TraversabilityClass(0.8)));
+    for (unsigned y = 0; y < 15; ++y)
+        for (unsigned x = 0; x < 10; ++x)
+            grid.setTraversabilityAndProbability((x + y) % 4, 0.1 * (x % 10), x, y);
+
+    saveSnapshot("trav.snapshot", grid);
+    MappedTraversabilityGrid mapped("trav.snapshot");
+    BOOST_CHECK_EQUAL(mapped.getDefaultValue().getProbability(), 10);
+    BOOST_REQUIRE_EQUAL(mapped.getTraversabilityClasses().size(), 4);
+    BOOST_CHECK(!mapped.getTraversabilityClasses()[0].isClassDefined());
+    BOOST_CHECK_EQUAL(mapped.getTraversabilityClasses()[3].getDrivability(), 0.8f);
+    for (unsigned y = 0; y < 15; ++y)
+        for (unsigned x = 0; x < 10; ++x)
+            BOOST_CHECK(mapped.at(x, y) == grid.at(x, y));
+
+    TraversabilityGrid copy = mapped.toMap();
+    BOOST_CHECK_EQUAL(copy.getTraversability(3, 4).getDrivability(), grid.getTraversability(3, 4).getDrivability());
+    BOOST_CHECK(std::equal(copy.begin(), copy.end(), grid.begin()));
+    std::remove("trav.snapshot");
+}
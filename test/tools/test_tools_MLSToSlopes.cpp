@@ -34,6 +34,8 @@
 
 #include <maps/tools/MLSToSlopes.hpp>
 
+#include <numeric/PlaneFitting.hpp>
+
 
 using namespace maps;
 using namespace grid;
@@ -361,4 +363,268 @@ BOOST_AUTO_TEST_CASE(test_MLSToSlopes_45_half_and_half)
             }
         }
     }
-}
\ No newline at end of file
+}
+/** Direct plane fit per cell, as MLSToSlopes::computeSlopes used to do it */
+static void referenceSlopes(const MLSMapKalman& mls, GridMapF& slopes, int windowSize)
+{
+    const int width = mls.getNumCells().x();
+    const int height = mls.getNumCells().y();
+    slopes = GridMapF(mls.getNumCells(), mls.getResolution(), -std::numeric_limits<double>::infinity());
+    for (int y = 1; y < height - 1; ++y)
+    {
+        for (int x = 1; x < width - 1; ++x)
+        {
+            const MLSMapKalman::CellType& cell = mls.at(x, y);
+            if (cell.empty())
+                continue;
+            const double thisHeight = std::max_element(cell.begin(), cell.end())->getMean();
+            numeric::PlaneFitting<double> fitter;
+            int count = 0;
+            for (int yi = -windowSize; yi <= windowSize; ++yi)
+            {
+                for (int xi = -windowSize; xi <= windowSize; ++xi)
+                {
+                    const int rx = x + xi;
+                    const int ry = y + yi;
+                    if ((xi == 0 && yi == 0) || rx < 0 || rx >= width || ry < 0 || ry >= height)
+                        continue;
+                    const MLSMapKalman::CellType& neighbour = mls.at(rx, ry);
+                    if (neighbour.empty())
+                        continue;
+                    count++;
+                    fitter.update(Eigen::Vector3d(xi * mls.getResolution().x(), yi * mls.getResolution().y(),
+                                                  thisHeight - std::max_element(neighbour.begin(), neighbour.end())->getMean()));
+                }
+            }
+            fitter.update(Eigen::Vector3d(0, 0, 0));
+            if (count < 5)
+                continue;
+            Eigen::Vector3d fit(fitter.getCoeffs());
+            slopes.at(x, y) = acos(1 / sqrt(fit.x() * fit.x() + fit.y() * fit.y() + 1));
+        }
+    }
+}
+
+/** Scatters the step between each pair of neighbouring cells, as MLSToSlopes::computeMaxSteps used to do it */
+static void referenceMaxSteps(const MLSMapKalman& mls, GridMapF& maxSteps, bool useStdDev, bool correctSteps, float correctedStepThreshold)
+{
+    const int width = mls.getNumCells().x();
+    const int height = mls.getNumCells().y();
+    const double unknown = -std::numeric_limits<double>::infinity();
+    maxSteps = GridMapF(mls.getNumCells(), mls.getResolution(), unknown);
+
+    std::vector<int> counts(width * height, 0);
+    std::vector<float> diffs(width * height * 8, 0.f);
+    // stores the step between (x, y) and (ox, oy) at the given directions of both cells
+    auto updateDiffs = [&](int dir, int x, int y, int other_dir, int ox, int oy, const MLSMapKalman::Patch& patch)
+    {
+        const MLSMapKalman::CellType& neighbour = mls.at(ox, oy);
+        if (neighbour.empty())
+        {
+            diffs[(x + y * width) * 8 + dir] = unknown;
+            diffs[(ox + oy * width) * 8 + other_dir] = unknown;
+            return;
+        }
+        const MLSMapKalman::Patch& other = *std::max_element(neighbour.begin(), neighbour.end());
+        float z0 = patch.getMean(), z1 = other.getMean();
+        float stdev0 = useStdDev ? patch.getStandardDeviation() : 0.f;
+        float stdev1 = useStdDev ? other.getStandardDeviation() : 0.f;
+        if (z0 > z1)
+        {
+            std::swap(z0, z1);
+            std::swap(stdev0, stdev1);
+        }
+        const float step = (double(z1) + stdev1) - (double(z0) - stdev0);
+        diffs[(x + y * width) * 8 + dir] = step;
+        counts[x + y * width]++;
+        diffs[(ox + oy * width) * 8 + other_dir] = step;
+        counts[ox + oy * width]++;
+    };
+
+    for (int y = 1; y < height - 1; ++y)
+    {
+        for (int x = 1; x < width; ++x)
+        {
+            const MLSMapKalman::CellType& cell = mls.at(x, y);
+            if (cell.empty())
+                continue;
+            const MLSMapKalman::Patch& patch = *std::max_element(cell.begin(), cell.end());
+            updateDiffs(0, x, y, 1, x, y + 1, patch);
+            updateDiffs(2, x, y, 3, x - 1, y - 1, patch);
+            updateDiffs(4, x, y, 5, x - 1, y, patch);
+            updateDiffs(6, x, y, 7, x - 1, y + 1, patch);
+        }
+    }
+
+    for (int y = 1; y < height - 1; ++y)
+    {
+        for (int x = 1; x < width - 1; ++x)
+        {
+            if (counts[x + y * width] < 5)
+                continue;
+            double max_step = unknown;
+            double corrected_max_step = unknown;
+            for (int i = 0; i < 8; i += 2)
+            {
+                const double step0 = diffs[(x + y * width) * 8 + i];
+                const double step1 = diffs[(x + y * width) * 8 + i + 1];
+                max_step = std::max(max_step, std::max(step0, step1));
+                corrected_max_step = std::max(corrected_max_step, step0 - (step0 + step1) / 4);
+                corrected_max_step = std::max(corrected_max_step, step0 - (step0 + step1) * 3 / 4);
+            }
+            maxSteps.at(x, y) = (correctSteps && max_step < correctedStepThreshold) ? corrected_max_step : max_step;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_MLSToSlopes_rough_terrain_matches_reference)
+{
+    const Vector2ui numCells(150, 90);
+    MLSMapKalman mls(numCells, Vector2d(0.05, 0.05), MLSConfig());
+    srand(7);
+    for (uint x = 0; x < numCells[0]; ++x)
+    {
+        for (uint y = 0; y < numCells[1]; ++y)
+        {
+            // leave some holes
+            if (rand() % 10 == 0)
+                continue;
+            float z = 100.f + 0.3f * std::sin(0.1 * x) + 0.02f * y + 0.01f * (rand() % 10);
+            mls.mergePatch(grid::Index(x, y), MLSMapKalman::Patch(z, 0.01f));
+            // second layer in some cells
+            if (rand() % 5 == 0)
+                mls.mergePatch(grid::Index(x, y), MLSMapKalman::Patch(z + 2.f, 0.04f));
+        }
+    }
+
+    for (int windowSize = 1; windowSize <= 4; windowSize += 3)
+    {
+        GridMapF slopes, expected;
+        MLSToSlopes::computeSlopes(mls, slopes, windowSize, 3);
+        referenceSlopes(mls, expected, windowSize);
+        for (size_t y = 0; y < numCells[1]; ++y)
+        {
+            for (size_t x = 0; x < numCells[0]; ++x)
+            {
+                if (std::isinf(expected.at(x, y)))
+                    BOOST_CHECK_EQUAL(slopes.at(x, y), expected.at(x, y));
+                else
+                    BOOST_CHECK_SMALL(slopes.at(x, y) - expected.at(x, y), 1e-4f);
+            }
+        }
+    }
+
+    for (int correctSteps = 0; correctSteps < 2; ++correctSteps)
+    {
+        GridMapF steps_single, steps_parallel, expected;
+        MLSToSlopes::computeMaxSteps(mls, steps_single, true, correctSteps, 0.1, 1);
+        MLSToSlopes::computeMaxSteps(CompactMLSMapKalman(mls).getTopPatchView(), steps_parallel, true, correctSteps, 0.1, 4);
+        referenceMaxSteps(mls, expected, true, correctSteps, 0.1);
+        for (size_t y = 0; y < numCells[1]; ++y)
+        {
+            for (size_t x = 0; x < numCells[0]; ++x)
+            {
+                if (std::isinf(expected.at(x, y)))
+                    BOOST_CHECK_EQUAL(steps_single.at(x, y), expected.at(x, y));
+                else
+                    BOOST_CHECK_SMALL(steps_single.at(x, y) - expected.at(x, y), 1e-5f);
+            }
+        }
+        // the step computation is independent of the number of threads
+        BOOST_CHECK(std::equal(steps_single.begin(), steps_single.end(), steps_parallel.begin()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_MLSToSlopes_update_dirty_region)
+{
+    const Vector2ui numCells(120, 80);
+    MLSMapKalman mls(numCells, Vector2d(0.05, 0.05), MLSConfig());
+    srand(11);
+    for (uint x = 0; x < numCells[0]; ++x)
+    {
+        for (uint y = 0; y < numCells[1]; ++y)
+        {
+            if (rand() % 10 == 0)
+                continue;
+            float z = 10.f + 0.2f * std::sin(0.1 * x) + 0.01f * (rand() % 10);
+            mls.mergePatch(grid::Index(x, y), MLSMapKalman::Patch(z, 0.01f));
+        }
+    }
+
+    const int windowSize = 3;
+    GridMapF slopes, steps;
+    MLSToSlopes::computeSlopes(mls, slopes, windowSize);
+    MLSToSlopes::computeMaxSteps(mls, steps, true);
+
+    // change a small region, including cells which become empty
+    const CellExtents dirty(Vector2ui(60, 30), Vector2ui(70, 36));
+    for (uint x = dirty.min().x(); x <= dirty.max().x(); ++x)
+    {
+        for (uint y = dirty.min().y(); y <= dirty.max().y(); ++y)
+        {
+            mls.at(x, y).clear();
+            if (rand() % 4 != 0)
+                mls.mergePatch(grid::Index(x, y), MLSMapKalman::Patch(11.f + 0.05f * (rand() % 10), 0.01f));
+        }
+    }
+
+    BOOST_CHECK(MLSToSlopes::updateSlopes(mls, slopes, dirty, windowSize));
+    BOOST_CHECK(MLSToSlopes::updateMaxSteps(mls, steps, dirty, true));
+
+    GridMapF expected_slopes, expected_steps;
+    MLSToSlopes::computeSlopes(mls, expected_slopes, windowSize);
+    MLSToSlopes::computeMaxSteps(mls, expected_steps, true);
+    for (size_t y = 0; y < numCells[1]; ++y)
+    {
+        for (size_t x = 0; x < numCells[0]; ++x)
+        {
+            if (std::isinf(expected_slopes.at(x, y)))
+                BOOST_CHECK_EQUAL(slopes.at(x, y), expected_slopes.at(x, y));
+            else
+                BOOST_CHECK_SMALL(slopes.at(x, y) - expected_slopes.at(x, y), 1e-5f);
+            BOOST_CHECK_EQUAL(steps.at(x, y), expected_steps.at(x, y));
+        }
+    }
+
+    // the update falls back to a full computation on mismatching outputs
+    GridMapF empty_slopes;
+    BOOST_CHECK(MLSToSlopes::updateSlopes(mls, empty_slopes, dirty, windowSize));
+    BOOST_CHECK(std::equal(empty_slopes.begin(), empty_slopes.end(), expected_slopes.begin()));
+}
+
+BOOST_AUTO_TEST_CASE(test_MLSToSlopes_sub_region_view)
+{
+    const Vector2ui numCells(60, 50);
+    MLSMapKalman mls(numCells, Vector2d(0.05, 0.05), MLSConfig());
+    srand(13);
+    for (uint x = 0; x < numCells[0]; ++x)
+    {
+        for (uint y = 0; y < numCells[1]; ++y)
+        {
+            if (rand() % 10 == 0)
+                continue;
+            float z = 10.f + 0.2f * std::sin(0.1 * x) + 0.03f * y + 0.01f * (rand() % 10);
+            mls.mergePatch(grid::Index(x, y), MLSMapKalman::Patch(z, 0.01f));
+        }
+    }
+
+    // a view of a part of the MLS behaves like a MLS of that part
+    const CellExtents extents(Vector2ui(20, 10), Vector2ui(44, 39));
+    MLSMapKalman sub_mls(extents.sizes() + Vector2ui(1, 1), mls.getResolution(), MLSConfig());
+    for (uint x = 0; x < sub_mls.getNumCells().x(); ++x)
+    {
+        for (uint y = 0; y < sub_mls.getNumCells().y(); ++y)
+            sub_mls.at(x, y) = mls.at(extents.min().x() + x, extents.min().y() + y);
+    }
+    const MLSTopPatchView view = MLSTopPatchView::fromMLS(mls, extents);
+
+    GridMapF slopes, steps, expected_slopes, expected_steps;
+    BOOST_REQUIRE(MLSToSlopes::computeSlopes(view, slopes, 2));
+    BOOST_REQUIRE(MLSToSlopes::computeMaxSteps(view, steps, true));
+    MLSToSlopes::computeSlopes(sub_mls, expected_slopes, 2);
+    MLSToSlopes::computeMaxSteps(sub_mls, expected_steps, true);
+    BOOST_REQUIRE_EQUAL(slopes.getNumCells(), sub_mls.getNumCells());
+    BOOST_REQUIRE_EQUAL(steps.getNumCells(), sub_mls.getNumCells());
+    BOOST_CHECK(std::equal(slopes.begin(), slopes.end(), expected_slopes.begin()));
+    BOOST_CHECK(std::equal(steps.begin(), steps.end(), expected_steps.begin()));
+}
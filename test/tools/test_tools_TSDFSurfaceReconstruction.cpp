@@ -0,0 +1,273 @@
+//
+// Copyright (c) 2015-2017, Deutsches Forschungszentrum für Künstliche Intelligenz GmbH.
+// Copyright (c) 2015-2017, University of Bremen
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+//   list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+//   this list of conditions and the following disclaimer in the documentation
+//   and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+// OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+#define BOOST_TEST_MODULE ToolsTest
+#include <boost/test/unit_test.hpp>
+
+#include <maps/tools/TSDFSurfaceReconstruction.hpp>
+#include <maps/tools/TSDFPolygonMeshReconstruction.hpp>
+
+#include <fstream>
+#include <sstream>
+
+using namespace maps::grid;
+using namespace maps::tools;
+
+typedef std::vector< Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f> > Surfaces;
+
+class SurfaceExtraction : public TSDFSurfaceReconstruction<Surfaces>
+{
+public:
+    void reconstruct(Surfaces& output)
+    {
+        output.clear();
+        intensities.clear();
+        reconstructSurfaces(output, intensities);
+    }
+
+    /** Extraction in the map frame */
+    void reconstructLocal(Surfaces& output)
+    {
+        output.clear();
+        intensities.clear();
+        reconstructSurfaces(output, intensities, false);
+    }
+
+    /** Reference extraction in the map frame looking up the neighbors of every voxel */
+    void reconstructByVoxelLookup(Surfaces& output)
+    {
+        output.clear();
+        intensities.clear();
+        for(unsigned y = 0; y < tsdf_map->getNumCells().y(); ++y)
+        {
+            for(unsigned x = 0; x < tsdf_map->getNumCells().x(); ++x)
+            {
+                const TSDFVolumetricMap::GridMapBase::CellType& tree = tsdf_map->at(Index(x, y));
+                for(TSDFVolumetricMap::GridMapBase::CellType::const_iterator cell = tree.begin(); cell != tree.end(); cell++)
+                {
+                    Eigen::Vector3i idx(x, y, cell->first);
+                    reconstructVoxel(cell->second, idx, output, intensities);
+                }
+            }
+        }
+    }
+
+    std::vector<float> intensities;
+};
+
+/** TSDF map of a sphere around the sensor */
+template<class MapT = TSDFVolumetricMap>
+typename MapT::Ptr generateSphere()
+{
+    typename MapT::Ptr map(new MapT(Vector2ui(40, 40), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f));
+    map->getLocalFrame().translation() << -1.0, -1.0, 0.0;
+    typename MapT::PointCloud pc;
+    pc.sensor_origin_ << 1.0f, 1.0f, 0.5f, 0.f;
+    for(int i = 0; i < 200; ++i)
+    {
+        double polar = M_PI * i / 200.0;
+        for(int j = 0; j < 100; ++j)
+        {
+            double azimuth = 2.0 * M_PI * j / 100.0;
+            Eigen::Vector3d point = Eigen::Vector3d(1.0, 1.0, 0.5) + 0.8 * Eigen::Vector3d(std::sin(polar) * std::cos(azimuth), std::sin(polar) * std::sin(azimuth), std::cos(polar));
+            pc.push_back(pcl::PointXYZ(point.x(), point.y(), point.z()));
+        }
+    }
+    map->mergePointCloud(pc, map->getLocalFrame().inverse());
+    return map;
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_surface_extraction)
+{
+    TSDFVolumetricMap::Ptr map = generateSphere();
+
+    SurfaceExtraction serial;
+    serial.setTSDFMap(map);
+    Surfaces serial_surfaces;
+    serial.reconstruct(serial_surfaces);
+    BOOST_REQUIRE_GT(serial_surfaces.size(), 0);
+    BOOST_CHECK_EQUAL(serial_surfaces.size() % 3, 0);
+
+    SurfaceExtraction parallel;
+    parallel.setTSDFMap(map);
+    parallel.setNumThreads(4);
+    Surfaces parallel_surfaces;
+    parallel.reconstruct(parallel_surfaces);
+
+    // same triangles in the same order
+    BOOST_REQUIRE_EQUAL(serial_surfaces.size(), parallel_surfaces.size());
+    BOOST_REQUIRE_EQUAL(serial.intensities.size(), parallel.intensities.size());
+    for(size_t i = 0; i < serial_surfaces.size(); ++i)
+    {
+        BOOST_CHECK(serial_surfaces[i] == parallel_surfaces[i]);
+        BOOST_CHECK_EQUAL(serial.intensities[i], parallel.intensities[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_column_walk_matches_voxel_lookup)
+{
+    TSDFVolumetricMap::Ptr map = generateSphere();
+
+    // the column cursors find the same cube corners as the neighbor lookup of each voxel
+    SurfaceExtraction extraction;
+    extraction.setTSDFMap(map);
+    Surfaces reference;
+    extraction.reconstructByVoxelLookup(reference);
+    const std::vector<float> reference_intensities = extraction.intensities;
+    BOOST_REQUIRE_GT(reference.size(), 0);
+
+    for(unsigned num_threads : {1, 4})
+    {
+        extraction.setNumThreads(num_threads);
+        Surfaces surfaces;
+        extraction.reconstructLocal(surfaces);
+        BOOST_REQUIRE_EQUAL(surfaces.size(), reference.size());
+        BOOST_REQUIRE_EQUAL(extraction.intensities.size(), reference_intensities.size());
+        for(size_t i = 0; i < surfaces.size(); ++i)
+        {
+            BOOST_CHECK(surfaces[i] == reference[i]);
+            BOOST_CHECK_EQUAL(extraction.intensities[i], reference_intensities[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_surface_at_grid_border)
+{
+    // horizontal plane covering all columns up to the last row and column of the grid
+    TSDFVolumetricMap::Ptr map(new TSDFVolumetricMap(Vector2ui(10, 8), Eigen::Vector3d(0.1, 0.1, 0.1), 0.3f));
+    for(int y = 0; y < 8; ++y)
+    {
+        for(int x = 0; x < 10; ++x)
+        {
+            for(int z = 3; z < 8; ++z)
+                map->getVoxelCell(Eigen::Vector3i(x, y, z)) = TSDFPatch(0.52f - (z + 0.5f) * 0.1f, 0.01f);
+        }
+    }
+
+    SurfaceExtraction serial;
+    serial.setTSDFMap(map);
+    Surfaces serial_surfaces;
+    BOOST_REQUIRE_NO_THROW(serial.reconstruct(serial_surfaces));
+    // one quad per inner cell, the cells at the border lack their neighbors
+    BOOST_CHECK_EQUAL(serial_surfaces.size(), 9 * 7 * 6);
+
+    SurfaceExtraction parallel;
+    parallel.setTSDFMap(map);
+    parallel.setNumThreads(4);
+    Surfaces parallel_surfaces;
+    parallel.reconstruct(parallel_surfaces);
+    BOOST_REQUIRE_EQUAL(serial_surfaces.size(), parallel_surfaces.size());
+    for(size_t i = 0; i < serial_surfaces.size(); ++i)
+        BOOST_CHECK(serial_surfaces[i] == parallel_surfaces[i]);
+}
+
+BOOST_AUTO_TEST_CASE(test_indexed_mesh)
+{
+    TSDFVolumetricMap::Ptr map = generateSphere();
+
+    SurfaceExtraction extraction;
+    extraction.setTSDFMap(map);
+    Surfaces surfaces;
+    extraction.reconstruct(surfaces);
+
+    TSDFPolygonMeshReconstruction reconstruction;
+    reconstruction.setTSDFMap(map);
+    TSDFPolygonMeshReconstruction::VertexList vertices;
+    std::vector<uint32_t> indices;
+    std::vector<float> intensities;
+    reconstruction.reconstruct(vertices, indices, intensities);
+
+    // same triangles, but the vertices are shared
+    BOOST_REQUIRE_EQUAL(indices.size(), surfaces.size());
+    BOOST_CHECK_EQUAL(intensities.size(), vertices.size());
+    BOOST_CHECK_LT(3 * vertices.size(), surfaces.size());
+    for(size_t i = 0; i < indices.size(); ++i)
+    {
+        BOOST_REQUIRE_LT(indices[i], vertices.size());
+        BOOST_CHECK_SMALL((vertices[indices[i]] - surfaces[i]).norm(), 1e-5f);
+    }
+
+    // the parallel extraction creates the same mesh
+    reconstruction.setNumThreads(4);
+    TSDFPolygonMeshReconstruction::VertexList parallel_vertices;
+    std::vector<uint32_t> parallel_indices;
+    std::vector<float> parallel_intensities;
+    reconstruction.reconstruct(parallel_vertices, parallel_indices, parallel_intensities);
+    BOOST_CHECK(parallel_indices == indices);
+    BOOST_CHECK(parallel_vertices == vertices);
+
+    // binary PLY export
+    const std::string filename = "test_indexed_mesh.ply";
+    TSDFPolygonMeshReconstruction::writePLY(filename, vertices, indices, intensities);
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    const std::string ply = content.str();
+    const std::string end_header = "end_header\n";
+    size_t header_size = ply.find(end_header);
+    BOOST_REQUIRE(header_size != std::string::npos);
+    header_size += end_header.size();
+    BOOST_CHECK_EQUAL(ply.compare(0, 4, "ply\n"), 0);
+    BOOST_CHECK_EQUAL(ply.size(), header_size + 16 * vertices.size() + 13 * indices.size() / 3);
+    std::remove(filename.c_str());
+
+    BOOST_CHECK_THROW(TSDFPolygonMeshReconstruction::writePLY(filename, vertices, indices, std::vector<float>()), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(test_half_map_reconstruction)
+{
+    HalfTSDFVolumetricMap::Ptr map = generateSphere<HalfTSDFVolumetricMap>();
+
+    BasicTSDFPolygonMeshReconstruction<HalfTSDFVolumetricMap> reconstruction;
+    reconstruction.setTSDFMap(map);
+    BasicTSDFPolygonMeshReconstruction<HalfTSDFVolumetricMap>::VertexList vertices;
+    std::vector<uint32_t> indices;
+    std::vector<float> intensities;
+    reconstruction.reconstruct(vertices, indices, intensities);
+    BOOST_REQUIRE_GT(indices.size(), 0);
+    BOOST_CHECK_EQUAL(intensities.size(), vertices.size());
+
+    // the same mesh as the one of the float map within the precision of the half floats
+    TSDFPolygonMeshReconstruction float_reconstruction;
+    float_reconstruction.setTSDFMap(generateSphere());
+    TSDFPolygonMeshReconstruction::VertexList float_vertices;
+    std::vector<uint32_t> float_indices;
+    std::vector<float> float_intensities;
+    float_reconstruction.reconstruct(float_vertices, float_indices, float_intensities);
+    BOOST_REQUIRE(indices == float_indices);
+    BOOST_REQUIRE_EQUAL(vertices.size(), float_vertices.size());
+    for(size_t i = 0; i < vertices.size(); ++i)
+        BOOST_CHECK_SMALL((vertices[i] - float_vertices[i]).norm(), 0.005f);
+
+    // the parallel extraction creates the same mesh
+    reconstruction.setNumThreads(4);
+    BasicTSDFPolygonMeshReconstruction<HalfTSDFVolumetricMap>::VertexList parallel_vertices;
+    std::vector<uint32_t> parallel_indices;
+    std::vector<float> parallel_intensities;
+    reconstruction.reconstruct(parallel_vertices, parallel_indices, parallel_intensities);
+    BOOST_CHECK(parallel_indices == indices);
+    BOOST_CHECK(parallel_vertices == vertices);
+}
@@ -118,3 +118,47 @@ BOOST_AUTO_TEST_CASE(test_voxel_traversal_continuity)
             break;
     }
 }
+
+BOOST_AUTO_TEST_CASE(test_voxel_traversal_batch)
+{
+    Eigen::Vector3d resolution(0.1,0.07367,0.05);
+    maps::grid::VoxelGridMap<bool> voxel_grid(maps::grid::Vector2ui(100. / resolution.x(), 100. / resolution.y()), resolution);
+    voxel_grid.getLocalFrame().translation() << 0.5*voxel_grid.getSize(), 0;
+
+    Eigen::Vector3d origin(0.31, -0.27, 0.12);
+    Eigen::Vector3i origin_idx;
+    BOOST_REQUIRE(voxel_grid.toVoxelGrid(origin, origin_idx));
+
+    std::vector<Eigen::Vector3d> measurements;
+    for(unsigned i = 0; i < 10000; i++)
+        measurements.push_back(origin + Eigen::Vector3d::Random() * 10.0);
+    // axis aligned rays and a measurement in the origin cell
+    measurements.push_back(origin + Eigen::Vector3d(0.0, 0.0, 3.0));
+    measurements.push_back(origin + Eigen::Vector3d(-4.0, 0.0, 0.0));
+    measurements.push_back(origin);
+
+    maps::tools::VoxelTraversal::RayBuffer rays;
+    // the second call reuses the buffer
+    for(unsigned run = 0; run < 2; run++)
+    {
+        maps::tools::VoxelTraversal::computeRays(resolution, origin, origin_idx, measurements.data(), measurements.size(), rays);
+        BOOST_REQUIRE_EQUAL(rays.size(), measurements.size());
+
+        std::vector<maps::tools::VoxelTraversal::RayElement> ray;
+        for(size_t i = 0; i < measurements.size(); i++)
+        {
+            maps::tools::VoxelTraversal::computeRay(resolution, origin, origin_idx, measurements[i], ray);
+            BOOST_REQUIRE_EQUAL(rays.end(i) - rays.begin(i), (long)ray.size());
+            std::vector<maps::tools::VoxelTraversal::RayElement>::const_iterator it = rays.begin(i);
+            for(const maps::tools::VoxelTraversal::RayElement& element : ray)
+            {
+                BOOST_CHECK_EQUAL(it->idx.x(), element.idx.x());
+                BOOST_CHECK_EQUAL(it->idx.y(), element.idx.y());
+                BOOST_CHECK_EQUAL(it->z_first, element.z_first);
+                BOOST_CHECK_EQUAL(it->z_last, element.z_last);
+                BOOST_CHECK_EQUAL(it->z_step, element.z_step);
+                ++it;
+            }
+        }
+    }
+}
@@ -125,25 +125,20 @@ public:
     Eigen::Vector2d getResolution() const { return mls.getResolution(); }
     void visualize(vizkit3d::PatchesGeode& geode) const
     {
-        //const GridMap<SPListST> &mls = *this;
-        Vector2ui num_cell = mls.getNumCells();
-        for (size_t x = 0; x < num_cell.x(); x++)
+        typedef typename MLSMap<Type>::CellType Cell;
+        mls.forEachAllocatedCell([&](const maps::grid::Index& idx, const Cell& list)
         {
-            for (size_t y = 0; y < num_cell.y(); y++)
-            {
-                typedef typename MLSMap<Type>::CellType Cell;
-                const Cell &list = mls.at(x, y);
+            if(list.empty())
+                return;
 
-                Vector2d pos(0.00, 0.00);
-                // Calculate the position of the cell center.
-                pos = (maps::grid::Index(x, y).cast<double>() + maps::grid::Vector2d(0.5, 0.5)).array() * mls.getResolution().array();
-                geode.setPosition(pos.x(), pos.y());
-                for (typename Cell::const_iterator it = list.begin(); it != list.end(); it++)
-                {
-                    PatchVisualizer::visualize(geode, *it);
-                } // for(SPList ...)
-            } // for(y ...)
-        } // for(x ...)        
+            // Calculate the position of the cell center.
+            Vector2d pos = (idx.cast<double>() + maps::grid::Vector2d(0.5, 0.5)).array() * mls.getResolution().array();
+            geode.setPosition(pos.x(), pos.y());
+            for (typename Cell::const_iterator it = list.begin(); it != list.end(); it++)
+            {
+                PatchVisualizer::visualize(geode, *it);
+            } // for(SPList ...)
+        });
     };
 
     void visualizeNegativeInformation(vizkit3d::PatchesGeode& geode) const
@@ -152,36 +147,30 @@ public:
         if(mls.hasFreeSpaceMap() && (grid = boost::dynamic_pointer_cast<maps::grid::OccupancyGridMap>(mls.getFreeSpaceMap())))
         {
             Eigen::Vector3d res = grid->getVoxelResolution();
-            maps::grid::Vector2ui num_cell = grid->getNumCells();
             const maps::grid::OccupancyConfiguration& config = grid->getConfig();
-            for (size_t x = 0; x < num_cell.x(); x++)
+            grid->forEachAllocatedCell([&](const maps::grid::Index& idx, const maps::grid::OccupancyGridMap::GridMapBase::CellType& tree)
             {
-                for (size_t y = 0; y < num_cell.y(); y++)
+                if(tree.empty())
+                    return;
+
+                // Calculate the position of the cell center.
+                maps::grid::Vector2d pos = (idx.cast<double>() + maps::grid::Vector2d(0.5, 0.5)).array() * mls.getResolution().array();
+                geode.setPosition(pos.x(), pos.y());
+                std::vector< std::pair<int,int> > free_cells;
+                for(maps::grid::OccupancyGridMap::ColumnType::const_iterator cell_it = tree.begin(); cell_it != tree.end(); cell_it++)
                 {
-                    const maps::grid::OccupancyGridMap::GridMapBase::CellType &tree = grid->at(x, y);
-                    maps::grid::Index idx(x, y);
-                    if(grid->inGrid(idx))
+                    if(cell_it->second.getLogOdds() < config.free_space_logodds)
                     {
-                        // Calculate the position of the cell center.
-                        maps::grid::Vector2d pos = (maps::grid::Index(x, y).cast<double>() + maps::grid::Vector2d(0.5, 0.5)).array() * mls.getResolution().array();
-                        geode.setPosition(pos.x(), pos.y());
-                        std::vector< std::pair<int,int> > free_cells;
-                        for(maps::grid::DiscreteTree<maps::grid::OccupancyGridMap::VoxelCellType>::const_iterator cell_it = tree.begin(); cell_it != tree.end(); cell_it++)
-                        {
-                            if(cell_it->second.getLogOdds() < config.free_space_logodds)
-                            {
-                                if(free_cells.empty() || free_cells.back().second + 1 != cell_it->first)
-                                    free_cells.push_back(std::make_pair(cell_it->first, cell_it->first));
-                                else
-                                    free_cells.back().second++;
-                            }
-                        }
-
-                        for(const std::pair<int,int>& cell : free_cells)
-                            geode.drawBox(tree.getCellCenter(cell.second) + res.z() * 0.5, res.z() * (float)((cell.second-cell.first)+1), osg::Vec3(0.f,0.f,1.f));
+                        if(free_cells.empty() || free_cells.back().second + 1 != cell_it->first)
+                            free_cells.push_back(std::make_pair(cell_it->first, cell_it->first));
+                        else
+                            free_cells.back().second++;
                     }
                 }
-            }
+
+                for(const std::pair<int,int>& cell : free_cells)
+                    geode.drawBox(tree.getCellCenter(cell.second) + res.z() * 0.5, res.z() * (float)((cell.second-cell.first)+1), osg::Vec3(0.f,0.f,1.f));
+            });
         }
     }
 
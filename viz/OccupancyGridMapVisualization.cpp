@@ -88,7 +88,7 @@ void OccupancyGridMapVisualization::updateMainNode(osg::Node* node)
                 free_space_voxels->setPosition(pos.x(), pos.y());
                 std::vector< std::pair<int,int> > occ_cells;
                 std::vector< std::pair<int,int> > free_cells;
-                for(maps::grid::DiscreteTree<maps::grid::OccupancyGridMap::VoxelCellType>::const_iterator cell_it = tree.begin(); cell_it != tree.end(); cell_it++)
+                for(maps::grid::OccupancyGridMap::ColumnType::const_iterator cell_it = tree.begin(); cell_it != tree.end(); cell_it++)
                 {
                     if(show_occupied && cell_it->second.getLogOdds() >= config.occupied_logodds)
                     {